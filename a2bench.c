@@ -0,0 +1,505 @@
+/*
+ *      a2bench.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              microbenchmarks for the 2D array primitives under
+ *              ppmtrans: UArray2_at and UArray2b_at, the map functions
+ *              of both, and the same operations through the a2plain and
+ *              a2blocked method suites. Each is timed in ns per element
+ *              for every element size, block size and array shape asked
+ *              for, and printed with its cost over a reference:
+ *
+ *                - a sweep over a raw buffer of the same bytes in the
+ *                  same order, the memory cost; what an accessor or a
+ *                  map costs over it is the accessor or the callback
+ *                  dispatch
+ *                - the direct call, for an operation through a method
+ *                  suite; what it costs over that is the suite
+ *
+ *              The numbers can be saved and later compared against:
+ *              with -compare, a2bench exits 1 if any primitive got
+ *              slower than its saved time by more than the threshold.
+ *
+ *      Usage:
+ *
+ *              a2bench [-sizes 1,4,12] [-blocks 16,64] [-shapes
+ *                      2048x2048,16384x256] [-reps n] [-save file]
+ *                      [-compare file] [-threshold percent]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "cputiming.h"
+
+#define MAXLIST 16              /* entries in a -sizes, -blocks or -shapes */
+
+/* a slowdown of less than this many ns per element is never a regression,
+   whatever the threshold, since it is within the noise of the timer */
+#define NOISE_NS 0.05
+
+/* the arrays of one configuration, made by run_config */
+struct config {
+        int width, height;
+        int size;
+        int block;              /* 0 while timing the unblocked rows */
+        char *raw;              /* width * height * size bytes */
+        UArray2_T plain;
+        UArray2b_T blocked;
+};
+
+typedef void bench_fun(struct config *c);
+
+enum kind { RAW, PLAIN, BLOCKED };
+
+/* a primitive to time; ref is the row its extra cost is measured over */
+struct bench {
+        const char *name;
+        enum kind kind;
+        bench_fun *run;
+        int ref;
+};
+
+
+/********** touch functions ********
+ *
+ *      the work done on every element by every benchmark: one byte is
+ *      read and written, so that the element is really loaded and the
+ *      loop cannot be optimized away, but little else is timed
+ *
+ ******************************/
+static inline void touch(void *elem)
+{
+        *(unsigned char *)elem += 1;
+}
+
+static void touch_plain(int i, int j, UArray2_T a, void *elem, void *cl)
+{
+        (void)i; (void)j; (void)a; (void)cl;
+        touch(elem);
+}
+
+static void touch_blocked(int i, int j, UArray2b_T a, void *elem, void *cl)
+{
+        (void)i; (void)j; (void)a; (void)cl;
+        touch(elem);
+}
+
+static void touch_a2(int i, int j, A2Methods_UArray2 a, void *elem,
+                     void *cl)
+{
+        (void)i; (void)j; (void)a; (void)cl;
+        touch(elem);
+}
+
+
+/********** benchmarks ********
+ *
+ *      one pass of each primitive over the whole array; an "order" is
+ *      the order cells are visited in, where storage order is column
+ *      by column for a UArray2 and block by block for a UArray2b
+ *
+ ******************************/
+static void mem_sweep(struct config *c)
+{
+        long n = (long)c->width * c->height;
+
+        for (long k = 0; k < n; k++)
+                touch(c->raw + k * c->size);
+}
+
+static void u2_at_col(struct config *c)
+{
+        for (int i = 0; i < c->width; i++)
+                for (int j = 0; j < c->height; j++)
+                        touch(UArray2_at(c->plain, i, j));
+}
+
+static void u2_at_row(struct config *c)
+{
+        for (int j = 0; j < c->height; j++)
+                for (int i = 0; i < c->width; i++)
+                        touch(UArray2_at(c->plain, i, j));
+}
+
+static void u2_map_col(struct config *c)
+{
+        UArray2_map_col_major(c->plain, touch_plain, NULL);
+}
+
+static void u2_map_row(struct config *c)
+{
+        UArray2_map_row_major(c->plain, touch_plain, NULL);
+}
+
+static void plain_at(struct config *c)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+
+        for (int i = 0; i < c->width; i++)
+                for (int j = 0; j < c->height; j++)
+                        touch(methods->at(c->plain, i, j));
+}
+
+static void plain_map(struct config *c)
+{
+        uarray2_methods_plain->map_default(c->plain, touch_a2, NULL);
+}
+
+static void u2b_at_block(struct config *c)
+{
+        int b = c->block;
+
+        for (int x0 = 0; x0 < c->width; x0 += b)
+                for (int y0 = 0; y0 < c->height; y0 += b) {
+                        int x1 = x0 + b < c->width ? x0 + b : c->width;
+                        int y1 = y0 + b < c->height ? y0 + b : c->height;
+                        for (int j = y0; j < y1; j++)
+                                for (int i = x0; i < x1; i++)
+                                        touch(UArray2b_at(c->blocked, i, j));
+                }
+}
+
+static void u2b_at_row(struct config *c)
+{
+        for (int j = 0; j < c->height; j++)
+                for (int i = 0; i < c->width; i++)
+                        touch(UArray2b_at(c->blocked, i, j));
+}
+
+static void u2b_map(struct config *c)
+{
+        UArray2b_map(c->blocked, touch_blocked, NULL);
+}
+
+static void blocked_at(struct config *c)
+{
+        A2Methods_T methods = uarray2_methods_blocked;
+        int b = c->block;
+
+        for (int x0 = 0; x0 < c->width; x0 += b)
+                for (int y0 = 0; y0 < c->height; y0 += b) {
+                        int x1 = x0 + b < c->width ? x0 + b : c->width;
+                        int y1 = y0 + b < c->height ? y0 + b : c->height;
+                        for (int j = y0; j < y1; j++)
+                                for (int i = x0; i < x1; i++)
+                                        touch(methods->at(c->blocked, i, j));
+                }
+}
+
+static void blocked_map(struct config *c)
+{
+        uarray2_methods_blocked->map_default(c->blocked, touch_a2, NULL);
+}
+
+static const struct bench benches[] = {
+        { "mem sweep",                  RAW,     mem_sweep,    -1 },
+        { "UArray2_at col order",       PLAIN,   u2_at_col,     0 },
+        { "UArray2_at row order",       PLAIN,   u2_at_row,     0 },
+        { "UArray2_map_col_major",      PLAIN,   u2_map_col,    0 },
+        { "UArray2_map_row_major",      PLAIN,   u2_map_row,    0 },
+        { "a2plain at col order",       PLAIN,   plain_at,      1 },
+        { "a2plain map_default",        PLAIN,   plain_map,     3 },
+        { "UArray2b_at block order",    BLOCKED, u2b_at_block,  0 },
+        { "UArray2b_at row order",      BLOCKED, u2b_at_row,    0 },
+        { "UArray2b_map",               BLOCKED, u2b_map,       0 },
+        { "a2blocked at block order",   BLOCKED, blocked_at,    7 },
+        { "a2blocked map_default",      BLOCKED, blocked_map,   9 },
+};
+
+#define NBENCH ((int)(sizeof(benches) / sizeof(benches[0])))
+
+
+/* saved times from -compare, and how many were slower */
+struct baseline {
+        FILE *save;             /* NULL if not saving */
+        char (*keys)[128];
+        double *ns;
+        int count;
+        double threshold;       /* as a fraction, 0.10 for 10% */
+        int regressions;
+};
+
+
+/********** time_bench ********
+ *
+ *      times reps passes of one primitive
+ *
+ *      Return:
+ *              the fastest pass, in ns per element
+ *
+ *      Notes:
+ *              the fastest pass is the one least disturbed by the rest
+ *              of the machine; one untimed pass first brings the array
+ *              into whatever cache it fits in and faults its pages in
+ *
+ ******************************/
+static double time_bench(const struct bench *b, struct config *c, int reps)
+{
+        CPUTime_T timer = CPUTime_New();
+        double best = -1;
+
+        b->run(c);
+        for (int r = 0; r < reps; r++) {
+                CPUTime_Start(timer);
+                b->run(c);
+                double ns = CPUTime_Stop(timer);
+                if (best < 0 || ns < best)
+                        best = ns;
+        }
+        CPUTime_Free(&timer);
+        return best / ((double)c->width * c->height);
+}
+
+
+/********** report ********
+ *
+ *      prints one row of the table, saves it if asked, and checks it
+ *      against the baseline if there is one
+ *
+ ******************************/
+static void report(struct baseline *base, const struct bench *b,
+                   struct config *c, double ns, double ref_ns)
+{
+        char key[128], block[16] = "-", shape[32];
+
+        if (b->kind == BLOCKED)
+                snprintf(block, sizeof(block), "%d", c->block);
+        snprintf(shape, sizeof(shape), "%dx%d", c->width, c->height);
+        snprintf(key, sizeof(key), "%s s%d b%s %s", b->name, c->size, block,
+                 shape);
+
+        printf("%-26s %4d %5s %11s %9.3f", b->name, c->size, block, shape,
+               ns);
+        if (b->ref >= 0)
+                printf(" %9.3f  (over %s)", ns - ref_ns,
+                       benches[b->ref].name);
+
+        if (base->save != NULL)
+                fprintf(base->save, "%.4f %s\n", ns, key);
+
+        for (int k = 0; k < base->count; k++) {
+                if (strcmp(base->keys[k], key) != 0)
+                        continue;
+                if (ns > base->ns[k] * (1 + base->threshold)
+                    && ns - base->ns[k] > NOISE_NS) {
+                        printf("  REGRESSION: was %.3f", base->ns[k]);
+                        base->regressions++;
+                }
+                break;
+        }
+        printf("\n");
+}
+
+
+/********** run_config ********
+ *
+ *      times every primitive on arrays of one shape and element size,
+ *      the blocked ones once per block size
+ *
+ ******************************/
+static void run_config(struct baseline *base, int width, int height,
+                       int size, const int *blocks, int nblocks, int reps)
+{
+        struct config c = { width, height, size, 0, NULL, NULL, NULL };
+        double ns[NBENCH];
+
+        c.raw = calloc((size_t)width * height, size);
+        if (c.raw == NULL) {
+                fprintf(stderr, "a2bench: %dx%d of %d bytes is too big\n",
+                        width, height, size);
+                exit(1);
+        }
+        c.plain = UArray2_new(width, height, size);
+
+        for (int k = 0; k < NBENCH; k++) {
+                if (benches[k].kind == BLOCKED)
+                        continue;
+                ns[k] = time_bench(&benches[k], &c, reps);
+                report(base, &benches[k], &c, ns[k],
+                       benches[k].ref >= 0 ? ns[benches[k].ref] : 0);
+        }
+        UArray2_free(&c.plain);
+
+        for (int b = 0; b < nblocks; b++) {
+                c.block = blocks[b];
+                c.blocked = UArray2b_new(width, height, size, c.block);
+                for (int k = 0; k < NBENCH; k++) {
+                        if (benches[k].kind != BLOCKED)
+                                continue;
+                        ns[k] = time_bench(&benches[k], &c, reps);
+                        report(base, &benches[k], &c, ns[k],
+                               ns[benches[k].ref]);
+                }
+                UArray2b_free(&c.blocked);
+        }
+        free(c.raw);
+}
+
+
+/********** usage ********
+ *
+ *      prints the usage message and exits with failure
+ *
+ ******************************/
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-sizes n,...] [-blocks n,...] "
+                        "[-shapes WxH,...] [-reps n]\n"
+                        "       [-save file] [-compare file] "
+                        "[-threshold percent]\n", progname);
+        exit(1);
+}
+
+/********** parse_list ********
+ *
+ *      reads a comma-separated list of positive numbers, or of WxH
+ *      pairs when heights is not NULL
+ *
+ *      Return:
+ *              the number of entries, or 0 if the list is malformed
+ *
+ ******************************/
+static int parse_list(const char *arg, int *values, int *heights)
+{
+        int n = 0;
+        char *end;
+
+        do {
+                if (n == MAXLIST)
+                        return 0;
+                values[n] = strtol(arg, &end, 10);
+                if (heights != NULL) {
+                        if (*end != 'x')
+                                return 0;
+                        heights[n] = strtol(end + 1, &end, 10);
+                        if (heights[n] < 1)
+                                return 0;
+                }
+                if (values[n] < 1 || (*end != ',' && *end != '\0'))
+                        return 0;
+                n++;
+                arg = end + 1;
+        } while (*end == ',');
+        return n;
+}
+
+/********** load_baseline ********
+ *
+ *      reads the times saved by an earlier -save into base
+ *
+ ******************************/
+static void load_baseline(struct baseline *base, const char *path)
+{
+        FILE *fp = fopen(path, "r");
+        int cap = 0;
+        double ns;
+        char key[128];
+
+        if (fp == NULL) {
+                perror(path);
+                exit(1);
+        }
+        while (fscanf(fp, "%lf ", &ns) == 1
+               && fgets(key, sizeof(key), fp) != NULL) {
+                key[strcspn(key, "\n")] = '\0';
+                if (base->count == cap) {
+                        cap = cap ? 2 * cap : 64;
+                        base->keys = realloc(base->keys,
+                                             cap * sizeof(*base->keys));
+                        base->ns = realloc(base->ns, cap * sizeof(double));
+                        if (base->keys == NULL || base->ns == NULL) {
+                                fprintf(stderr, "a2bench: out of memory\n");
+                                exit(1);
+                        }
+                }
+                strcpy(base->keys[base->count], key);
+                base->ns[base->count++] = ns;
+        }
+        fclose(fp);
+}
+
+
+int main(int argc, char *argv[])
+{
+        int sizes[MAXLIST] = { 1, 4, 12 }, nsizes = 3;
+        int blocks[MAXLIST] = { 16, 64 }, nblocks = 2;
+        int widths[MAXLIST] = { 2048, 16384, 256 };
+        int heights[MAXLIST] = { 2048, 256, 16384 };
+        int nshapes = 3;
+        int reps = 3;
+        struct baseline base = { NULL, NULL, NULL, 0, 0.10, 0 };
+
+        for (int i = 1; i < argc; i++) {
+                char *arg = argv[i];
+                char *next = i + 1 < argc ? argv[i + 1] : NULL;
+                char *end;
+
+                if (next == NULL)
+                        usage(argv[0]);
+                i++;
+                if (strcmp(arg, "-sizes") == 0) {
+                        nsizes = parse_list(next, sizes, NULL);
+                        if (nsizes == 0)
+                                usage(argv[0]);
+                } else if (strcmp(arg, "-blocks") == 0) {
+                        nblocks = parse_list(next, blocks, NULL);
+                        if (nblocks == 0)
+                                usage(argv[0]);
+                } else if (strcmp(arg, "-shapes") == 0) {
+                        nshapes = parse_list(next, widths, heights);
+                        if (nshapes == 0)
+                                usage(argv[0]);
+                } else if (strcmp(arg, "-reps") == 0) {
+                        reps = strtol(next, &end, 10);
+                        if (reps < 1 || *end != '\0')
+                                usage(argv[0]);
+                } else if (strcmp(arg, "-save") == 0) {
+                        base.save = fopen(next, "w");
+                        if (base.save == NULL) {
+                                perror(next);
+                                exit(1);
+                        }
+                } else if (strcmp(arg, "-compare") == 0) {
+                        load_baseline(&base, next);
+                } else if (strcmp(arg, "-threshold") == 0) {
+                        base.threshold = strtod(next, &end) / 100;
+                        if (base.threshold < 0 || *end != '\0')
+                                usage(argv[0]);
+                } else {
+                        usage(argv[0]);
+                }
+        }
+
+        printf("%-26s %4s %5s %11s %9s %9s\n", "primitive", "size",
+               "block", "shape", "ns/elem", "extra");
+        for (int s = 0; s < nshapes; s++)
+                for (int z = 0; z < nsizes; z++)
+                        run_config(&base, widths[s], heights[s], sizes[z],
+                                   blocks, nblocks, reps);
+
+        if (base.save != NULL)
+                fclose(base.save);
+        free(base.keys);
+        free(base.ns);
+        if (base.regressions > 0) {
+                printf("%d primitive%s slower than the baseline by more "
+                       "than %.0f%%\n", base.regressions,
+                       base.regressions == 1 ? "" : "s",
+                       base.threshold * 100);
+                return 1;
+        }
+        return 0;
+}
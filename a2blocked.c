@@ -1,7 +1,10 @@
 #include <string.h>
+#include <limits.h>
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "uarray2brect.h"
+#include "a2cursor.h"
 
 // define a private version of each function in A2Methods_T that we implement
 
@@ -51,25 +54,113 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
         UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
-struct small_closure {
-        A2Methods_smallapplyfun *apply;
-        void *cl;
-};
+// cursors: blocks in storage order, one run per row of a block
+
+static void cursor_begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        cursor->array2 = array2;
+        cursor->col = 0;        // corner of the current block
+        cursor->row = 0;
+        cursor->i = 0;          // row within the current block
+}
+
+static int cursor_next_run(A2Methods_Cursor *cursor, A2Methods_Run *run)
+{
+        A2 a = cursor->array2;
+        int w = UArray2b_width(a);
+        int h = UArray2b_height(a);
+        int bw = UArray2b_blockwidth(a);
+        int bh = UArray2b_blockheight(a);
+
+        if (cursor->i == bh || cursor->row + cursor->i >= h) {
+                cursor->i = 0;
+                cursor->row += bh;
+                if (cursor->row >= h) {
+                        cursor->row = 0;
+                        cursor->col += bw;
+                }
+        }
+        if (cursor->col >= w || h == 0)
+                return 0;
+
+        run->col = cursor->col;
+        run->row = cursor->row + cursor->i;
+        run->elem = UArray2b_at(a, run->col, run->row);
+        run->count = w - cursor->col < bw ? w - cursor->col : bw;
+        run->stride = UArray2b_size(a);
+        run->dcol = 1;
+        run->drow = 0;
+
+        cursor->i++;
+        return 1;
+}
+
+// steps left in the block before index + k * step crosses its edge,
+// the block being edge cells long in that direction
+static int steps_in_block(int index, int step, int edge)
+{
+        if (step > 0)
+                return edge - index % edge;
+        if (step < 0)
+                return index % edge + 1;
+        return INT_MAX;         // no limit from this direction
+}
 
-static void apply_small(int i, int j, UArray2b_T array2, void *elem, void *vcl)
+static int run_at(A2 array2, int col, int row, int dcol, int drow, int n,
+                  A2Methods_Run *run)
 {
-        struct small_closure *cl = vcl;
-        (void)i;
-        (void)j;
-        (void)array2;
-        cl->apply(elem, cl->cl);
+        int bw = UArray2b_blockwidth(array2);
+        int c = steps_in_block(col, dcol, bw);
+        int r = steps_in_block(row, drow, UArray2b_blockheight(array2));
+        int count = c < r ? c : r;
+
+        run->elem = UArray2b_at(array2, col, row);
+        run->count = count < n ? count : n;
+        run->stride = ((long)drow * bw + dcol) * UArray2b_size(array2);
+        run->col = col;
+        run->row = row;
+        run->dcol = dcol;
+        run->drow = drow;
+        return run->count;
 }
 
+// whole blocks, in the order they are stored, from the corner of the first
+static void *storage(A2 array2, size_t *len)
+{
+        int bw = UArray2b_blockwidth(array2);
+        int bh = UArray2b_blockheight(array2);
+        long across = (UArray2b_width(array2) + bw - 1) / bw;
+        long down = (UArray2b_height(array2) + bh - 1) / bh;
+
+        *len = (size_t)across * down * bw * bh * UArray2b_size(array2);
+        return *len == 0 ? NULL : UArray2b_at(array2, 0, 0);
+}
+
+static A2 new_with_blockshape(int width, int height, int size, int blockw,
+                              int blockh)
+{
+        return UArray2b_new_rect(width, height, size, blockw, blockh);
+}
+
+static void blockshape(A2 array2, int *blockw, int *blockh)
+{
+        *blockw = UArray2b_blockwidth(array2);
+        *blockh = UArray2b_blockheight(array2);
+}
+
+// the small map in storage order needs no trampoline
 static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
                                   void *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2b_map(a2, apply_small, &mycl);
+        A2Methods_Cursor cursor;
+        A2Methods_Run run;
+
+        cursor_begin(a2, &cursor);
+        while (cursor_next_run(&cursor, &run)) {
+                char *p = run.elem;
+                for (int k = 0; k < run.count; k++, p += run.stride)
+                        apply(p, cl);
+        }
 }
 
 static struct A2Methods_T uarray2_methods_blocked_struct = {
@@ -94,3 +185,15 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
+
+static struct A2Methods_CursorT uarray2_cursor_blocked_struct = {
+        cursor_begin,
+        cursor_next_run,
+        run_at,
+        storage,
+        new_with_blockshape,
+        blockshape,
+        blockshape,             // tileshape: one block per tile
+};
+
+A2Methods_CursorT uarray2_cursor_blocked = &uarray2_cursor_blocked_struct;
@@ -0,0 +1,213 @@
+/*
+ *      a2compressed.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the A2Methods_T and A2Methods_CursorT suites for UArray2c,
+ *              modelled on those for UArray2b in a2blocked.c. Only
+ *              block-major mapping is offered, in storage order, which
+ *              decodes each block once. A run never leaves its block, so
+ *              its cells are all in one cache slot.
+ *
+ */
+
+#include <stddef.h>
+#include <limits.h>
+#include "a2compressed.h"
+#include "uarray2c.h"
+
+// define a private version of each function in A2Methods_T that we implement
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2c_new_cache_sized(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return UArray2c_new(width, height, size, blocksize, blocksize);
+}
+
+static void a2free(A2 *array2p)
+{
+        UArray2c_free((UArray2c_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2c_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2c_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2c_size(array2);
+}
+static int blocksize(A2 array2)
+{
+        int bw = UArray2c_blockwidth(array2);
+        int bh = UArray2c_blockheight(array2);
+        return bw < bh ? bw : bh;
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2c_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2c_T array2c, void *elem, void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2c_map(array2, (applyfun *) apply, cl);
+}
+
+// cursors: blocks in storage order, one run per row of a block
+
+static void cursor_begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        cursor->array2 = array2;
+        cursor->col = 0;        // corner of the current block
+        cursor->row = 0;
+        cursor->i = 0;          // row within the current block
+}
+
+static int cursor_next_run(A2Methods_Cursor *cursor, A2Methods_Run *run)
+{
+        A2 a = cursor->array2;
+        int w = UArray2c_width(a);
+        int h = UArray2c_height(a);
+        int bw = UArray2c_blockwidth(a);
+        int bh = UArray2c_blockheight(a);
+
+        if (cursor->i == bh || cursor->row + cursor->i >= h) {
+                cursor->i = 0;
+                cursor->row += bh;
+                if (cursor->row >= h) {
+                        cursor->row = 0;
+                        cursor->col += bw;
+                }
+        }
+        if (cursor->col >= w || h == 0)
+                return 0;
+
+        run->col = cursor->col;
+        run->row = cursor->row + cursor->i;
+        run->elem = UArray2c_at(a, run->col, run->row);
+        run->count = w - cursor->col < bw ? w - cursor->col : bw;
+        run->stride = UArray2c_size(a);
+        run->dcol = 1;
+        run->drow = 0;
+
+        cursor->i++;
+        return 1;
+}
+
+// steps left in the block before index + k * step crosses its edge,
+// the block being edge cells long in that direction
+static int steps_in_block(int index, int step, int edge)
+{
+        if (step > 0)
+                return edge - index % edge;
+        if (step < 0)
+                return index % edge + 1;
+        return INT_MAX;         // no limit from this direction
+}
+
+static int run_at(A2 array2, int col, int row, int dcol, int drow, int n,
+                  A2Methods_Run *run)
+{
+        int bw = UArray2c_blockwidth(array2);
+        int c = steps_in_block(col, dcol, bw);
+        int r = steps_in_block(row, drow, UArray2c_blockheight(array2));
+        int count = c < r ? c : r;
+
+        run->elem = UArray2c_at(array2, col, row);
+        run->count = count < n ? count : n;
+        run->stride = ((long)drow * bw + dcol) * UArray2c_size(array2);
+        run->col = col;
+        run->row = row;
+        run->dcol = dcol;
+        run->drow = drow;
+        return run->count;
+}
+
+// no memory holds every cell
+static void *storage(A2 array2, size_t *len)
+{
+        (void)array2;
+        *len = 0;
+        return NULL;
+}
+
+static A2 new_with_blockshape(int width, int height, int size, int blockw,
+                              int blockh)
+{
+        return UArray2c_new(width, height, size, blockw, blockh);
+}
+
+static void blockshape(A2 array2, int *blockw, int *blockh)
+{
+        *blockw = UArray2c_blockwidth(array2);
+        *blockh = UArray2c_blockheight(array2);
+}
+
+static void tileshape(A2 array2, int *tilew, int *tileh)
+{
+        blockshape(array2, tilew, tileh);
+}
+
+// the small map in storage order needs no trampoline
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        A2Methods_Cursor cursor;
+        A2Methods_Run run;
+
+        cursor_begin(a2, &cursor);
+        while (cursor_next_run(&cursor, &run)) {
+                char *p = run.elem;
+                for (int k = 0; k < run.count; k++, p += run.stride)
+                        apply(p, cl);
+        }
+}
+
+static struct A2Methods_T uarray2_methods_compressed_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+};
+
+A2Methods_T uarray2_methods_compressed = &uarray2_methods_compressed_struct;
+
+static struct A2Methods_CursorT uarray2_cursor_compressed_struct = {
+        cursor_begin,
+        cursor_next_run,
+        run_at,
+        storage,
+        new_with_blockshape,
+        blockshape,
+        tileshape,
+};
+
+A2Methods_CursorT uarray2_cursor_compressed = &uarray2_cursor_compressed_struct;
@@ -0,0 +1,23 @@
+#ifndef A2COMPRESSED_INCLUDED
+#define A2COMPRESSED_INCLUDED
+/*
+ *      a2compressed.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the method suite for UArray2c, compressed blocks (see
+ *              uarray2c.h), and its cursor suite. The blocksize is the
+ *              block's, and new makes square blocks of about 4KB.
+ *
+ */
+
+#include "a2methods.h"
+#include "a2cursor.h"
+
+extern A2Methods_T uarray2_methods_compressed;
+extern A2Methods_CursorT uarray2_cursor_compressed;
+
+#endif
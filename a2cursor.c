@@ -0,0 +1,43 @@
+/*
+ *      a2cursor.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              pairs each method suite with its cursor suite. The cursor
+ *              suites themselves live next to the method suites, in
+ *              a2plain.c, a2blocked.c, a2hier.c and a2compressed.c.
+ *
+ */
+
+#include <stddef.h>
+#include "a2cursor.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2hier.h"
+#include "a2compressed.h"
+
+A2Methods_CursorT A2Methods_cursor(A2Methods_T methods)
+{
+        if (methods == uarray2_methods_plain)
+                return uarray2_cursor_plain;
+        if (methods == uarray2_methods_blocked)
+                return uarray2_cursor_blocked;
+        if (methods == uarray2_methods_hier)
+                return uarray2_cursor_hier;
+        if (methods == uarray2_methods_compressed)
+                return uarray2_cursor_compressed;
+        return NULL;
+}
+
+/* the first run of a walk goes along the storage direction */
+int A2Methods_by_column(A2Methods_CursorT cursors, A2Methods_UArray2 array2)
+{
+        A2Methods_Cursor cursor;
+        A2Methods_Run run;
+
+        cursors->cursor_begin(array2, &cursor);
+        return cursors->cursor_next_run(&cursor, &run) && run.drow != 0;
+}
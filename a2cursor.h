@@ -0,0 +1,106 @@
+#ifndef A2CURSOR_INCLUDED
+#define A2CURSOR_INCLUDED
+/*
+ *      a2cursor.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              a callback-free way to walk an A2Methods_UArray2. Instead
+ *              of handing map an apply function, the caller asks a cursor
+ *              for runs of cells that sit at a constant stride in memory
+ *              and loops over each run itself, so the loop body can be
+ *              inlined. Each method suite that supports cursors has a
+ *              companion A2Methods_CursorT, found with A2Methods_cursor.
+ *
+ *      Usage:
+ *
+ *              A2Methods_CursorT cursors = A2Methods_cursor(methods);
+ *              A2Methods_Cursor cursor;
+ *              A2Methods_Run run;
+ *
+ *              cursors->cursor_begin(array2, &cursor);
+ *              while (cursors->cursor_next_run(&cursor, &run)) {
+ *                      char *p = run.elem;
+ *                      for (int k = 0; k < run.count; k++, p += run.stride)
+ *                              ... cell (run.col + k * run.dcol,
+ *                                        run.row + k * run.drow) is at p
+ *              }
+ *
+ */
+
+#include <stddef.h>
+#include "a2methods.h"
+
+/* a stretch of cells at a constant stride in memory */
+typedef struct A2Methods_Run {
+        A2Methods_Object *elem;         /* the first cell of the run */
+        int count;                      /* number of cells in the run */
+        long stride;                    /* bytes from one cell to the next */
+        int col, row;                   /* indices of the first cell */
+        int dcol, drow;                 /* index step from cell to cell */
+} A2Methods_Run;
+
+/* position of a walk; the fields belong to the method suite */
+typedef struct A2Methods_Cursor {
+        A2Methods_UArray2 array2;
+        int col, row, i;
+} A2Methods_Cursor;
+
+typedef const struct A2Methods_CursorT {
+        /* starts a walk over every cell of array2 */
+        void (*cursor_begin)(A2Methods_UArray2 array2,
+                             A2Methods_Cursor *cursor);
+
+        /* fills in the next run of the walk, visiting cells in the
+           order they are stored; returns 0 once every cell has been
+           visited */
+        int (*cursor_next_run)(A2Methods_Cursor *cursor, A2Methods_Run *run);
+
+        /* fills in the longest run of at most n cells that starts at
+           (col, row) and steps by (dcol, drow), each -1, 0 or 1, and
+           returns its count.  The first cell must be in bounds and the
+           caller must not ask for cells past the edge of the array. */
+        int (*run_at)(A2Methods_UArray2 array2, int col, int row,
+                      int dcol, int drow, int n, A2Methods_Run *run);
+
+        /* the memory holding every cell of array2, padding included:
+           *len bytes from the address returned (NULL if it is empty,
+           or if its cells are not all in memory at once) */
+        void *(*storage)(A2Methods_UArray2 array2, size_t *len);
+
+        /* like new_with_blocksize, with blocks blockw columns wide and
+           blockh rows high; suites without blocks ignore the shape */
+        A2Methods_UArray2 (*new_with_blockshape)(int width, int height,
+                                                 int size, int blockw,
+                                                 int blockh);
+
+        /* the columns and rows of a block of array2 (1 x 1 for suites
+           without blocks) */
+        void (*blockshape)(A2Methods_UArray2 array2, int *blockw,
+                           int *blockh);
+
+        /* the columns and rows of the tiles that group blocks, for
+           arrays blocked at two levels; tiles are stored column major
+           and their blocks column major. The block shape for arrays
+           blocked once. */
+        void (*tileshape)(A2Methods_UArray2 array2, int *tilew,
+                          int *tileh);
+} *A2Methods_CursorT;
+
+extern A2Methods_CursorT uarray2_cursor_plain;
+extern A2Methods_CursorT uarray2_cursor_blocked;
+extern A2Methods_CursorT uarray2_cursor_hier;
+extern A2Methods_CursorT uarray2_cursor_compressed;
+
+/* the cursor suite for arrays made by methods, or NULL if it has none */
+extern A2Methods_CursorT A2Methods_cursor(A2Methods_T methods);
+
+/* nonzero if array2 keeps the cells of a column next to each other
+   (as UArray2 does) rather than those of a row (as UArray2b does) */
+extern int A2Methods_by_column(A2Methods_CursorT cursors,
+                               A2Methods_UArray2 array2);
+
+#endif
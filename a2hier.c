@@ -0,0 +1,215 @@
+/*
+ *      a2hier.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the A2Methods_T and A2Methods_CursorT suites for UArray2h,
+ *              modelled on those for UArray2b in a2blocked.c. Only
+ *              block-major mapping is offered, in storage order, which
+ *              walks both levels.
+ *
+ */
+
+#include <limits.h>
+#include "a2hier.h"
+#include "uarray2h.h"
+
+// define a private version of each function in A2Methods_T that we implement
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2h_new_cache_sized(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return UArray2h_new(width, height, size, blocksize, blocksize, 0);
+}
+
+static void a2free(A2 *array2p)
+{
+        UArray2h_free((UArray2h_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2h_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2h_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2h_size(array2);
+}
+static int blocksize(A2 array2)
+{
+        int bw = UArray2h_blockwidth(array2);
+        int bh = UArray2h_blockheight(array2);
+        return bw < bh ? bw : bh;
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2h_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2h_T array2h, void *elem, void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2h_map(array2, (applyfun *) apply, cl);
+}
+
+// cursors: blocks in storage order, one run per row of a block
+
+static void cursor_begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        cursor->array2 = array2;
+        cursor->col = 0;        // corner of the current block
+        cursor->row = 0;
+        cursor->i = 0;          // row within the current block
+}
+
+static int cursor_next_run(A2Methods_Cursor *cursor, A2Methods_Run *run)
+{
+        A2 a = cursor->array2;
+        int w = UArray2h_width(a);
+        int h = UArray2h_height(a);
+        int bw = UArray2h_blockwidth(a);
+
+        if (cursor->i == UArray2h_blockheight(a)
+            || cursor->row + cursor->i >= h) {
+                cursor->i = 0;
+                if (!UArray2h_next_block(a, &cursor->col, &cursor->row))
+                        return 0;
+        }
+        if (cursor->col >= w || h == 0)
+                return 0;
+
+        run->col = cursor->col;
+        run->row = cursor->row + cursor->i;
+        run->elem = UArray2h_at(a, run->col, run->row);
+        run->count = w - cursor->col < bw ? w - cursor->col : bw;
+        run->stride = UArray2h_size(a);
+        run->dcol = 1;
+        run->drow = 0;
+
+        cursor->i++;
+        return 1;
+}
+
+// steps left in the block before index + k * step crosses its edge,
+// the block being edge cells long in that direction
+static int steps_in_block(int index, int step, int edge)
+{
+        if (step > 0)
+                return edge - index % edge;
+        if (step < 0)
+                return index % edge + 1;
+        return INT_MAX;         // no limit from this direction
+}
+
+static int run_at(A2 array2, int col, int row, int dcol, int drow, int n,
+                  A2Methods_Run *run)
+{
+        int bw = UArray2h_blockwidth(array2);
+        int c = steps_in_block(col, dcol, bw);
+        int r = steps_in_block(row, drow, UArray2h_blockheight(array2));
+        int count = c < r ? c : r;
+
+        run->elem = UArray2h_at(array2, col, row);
+        run->count = count < n ? count : n;
+        run->stride = ((long)drow * bw + dcol) * UArray2h_size(array2);
+        run->col = col;
+        run->row = row;
+        run->dcol = dcol;
+        run->drow = drow;
+        return run->count;
+}
+
+// whole blocks, in the order they are stored, from the corner of the first
+static void *storage(A2 array2, size_t *len)
+{
+        int bw = UArray2h_blockwidth(array2);
+        int bh = UArray2h_blockheight(array2);
+        long across = (UArray2h_width(array2) + bw - 1) / bw;
+        long down = (UArray2h_height(array2) + bh - 1) / bh;
+
+        *len = (size_t)across * down * bw * bh * UArray2h_size(array2);
+        return *len == 0 ? NULL : UArray2h_at(array2, 0, 0);
+}
+
+static A2 new_with_blockshape(int width, int height, int size, int blockw,
+                              int blockh)
+{
+        return UArray2h_new(width, height, size, blockw, blockh, 0);
+}
+
+static void blockshape(A2 array2, int *blockw, int *blockh)
+{
+        *blockw = UArray2h_blockwidth(array2);
+        *blockh = UArray2h_blockheight(array2);
+}
+
+static void tileshape(A2 array2, int *tilew, int *tileh)
+{
+        int k = UArray2h_tileblocks(array2);
+
+        *tilew = k * UArray2h_blockwidth(array2);
+        *tileh = k * UArray2h_blockheight(array2);
+}
+
+// the small map in storage order needs no trampoline
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        A2Methods_Cursor cursor;
+        A2Methods_Run run;
+
+        cursor_begin(a2, &cursor);
+        while (cursor_next_run(&cursor, &run)) {
+                char *p = run.elem;
+                for (int k = 0; k < run.count; k++, p += run.stride)
+                        apply(p, cl);
+        }
+}
+
+static struct A2Methods_T uarray2_methods_hier_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+};
+
+A2Methods_T uarray2_methods_hier = &uarray2_methods_hier_struct;
+
+static struct A2Methods_CursorT uarray2_cursor_hier_struct = {
+        cursor_begin,
+        cursor_next_run,
+        run_at,
+        storage,
+        new_with_blockshape,
+        blockshape,
+        tileshape,
+};
+
+A2Methods_CursorT uarray2_cursor_hier = &uarray2_cursor_hier_struct;
@@ -0,0 +1,24 @@
+#ifndef A2HIER_INCLUDED
+#define A2HIER_INCLUDED
+/*
+ *      a2hier.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the method suite for UArray2h, blocks inside tiles (see
+ *              uarray2h.h), and its cursor suite. The blocksize is the
+ *              block's, and new_with_blocksize makes square blocks of
+ *              that edge with tiles sized for the L2.
+ *
+ */
+
+#include "a2methods.h"
+#include "a2cursor.h"
+
+extern A2Methods_T uarray2_methods_hier;
+extern A2Methods_CursorT uarray2_cursor_hier;
+
+#endif
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <a2plain.h>
 #include "uarray2.h"
+#include "a2cursor.h"
 
 /************************************************/
 /* Define a private version of each function in */
@@ -106,12 +107,98 @@ static void small_map_row_major(A2Methods_UArray2        a2,
         UArray2_map_row_major(a2, apply_small, &mycl);
 }
 
+/************************************************/
+/* Cursors: the storage is column major, so a   */
+/* walk yields one run per column.              */
+/************************************************/
+
+static void cursor_begin(A2Methods_UArray2 array2, A2Methods_Cursor *cursor)
+{
+        cursor->array2 = array2;
+        cursor->col = 0;
+        cursor->row = 0;
+        cursor->i = 0;
+}
+
+static int cursor_next_run(A2Methods_Cursor *cursor, A2Methods_Run *run)
+{
+        UArray2_T a = cursor->array2;
+
+        if (cursor->col >= a->numCols || a->numRows == 0)
+                return 0;
+
+        run->elem = UArray_at(a->theArray, cursor->col * a->numRows);
+        run->count = a->numRows;
+        run->stride = a->size;
+        run->col = cursor->col;
+        run->row = 0;
+        run->dcol = 0;
+        run->drow = 1;
+
+        cursor->col++;
+        return 1;
+}
+
+static int run_at(A2Methods_UArray2 array2, int col, int row,
+                  int dcol, int drow, int n, A2Methods_Run *run)
+{
+        UArray2_T a = array2;
+
+        /* every line through a column-major array has a fixed stride */
+        run->elem = UArray2_at(a, col, row);
+        run->count = n;
+        run->stride = ((long)dcol * a->numRows + drow) * a->size;
+        run->col = col;
+        run->row = row;
+        run->dcol = dcol;
+        run->drow = drow;
+        return n;
+}
+
+static void *storage(A2Methods_UArray2 array2, size_t *len)
+{
+        UArray2_T a = array2;
+
+        *len = (size_t)a->numCols * a->numRows * a->size;
+        return *len == 0 ? NULL : UArray_at(a->theArray, 0);
+}
+
+static A2Methods_UArray2 new_with_blockshape(int width, int height,
+                                             int size, int blockw,
+                                             int blockh)
+{
+        (void) blockw;
+        (void) blockh;
+        return UArray2_new(width, height, size);
+}
+
+static void blockshape(A2Methods_UArray2 array2, int *blockw, int *blockh)
+{
+        (void) array2;
+        *blockw = 1;
+        *blockh = 1;
+}
+
+/* no blocks, so no tiles either */
+static void tileshape(A2Methods_UArray2 array2, int *tilew, int *tileh)
+{
+        blockshape(array2, tilew, tileh);
+}
+
+/* the small map in storage order needs no trampoline */
 static void small_map_col_major(A2Methods_UArray2        a2,
                                 A2Methods_smallapplyfun  apply,
                                 void *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2_map_col_major(a2, apply_small, &mycl);
+        A2Methods_Cursor cursor;
+        A2Methods_Run run;
+
+        cursor_begin(a2, &cursor);
+        while (cursor_next_run(&cursor, &run)) {
+                char *p = run.elem;
+                for (int k = 0; k < run.count; k++, p += run.stride)
+                        apply(p, cl);
+        }
 }
 
 
@@ -137,3 +224,15 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_plain = &uarray2_methods_plain_struct;
+
+static struct A2Methods_CursorT uarray2_cursor_plain_struct = {
+        cursor_begin,
+        cursor_next_run,
+        run_at,
+        storage,
+        new_with_blockshape,
+        blockshape,
+        tileshape,
+};
+
+A2Methods_CursorT uarray2_cursor_plain = &uarray2_cursor_plain_struct;
@@ -0,0 +1,290 @@
+/*
+ *      cachesim.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the CacheSim_T interface, a trace-driven
+ *              model of an L1/L2 cache pair and a data TLB. Each level is
+ *              a set-associative array of tags kept in LRU order (most
+ *              recently used first), which is plenty fast for the short
+ *              associativities found in real hardware.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "assert.h"
+#include "cachesim.h"
+
+struct Level {
+        const char *name;
+        long size;              /* bytes (caches) or entries (TLB) */
+        int ways;
+        int sets;
+        int linesize;           /* line size or page size in bytes */
+        int shift;              /* log2(linesize) */
+        uintptr_t *tags;        /* sets * ways, tag + 1 so 0 is empty */
+        unsigned long long misses;
+};
+
+struct CacheSim_T {
+        struct Level l1, l2, tlb;
+        unsigned long long accesses;
+};
+
+static CacheSim_T attached = NULL;
+
+
+/********** parse_size ********
+ *
+ *      reads a decimal number with an optional K or M suffix
+ *
+ *      Parameters:
+ *              const char **sp: cursor into the config string, advanced
+ *                               past the number
+ *
+ *      Return:
+ *              the value read, or -1 if there was no number
+ *
+ ******************************/
+static long parse_size(const char **sp)
+{
+        char *end;
+        long n = strtol(*sp, &end, 10);
+
+        if (end == *sp)
+                return -1;
+        if (*end == 'K' || *end == 'k') {
+                n *= 1024;
+                end++;
+        } else if (*end == 'M' || *end == 'm') {
+                n *= 1024 * 1024;
+                end++;
+        }
+        *sp = end;
+        return n;
+}
+
+/********** set_geometry ********
+ *
+ *      fills in the derived fields of a level and allocates its tags
+ *
+ *      Return:
+ *              0 on success, -1 if the geometry is impossible
+ *
+ *      Notes:
+ *              for the TLB size counts entries rather than bytes
+ *
+ ******************************/
+static int set_geometry(struct Level *lv, long size, int ways, int linesize,
+                        int is_tlb)
+{
+        if (size < 1 || ways < 1 || linesize < 1 ||
+            (linesize & (linesize - 1)) != 0)
+                return -1;
+
+        long lines = is_tlb ? size : size / linesize;
+        if (lines < ways || lines % ways != 0)
+                return -1;
+
+        lv->size = size;
+        lv->ways = ways;
+        lv->sets = lines / ways;
+        lv->linesize = linesize;
+        lv->shift = 0;
+        while ((1 << lv->shift) < linesize)
+                lv->shift++;
+
+        free(lv->tags);
+        lv->tags = calloc((size_t)lv->sets * ways, sizeof(*lv->tags));
+        assert(lv->tags != NULL);
+        return 0;
+}
+
+/********** CacheSim_New ********
+ *
+ *      creates a simulator with the geometry described by config
+ *
+ *      Parameters:
+ *              const char *config: comma separated level descriptions,
+ *                      see cachesim.h; NULL or "" for the defaults
+ *
+ *      Return:
+ *              the new simulator, or NULL if config is malformed
+ *
+ ******************************/
+CacheSim_T CacheSim_New(const char *config)
+{
+        CacheSim_T sim = calloc(1, sizeof(*sim));
+        assert(sim != NULL);
+
+        sim->l1.name = "L1";
+        sim->l2.name = "L2";
+        sim->tlb.name = "TLB";
+
+        /* defaults: the i7-1260P the README timings were taken on */
+        set_geometry(&sim->l1, 48 * 1024, 12, 64, 0);
+        set_geometry(&sim->l2, 1280 * 1024, 20, 64, 0);
+        set_geometry(&sim->tlb, 64, 4, 4096, 1);
+
+        const char *s = config == NULL ? "" : config;
+        int ok = 1;
+        while (ok && *s != '\0') {
+                struct Level *lv;
+                int is_tlb = 0;
+
+                if (strncmp(s, "l1=", 3) == 0) {
+                        lv = &sim->l1;
+                } else if (strncmp(s, "l2=", 3) == 0) {
+                        lv = &sim->l2;
+                } else if (strncmp(s, "tlb=", 4) == 0) {
+                        lv = &sim->tlb;
+                        is_tlb = 1;
+                        s++;
+                } else {
+                        ok = 0;
+                        break;
+                }
+                s += 3;
+
+                long size = parse_size(&s);
+                long ways = *s == ':' ? (s++, parse_size(&s)) : -1;
+                long line = *s == ':' ? (s++, parse_size(&s)) : -1;
+                ok = set_geometry(lv, size, ways, line, is_tlb) == 0 &&
+                     (*s == ',' || *s == '\0');
+                if (*s == ',')
+                        s++;
+        }
+
+        if (!ok) {
+                CacheSim_Free(&sim);
+                return NULL;
+        }
+        return sim;
+}
+
+void CacheSim_Free(CacheSim_T *simp)
+{
+        assert(simp != NULL && *simp != NULL);
+        if (attached == *simp)
+                attached = NULL;
+        free((*simp)->l1.tags);
+        free((*simp)->l2.tags);
+        free((*simp)->tlb.tags);
+        free(*simp);
+        *simp = NULL;
+}
+
+/********** lookup ********
+ *
+ *      looks up one line (or page) number in a level, updating the
+ *      LRU order and the miss count
+ *
+ *      Return:
+ *              1 on a hit, 0 on a miss
+ *
+ ******************************/
+static int lookup(struct Level *lv, uintptr_t key)
+{
+        uintptr_t *set = lv->tags + (size_t)(key % lv->sets) * lv->ways;
+        uintptr_t tag = key + 1;
+        int w;
+
+        for (w = 0; w < lv->ways; w++) {
+                if (set[w] == tag)
+                        break;
+        }
+
+        int hit = w < lv->ways;
+        if (!hit) {
+                lv->misses++;
+                w = lv->ways - 1;       /* evict the least recently used */
+        }
+
+        memmove(set + 1, set, w * sizeof(*set));
+        set[0] = tag;
+        return hit;
+}
+
+void CacheSim_Access(CacheSim_T sim, const void *addr, int nbytes)
+{
+        uintptr_t first = (uintptr_t)addr;
+        uintptr_t last = first + (nbytes > 0 ? nbytes - 1 : 0);
+
+        sim->accesses++;
+
+        for (uintptr_t line = first >> sim->l1.shift;
+             line <= last >> sim->l1.shift; line++) {
+                if (!lookup(&sim->l1, line))
+                        lookup(&sim->l2, (line << sim->l1.shift)
+                                         >> sim->l2.shift);
+        }
+
+        for (uintptr_t page = first >> sim->tlb.shift;
+             page <= last >> sim->tlb.shift; page++)
+                lookup(&sim->tlb, page);
+}
+
+void CacheSim_Attach(CacheSim_T sim)
+{
+        attached = sim;
+}
+
+void CacheSim_Detach(void)
+{
+        attached = NULL;
+}
+
+void CacheSim_Trace(const void *addr, int nbytes)
+{
+        if (attached != NULL)
+                CacheSim_Access(attached, addr, nbytes);
+}
+
+/********** report_level ********
+ *
+ *      prints the geometry and miss counts of one level
+ *
+ ******************************/
+static void report_level(FILE *fp, struct Level *lv, int is_tlb,
+                         unsigned long long accesses, double npixels)
+{
+        if (is_tlb)
+                fprintf(fp, "  %-3s %4ld entries %2d-way %5dB pages: ",
+                        lv->name, lv->size, lv->ways, lv->linesize);
+        else
+                fprintf(fp, "  %-3s %6ldK     %2d-way %5dB lines: ",
+                        lv->name, lv->size / 1024, lv->ways, lv->linesize);
+
+        fprintf(fp, "%llu misses (%.2f%% of accesses, %.3f per pixel)\n",
+                lv->misses,
+                accesses ? 100.0 * lv->misses / accesses : 0.0,
+                npixels > 0 ? lv->misses / npixels : 0.0);
+}
+
+/********** CacheSim_Report ********
+ *
+ *      prints the predicted misses at each level
+ *
+ *      Parameters:
+ *              CacheSim_T sim: the simulator
+ *              FILE *fp: where to print
+ *              const char *label: names the operation and layout traced
+ *              double npixels: pixels transformed, for per-pixel figures
+ *
+ ******************************/
+void CacheSim_Report(CacheSim_T sim, FILE *fp, const char *label,
+                     double npixels)
+{
+        assert(sim != NULL && fp != NULL);
+
+        fprintf(fp, "Cache simulation of %s: %llu accesses\n",
+                label, sim->accesses);
+        report_level(fp, &sim->l1, 0, sim->accesses, npixels);
+        report_level(fp, &sim->l2, 0, sim->accesses, npixels);
+        report_level(fp, &sim->tlb, 1, sim->accesses, npixels);
+}
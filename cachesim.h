@@ -0,0 +1,65 @@
+#ifndef CACHESIM_INCLUDED
+#define CACHESIM_INCLUDED
+/****************************************************************
+ *
+ *                         cachesim.h
+ *
+ *       Interface to a small trace-driven cache simulator, type
+ *       CacheSim_T, used to predict L1/L2/TLB misses of the
+ *       ppmtrans transformations without hardware counters.
+ *
+ *       The simulator models a set-associative, write-allocate
+ *       L1 backed by an L2, plus a separate data TLB.  All three
+ *       use LRU replacement.  Geometry is given as a string:
+ *
+ *           "l1=48K:12:64,l2=1280K:20:64,tlb=64:4:4K"
+ *
+ *       where each cache is size:ways:linesize and the TLB is
+ *       entries:ways:pagesize.  K and M suffixes are accepted and
+ *       any level left out keeps its default (the values above).
+ *
+ *       Usage:
+ *
+ *       CacheSim_T sim = CacheSim_New(config);
+ *       CacheSim_Attach(sim);
+ *         ... Run the code to be traced here
+ *       CacheSim_Detach();
+ *       CacheSim_Report(sim, stderr, "rotate 90, block-major", npix);
+ *       CacheSim_Free(&sim);
+ *
+ *       Code feeds the simulator through CACHESIM_TRACE(addr, n),
+ *       which compiles to nothing unless CACHESIM is defined, so
+ *       the ordinary build pays nothing for the hooks.
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+
+typedef struct CacheSim_T *CacheSim_T;
+
+/* Returns NULL if config cannot be parsed or describes an
+ * impossible geometry; NULL or "" gives the default geometry. */
+CacheSim_T CacheSim_New(const char *config);
+
+void CacheSim_Free(CacheSim_T *simp);
+
+/* Record an access of nbytes starting at addr */
+void CacheSim_Access(CacheSim_T sim, const void *addr, int nbytes);
+
+/* Route CacheSim_Trace to sim until the next CacheSim_Detach */
+void CacheSim_Attach(CacheSim_T sim);
+void CacheSim_Detach(void);
+
+/* Record an access on the attached simulator, if there is one */
+void CacheSim_Trace(const void *addr, int nbytes);
+
+void CacheSim_Report(CacheSim_T sim, FILE *fp, const char *label,
+                     double npixels);
+
+#ifdef CACHESIM
+#define CACHESIM_TRACE(ADDR, NBYTES) CacheSim_Trace((ADDR), (NBYTES))
+#else
+#define CACHESIM_TRACE(ADDR, NBYTES) ((void)0)
+#endif
+
+#endif
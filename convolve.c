@@ -0,0 +1,415 @@
+/*
+ *      convolve.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of Convolve_T. Each destination tile
+ *              gathers a window of the source, the tile plus the halo,
+ *              into per-thread scratch as float vectors (see vec4.h),
+ *              filling the part of the halo off the image by repeating
+ *              the edge. The general kernel is applied a row of the tile
+ *              at a time, one weight times a whole row per step; a
+ *              separable kernel is applied across the window and then
+ *              down it.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "cachesim.h"
+#include "numa.h"
+#include "vec4.h"
+#include "convolve.h"
+
+#define DEFAULT_TILE 64 /* tile edge when the destination is not blocked */
+#define MAX_KERNEL 255  /* largest kernel width or height */
+#define RANK_EPS 1e-6   /* relative error allowed in a separable kernel */
+
+struct Convolve_T {
+        int width, height;
+        float *weights;                 /* height rows of width */
+        int separable;
+        float *row, *col;               /* weights = col * row, if
+                                           separable */
+};
+
+struct convolve_job {
+        Pnm_ppm src;
+        A2Methods_CursorT cursors;
+        A2Methods_UArray2 dst;
+        Convolve_T kernel;
+        int src_vertical, dst_vertical; /* stored a column at a time */
+        int tile_w, tile_h, tiles_down;
+        float maxval;
+        struct scratch *scratch;        /* one per thread */
+};
+
+
+/********** next_number ********
+ *
+ *      reads the next number of a kernel file, skipping comments
+ *
+ *      Return:
+ *              1 if there was a number, 0 if not
+ *
+ ******************************/
+static int next_number(FILE *fp, double *x)
+{
+        int c;
+
+        while ((c = getc(fp)) != EOF) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF)
+                                c = getc(fp);
+                } else if (!isspace(c)) {
+                        ungetc(c, fp);
+                        return fscanf(fp, "%lf", x) == 1 && isfinite(*x);
+                }
+        }
+        return 0;
+}
+
+/********** factor ********
+ *
+ *      tries to write the kernel as the outer product of a column and
+ *      a row, recording them if it can
+ *
+ *      Notes:
+ *              the kernel is rank 1 exactly when every row is a multiple
+ *              of the row through its largest weight
+ *
+ ******************************/
+static void factor(Convolve_T k)
+{
+        int w = k->width;
+        int h = k->height;
+        int p = 0;
+        float big = 0;
+
+        for (int i = 0; i < w * h; i++) {
+                if (fabsf(k->weights[i]) > big) {
+                        big = fabsf(k->weights[i]);
+                        p = i;
+                }
+        }
+        if (big == 0)
+                return;
+
+        int pr = p / w;
+        int pc = p % w;
+        k->row = malloc(w * sizeof(*k->row));
+        k->col = malloc(h * sizeof(*k->col));
+        assert(k->row != NULL && k->col != NULL);
+        for (int c = 0; c < w; c++)
+                k->row[c] = k->weights[pr * w + c] / k->weights[p];
+        for (int r = 0; r < h; r++)
+                k->col[r] = k->weights[r * w + pc];
+
+        k->separable = 1;
+        for (int r = 0; r < h; r++)
+                for (int c = 0; c < w; c++)
+                        if (fabsf(k->weights[r * w + c]
+                                  - k->col[r] * k->row[c]) > RANK_EPS * big)
+                                k->separable = 0;
+}
+
+/********** Convolve_read ********
+ *
+ *      reads a kernel file
+ *
+ *      Parameters:
+ *              FILE *fp: the open kernel file
+ *
+ *      Return:
+ *              the kernel, or NULL if the sizes are not odd and at most
+ *              MAX_KERNEL, or there are too few or too many weights
+ *
+ *      Notes:
+ *              the weights are stored turned by 180 degrees, so that
+ *              the tile loops, which slide them over the image as they
+ *              are (a correlation), give the convolution with the
+ *              kernel as written
+ *
+ ******************************/
+Convolve_T Convolve_read(FILE *fp)
+{
+        double w, h, x;
+
+        assert(fp != NULL);
+        if (!next_number(fp, &w) || !next_number(fp, &h))
+                return NULL;
+        if (w != floor(w) || h != floor(h) || w < 1 || h < 1
+            || w > MAX_KERNEL || h > MAX_KERNEL
+            || (int)w % 2 == 0 || (int)h % 2 == 0)
+                return NULL;
+
+        Convolve_T k = calloc(1, sizeof(*k));
+        assert(k != NULL);
+        k->width = w;
+        k->height = h;
+        k->weights = malloc(k->width * k->height * sizeof(*k->weights));
+        assert(k->weights != NULL);
+
+        int n = k->width * k->height;
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+                if (!next_number(fp, &x)) {
+                        Convolve_free(&k);
+                        return NULL;
+                }
+                k->weights[n - 1 - i] = x;
+                sum += x;
+        }
+        if (next_number(fp, &x) || !feof(fp)) {
+                Convolve_free(&k);
+                return NULL;
+        }
+
+        if (sum != 0)
+                for (int i = 0; i < n; i++)
+                        k->weights[i] /= sum;
+        factor(k);
+        return k;
+}
+
+void Convolve_free(Convolve_T *kernel)
+{
+        assert(kernel != NULL && *kernel != NULL);
+        free((*kernel)->weights);
+        free((*kernel)->row);
+        free((*kernel)->col);
+        free(*kernel);
+        *kernel = NULL;
+}
+
+int Convolve_width(Convolve_T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->width;
+}
+
+int Convolve_height(Convolve_T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->height;
+}
+
+int Convolve_separable(Convolve_T kernel)
+{
+        assert(kernel != NULL);
+        return kernel->separable;
+}
+
+/********** gather_clamped ********
+ *
+ *      loads the window [x0, x0 + ww) x [y0, y0 + wh) of the source
+ *      into win, row by row, repeating the edge pixels for the part of
+ *      the window off the image
+ *
+ *      Expects:
+ *              the window to overlap the image
+ *
+ ******************************/
+static void gather_clamped(struct convolve_job *job, int x0, int y0, int ww,
+                           int wh, v4f *win)
+{
+        int lx = x0 < 0 ? 0 : x0;
+        int ly = y0 < 0 ? 0 : y0;
+        int hx = x0 + ww > (int)job->src->width ? (int)job->src->width
+                                                 : x0 + ww;
+        int hy = y0 + wh > (int)job->src->height ? (int)job->src->height
+                                                  : y0 + wh;
+
+        load_rect(job->src->pixels, job->cursors, job->src_vertical, lx, ly,
+                  hx - lx, hy - ly, win + (size_t)(ly - y0) * ww + (lx - x0),
+                  1, ww);
+
+        for (int r = ly - y0; r < hy - y0; r++) {
+                v4f *row = win + (size_t)r * ww;
+                for (int c = 0; c < lx - x0; c++)
+                        row[c] = row[lx - x0];
+                for (int c = hx - x0; c < ww; c++)
+                        row[c] = row[hx - x0 - 1];
+        }
+        for (int r = 0; r < ly - y0; r++)
+                memcpy(win + (size_t)r * ww, win + (size_t)(ly - y0) * ww,
+                       ww * sizeof(*win));
+        for (int r = hy - y0; r < wh; r++)
+                memcpy(win + (size_t)r * ww, win + (size_t)(hy - y0 - 1) * ww,
+                       ww * sizeof(*win));
+}
+
+/********** convolve_general ********
+ *
+ *      convolves the window with any kernel into the tw x th tile out,
+ *      row by row
+ *
+ *      Notes:
+ *              each step adds one weight times a row of the window to a
+ *              row of out, a loop over consecutive vectors
+ *
+ ******************************/
+static void convolve_general(Convolve_T k, const v4f *win, int ww, int tw,
+                             int th, v4f *out)
+{
+        for (int y = 0; y < th; y++) {
+                v4f *o = out + (size_t)y * tw;
+
+                for (int x = 0; x < tw; x++)
+                        o[x] = (v4f){ 0, 0, 0, 0 };
+                for (int r = 0; r < k->height; r++) {
+                        const float *kr = k->weights + r * k->width;
+                        const v4f *in = win + (size_t)(y + r) * ww;
+                        for (int c = 0; c < k->width; c++, in++) {
+                                float w = kr[c];
+                                if (w == 0)
+                                        continue;
+                                for (int x = 0; x < tw; x++)
+                                        o[x] += in[x] * w;
+                        }
+                }
+        }
+}
+
+/********** convolve_separable ********
+ *
+ *      convolves the window with a separable kernel into the tw x th
+ *      tile out: across each row of the window into mid, which is tw
+ *      wide, then down mid
+ *
+ ******************************/
+static void convolve_separable(Convolve_T k, const v4f *win, int ww,
+                               int wh, int tw, int th, v4f *mid, v4f *out)
+{
+        for (int y = 0; y < wh; y++) {
+                const v4f *in = win + (size_t)y * ww;
+                v4f *m = mid + (size_t)y * tw;
+
+                for (int x = 0; x < tw; x++)
+                        m[x] = in[x] * k->row[0];
+                for (int c = 1; c < k->width; c++)
+                        for (int x = 0; x < tw; x++)
+                                m[x] += in[x + c] * k->row[c];
+        }
+
+        for (int y = 0; y < th; y++) {
+                const v4f *m = mid + (size_t)y * tw;
+                v4f *o = out + (size_t)y * tw;
+
+                for (int x = 0; x < tw; x++)
+                        o[x] = m[x] * k->col[0];
+                for (int r = 1; r < k->height; r++) {
+                        m += tw;
+                        for (int x = 0; x < tw; x++)
+                                o[x] += m[x] * k->col[r];
+                }
+        }
+}
+
+/********** convolve_tile ********
+ *
+ *      Parallel_work function: convolves tile number item, numbered
+ *      column by column, the order a blocked destination stores its
+ *      blocks
+ *
+ ******************************/
+static void convolve_tile(int item, int thread, void *cl)
+{
+        struct convolve_job *job = cl;
+        Convolve_T k = job->kernel;
+        int width = job->src->width;
+        int height = job->src->height;
+        int x0 = (item / job->tiles_down) * job->tile_w;
+        int y0 = (item % job->tiles_down) * job->tile_h;
+        int tw = width - x0 < job->tile_w ? width - x0 : job->tile_w;
+        int th = height - y0 < job->tile_h ? height - y0 : job->tile_h;
+        int ww = tw + k->width - 1;
+        int wh = th + k->height - 1;
+
+        /* window, then the tile, then the separable pass's mid */
+        size_t nwin = (size_t)ww * wh;
+        size_t nout = (size_t)tw * th;
+        size_t nmid = k->separable ? (size_t)tw * wh : 0;
+        v4f *win = window_for(&job->scratch[thread], nwin + nout + nmid);
+        if (win == NULL)
+                return;
+        v4f *out = win + nwin;
+
+        gather_clamped(job, x0 - k->width / 2, y0 - k->height / 2, ww, wh,
+                       win);
+        if (k->separable)
+                convolve_separable(k, win, ww, wh, tw, th, out + nout, out);
+        else
+                convolve_general(k, win, ww, tw, th, out);
+
+        store_rect(job->dst, job->cursors, job->dst_vertical, x0, y0, tw, th,
+                   out, 1, tw, job->maxval);
+}
+
+/********** Convolve_apply ********
+ *
+ *      convolves the image with a kernel
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the pixmap holding the image
+ *              Convolve_T kernel: the kernel
+ *              Parallel_T pool: threads to share the tiles, or NULL
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              frees the 2D array holding the old image in pixmap
+ *              results are rounded and clamped to 0..maxval
+ *
+ ******************************/
+void Convolve_apply(Pnm_ppm pixmap, Convolve_T kernel, Parallel_T pool)
+{
+        A2Methods_T methods = pixmap->methods;
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        int size = methods->size(pixmap->pixels);
+        int bw, bh;
+        int width = pixmap->width;
+        int height = pixmap->height;
+
+        assert(kernel != NULL);
+        assert(cursors != NULL);
+        assert(size == sizeof(struct Pnm_rgb));
+
+        struct convolve_job job;
+        job.src = pixmap;
+        job.cursors = cursors;
+        cursors->blockshape(pixmap->pixels, &bw, &bh);
+        job.dst = cursors->new_with_blockshape(width, height, size, bw, bh);
+        Numa_Place(methods, job.dst);
+        job.kernel = kernel;
+        job.src_vertical = A2Methods_by_column(cursors, pixmap->pixels);
+        job.dst_vertical = A2Methods_by_column(cursors, job.dst);
+        job.tile_w = bw * bh > 1 ? bw : DEFAULT_TILE;
+        job.tile_h = bw * bh > 1 ? bh : DEFAULT_TILE;
+        job.tiles_down = (height + job.tile_h - 1) / job.tile_h;
+        job.maxval = pixmap->denominator;
+
+        int nthreads = Parallel_threads(pool);
+        job.scratch = calloc(nthreads, sizeof(*job.scratch));
+        assert(job.scratch != NULL);
+
+        int tiles_across = (width + job.tile_w - 1) / job.tile_w;
+        Parallel_for(pool, tiles_across * job.tiles_down, convolve_tile,
+                     &job);
+
+        int failed = scratch_free(job.scratch, nthreads);
+        if (failed)
+                methods->free(&job.dst);
+        assert(!failed);
+
+        methods->free(&(pixmap->pixels));
+        pixmap->pixels = job.dst;
+}
@@ -0,0 +1,61 @@
+#ifndef CONVOLVE_INCLUDED
+#define CONVOLVE_INCLUDED
+/*
+ *      convolve.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              2D convolution of an image with a small kernel (blur,
+ *              sharpen, edge detection ...), type Convolve_T. The image
+ *              is done one tile at a time (a block of a blocked array):
+ *              each tile gathers its pixels plus a halo as wide as the
+ *              kernel reaches, so the inner loops run out of cache.
+ *              Kernels that are an outer product of a column and a row
+ *              are found when read and applied in two 1D passes.
+ *
+ *      A kernel file holds the kernel's width and height, both odd, and
+ *      then its weights row by row; # starts a comment:
+ *
+ *              # 3x3 box blur
+ *              3 3
+ *              1 1 1
+ *              1 1 1
+ *              1 1 1
+ *
+ *      The weights are divided by their sum, unless it is 0, so the
+ *      kernel above averages. It is a true convolution: output pixel
+ *      (x, y) is the sum over the kernel of weight (c, r) times input
+ *      pixel (x - c, y - r), with (c, r) counted from the kernel's
+ *      center, so "3 1  0 0 1" moves the image one pixel right rather
+ *      than left, and an asymmetric kernel such as Sobel's keeps the
+ *      sign it has in the literature.
+ *
+ */
+
+#include <stdio.h>
+#include "pnm.h"
+#include "parallel.h"
+
+typedef struct Convolve_T *Convolve_T;
+
+/* reads a kernel, or returns NULL if fp does not hold one */
+extern Convolve_T Convolve_read(FILE *fp);
+
+extern void Convolve_free(Convolve_T *kernel);
+
+extern int Convolve_width(Convolve_T kernel);
+extern int Convolve_height(Convolve_T kernel);
+
+/* nonzero if the kernel is applied in two 1D passes */
+extern int Convolve_separable(Convolve_T kernel);
+
+/* replaces the image with its convolution with kernel; pixels past
+   the edges repeat the nearest edge pixel.  Same requirements and
+   effect on pixmap as Resample_rotate (see resample.h). */
+extern void Convolve_apply(Pnm_ppm pixmap, Convolve_T kernel,
+                           Parallel_T pool);
+
+#endif
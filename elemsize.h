@@ -0,0 +1,48 @@
+#ifndef ELEMSIZE_INCLUDED
+#define ELEMSIZE_INCLUDED
+/*
+ *      elemsize.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              macros for generating copies of a loop or function that
+ *              are specialized to the element sizes we see most often
+ *              (1, 2, 3, 4, 6, 8 and 12 bytes; 1, 2, 3 and 6 are packed
+ *              pgm and ppm pixels, and 12 is a Pnm_rgb).
+ *              Inside a specialization the element size is a constant,
+ *              so strides fold into the addressing and element copies
+ *              become fixed-size moves the compiler can unroll and
+ *              vectorize. Every user keeps a generic version for any
+ *              other size.
+ *
+ *      Usage:
+ *
+ *              #define MY_CASE(N, FUNC) case N: FUNC(a, N); break;
+ *              switch (size) {
+ *              ELEMSIZE_FOREACH(MY_CASE, my_loop)
+ *              default: my_loop(a, size);
+ *              }
+ *
+ *      where my_loop is declared ELEMSIZE_INLINE so that each case
+ *      gets its own copy with the size folded in.
+ *
+ */
+
+#include <string.h>
+
+/* expands X(N, ...) once for each specialized element size N */
+#define ELEMSIZE_FOREACH(X, ...) \
+        X(1, __VA_ARGS__) X(2, __VA_ARGS__) X(3, __VA_ARGS__) \
+        X(4, __VA_ARGS__) X(6, __VA_ARGS__) X(8, __VA_ARGS__) \
+        X(12, __VA_ARGS__)
+
+/* for loops meant to be instantiated once per element size */
+#define ELEMSIZE_INLINE static inline __attribute__((always_inline))
+
+/* copies one element; a fixed-size move when N is a constant */
+#define ELEMSIZE_COPY(DST, SRC, N) memcpy((DST), (SRC), (N))
+
+#endif
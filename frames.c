@@ -0,0 +1,482 @@
+/*
+ *      frames.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of frames.h. The calling thread reads,
+ *              so that bad input raises Pnm_Badformat where the caller
+ *              can catch it; a work thread and a write thread are
+ *              started for each Frames_run. The stages hand frames on
+ *              through two queues of QUEUE_DEPTH frames each, so at
+ *              most 2 * QUEUE_DEPTH + 3 frames are in memory at once.
+ *
+ *              The work and write threads never raise. When one of
+ *              them fails it closes the queue it feeds or is fed by;
+ *              a put into a closed queue is refused, so the stage
+ *              before stops too, and every frame left in a queue is
+ *              recycled. Frames_run raises once all three have stopped.
+ *
+ *              Spare pixmaps are kept, oldest first, in a short list
+ *              shared by the three threads under a lock. A spare is
+ *              reused for anything that wants the same methods, size,
+ *              element size and block shape; the block shape a read
+ *              gives is learned from the last array made for one.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "except.h"
+#include "a2cursor.h"
+#include "p6.h"
+#include "frames.h"
+
+#define QUEUE_DEPTH 2   /* frames waiting between two stages */
+#define SPARES 4        /* pixmaps kept for reuse */
+
+Except_T Frames_Failed = { "Could not transform or write a frame" };
+
+/* frames waiting for the next stage, in order */
+struct queue {
+        Pnm_ppm items[QUEUE_DEPTH];
+        int head, count;
+        bool closed;            /* no more frames are coming */
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+};
+
+/* what the arrays of a pixmap look like, for matching spares */
+struct shape {
+        A2Methods_T methods;
+        int width, height, size;
+        int bw, bh;
+};
+
+struct Frames_T {
+        A2Methods_T methods;
+        int blockw, blockh;
+        int packable;
+        struct shape read;      /* of the last array made for a read,
+                                   methods NULL before the first */
+        pthread_mutex_t lock;   /* for the spares */
+        Pnm_ppm spares[SPARES];
+        int nspares;
+};
+
+/* one Frames_run, shared by its threads */
+struct run {
+        Frames_T frames;
+        FILE *out;
+        Frames_work *work;
+        void *cl;
+        struct queue todo;      /* read, to be transformed */
+        struct queue done;      /* transformed, to be written */
+        double pixels;          /* written so far */
+        bool work_failed;       /* set by the work thread */
+        bool write_failed;      /* set by the write thread; both are
+                                   read once the threads are joined */
+};
+
+
+Frames_T Frames_new(A2Methods_T methods, int blockw, int blockh,
+                    int packable)
+{
+        assert(methods != NULL && A2Methods_cursor(methods) != NULL);
+        Frames_T frames = calloc(1, sizeof(*frames));
+        assert(frames != NULL);
+
+        frames->methods = methods;
+        frames->blockw = blockw;
+        frames->blockh = blockh;
+        frames->packable = packable;
+        pthread_mutex_init(&frames->lock, NULL);
+        return frames;
+}
+
+void Frames_free(Frames_T *frames)
+{
+        assert(frames != NULL && *frames != NULL);
+
+        for (int i = 0; i < (*frames)->nspares; i++)
+                Pnm_ppmfree(&(*frames)->spares[i]);
+        pthread_mutex_destroy(&(*frames)->lock);
+        free(*frames);
+        *frames = NULL;
+}
+
+
+/********** shape_of ********
+ *
+ *      what pixmap's array looks like
+ *
+ ******************************/
+static struct shape shape_of(Pnm_ppm pixmap)
+{
+        struct shape s = { pixmap->methods, pixmap->width, pixmap->height,
+                           pixmap->methods->size(pixmap->pixels), 0, 0 };
+
+        A2Methods_cursor(pixmap->methods)->blockshape(pixmap->pixels,
+                                                      &s.bw, &s.bh);
+        return s;
+}
+
+static bool same_shape(const struct shape *a, const struct shape *b)
+{
+        return a->methods == b->methods && a->width == b->width
+               && a->height == b->height && a->size == b->size
+               && a->bw == b->bw && a->bh == b->bh;
+}
+
+/********** take_spare ********
+ *
+ *      takes the oldest spare pixmap of the given shape off the list
+ *
+ *      Return:
+ *              the pixmap, or NULL if there is none
+ *
+ ******************************/
+static Pnm_ppm take_spare(Frames_T frames, const struct shape *want)
+{
+        Pnm_ppm found = NULL;
+
+        pthread_mutex_lock(&frames->lock);
+        for (int i = 0; i < frames->nspares; i++) {
+                struct shape s = shape_of(frames->spares[i]);
+                if (!same_shape(&s, want))
+                        continue;
+                found = frames->spares[i];
+                memmove(&frames->spares[i], &frames->spares[i + 1],
+                        (frames->nspares - i - 1) * sizeof(Pnm_ppm));
+                frames->nspares--;
+                break;
+        }
+        pthread_mutex_unlock(&frames->lock);
+        return found;
+}
+
+/********** Frames_recycle ********
+ *
+ *      puts a pixmap on the list of spares
+ *
+ *      Notes:
+ *              when the list is full the oldest spare is freed, so a
+ *              stream whose sizes keep changing does not hold on to
+ *              more than SPARES pixmaps
+ *
+ ******************************/
+void Frames_recycle(Frames_T frames, Pnm_ppm pixmap)
+{
+        assert(frames != NULL && pixmap != NULL);
+        Pnm_ppm oldest = NULL;
+
+        pthread_mutex_lock(&frames->lock);
+        if (frames->nspares == SPARES) {
+                oldest = frames->spares[0];
+                memmove(&frames->spares[0], &frames->spares[1],
+                        (SPARES - 1) * sizeof(Pnm_ppm));
+                frames->nspares--;
+        }
+        frames->spares[frames->nspares++] = pixmap;
+        pthread_mutex_unlock(&frames->lock);
+
+        if (oldest != NULL)
+                Pnm_ppmfree(&oldest);
+}
+
+/********** Frames_result ********
+ *
+ *      a pixmap for work to put its result in
+ *
+ *      Parameters:
+ *              Frames_T frames: the stream
+ *              Pnm_ppm like: the pixmap whose methods, element size,
+ *                            block shape and denominator it gets
+ *              int width, height: its size
+ *
+ *      Return:
+ *              a spare of that shape, or a new pixmap; its pixels are
+ *              whatever was left in them
+ *
+ ******************************/
+Pnm_ppm Frames_result(Frames_T frames, Pnm_ppm like, int width, int height)
+{
+        assert(frames != NULL && like != NULL);
+        struct shape want = shape_of(like);
+        want.width = width;
+        want.height = height;
+
+        Pnm_ppm result = take_spare(frames, &want);
+        if (result == NULL) {
+                result = malloc(sizeof(*result));
+                assert(result != NULL);
+                result->width = width;
+                result->height = height;
+                result->methods = like->methods;
+                result->pixels = A2Methods_cursor(like->methods)
+                        ->new_with_blockshape(width, height, want.size,
+                                              want.bw, want.bh);
+        }
+        result->denominator = like->denominator;
+        return result;
+}
+
+
+/********** read_frame ********
+ *
+ *      reads the next frame, into a spare pixmap if there is one of the
+ *      shape a new one would have
+ *
+ *      Notes:
+ *              raises Pnm_Badformat if the frame is malformed
+ *
+ ******************************/
+static Pnm_ppm read_frame(Frames_T frames, FILE *fp)
+{
+        P6_header header;
+        P6_readheader(fp, &header);
+
+        int packed = frames->packable && (header.channels == 1
+                                          || header.bytes == 2);
+        struct shape want = frames->read;
+        want.width = header.width;
+        want.height = header.height;
+        want.size = packed ? P6_packedsize(&header)
+                           : (int)sizeof(struct Pnm_rgb);
+
+        Pnm_ppm frame = NULL;
+        if (want.methods != NULL)
+                frame = take_spare(frames, &want);
+        if (frame != NULL) {
+                P6_readpixels(fp, &header, frame, packed, NULL);
+                return frame;
+        }
+
+        frame = P6_readimage(fp, &header, frames->methods, frames->blockw,
+                             frames->blockh, packed, NULL);
+        frames->read = shape_of(frame);
+        return frame;
+}
+
+bool Frames_more(FILE *fp)
+{
+        int c;
+
+        do
+                c = getc(fp);
+        while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        if (c == EOF)
+                return false;
+        ungetc(c, fp);
+        return true;
+}
+
+
+static void queue_init(struct queue *q)
+{
+        q->head = q->count = 0;
+        q->closed = false;
+        pthread_mutex_init(&q->lock, NULL);
+        pthread_cond_init(&q->changed, NULL);
+}
+
+static void queue_destroy(struct queue *q)
+{
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->changed);
+}
+
+/* adds a frame, waiting for room; returns false, without adding it,
+   if the queue has been closed */
+static bool queue_put(struct queue *q, Pnm_ppm frame)
+{
+        bool open;
+
+        pthread_mutex_lock(&q->lock);
+        while (q->count == QUEUE_DEPTH && !q->closed)
+                pthread_cond_wait(&q->changed, &q->lock);
+        open = !q->closed;
+        if (open) {
+                q->items[(q->head + q->count) % QUEUE_DEPTH] = frame;
+                q->count++;
+                pthread_cond_broadcast(&q->changed);
+        }
+        pthread_mutex_unlock(&q->lock);
+        return open;
+}
+
+/* says no more frames are coming, or that none are wanted */
+static void queue_close(struct queue *q)
+{
+        pthread_mutex_lock(&q->lock);
+        q->closed = true;
+        pthread_cond_broadcast(&q->changed);
+        pthread_mutex_unlock(&q->lock);
+}
+
+/* the next frame, waiting for one; NULL once the queue is closed and
+   empty */
+static Pnm_ppm queue_take(struct queue *q)
+{
+        Pnm_ppm frame = NULL;
+
+        pthread_mutex_lock(&q->lock);
+        while (q->count == 0 && !q->closed)
+                pthread_cond_wait(&q->changed, &q->lock);
+        if (q->count > 0) {
+                frame = q->items[q->head];
+                q->head = (q->head + 1) % QUEUE_DEPTH;
+                q->count--;
+                pthread_cond_broadcast(&q->changed);
+        }
+        pthread_mutex_unlock(&q->lock);
+        return frame;
+}
+
+
+/* closes q and recycles the frames left in it */
+static void queue_drain(struct queue *q, Frames_T frames)
+{
+        Pnm_ppm frame;
+
+        queue_close(q);
+        while ((frame = queue_take(q)) != NULL)
+                Frames_recycle(frames, frame);
+}
+
+/********** work_main ********
+ *
+ *      the work thread: transforms frames until there are no more
+ *
+ *      Notes:
+ *              if work fails, or the write thread has stopped taking
+ *              results, the frames still to come are refused and
+ *              recycled
+ *
+ ******************************/
+static void *work_main(void *arg)
+{
+        struct run *run = arg;
+        Pnm_ppm frame;
+
+        while ((frame = queue_take(&run->todo)) != NULL) {
+                Pnm_ppm result = run->work(run->frames, frame, run->cl);
+                if (result == NULL) {
+                        run->work_failed = true;
+                        break;
+                }
+                if (!queue_put(&run->done, result)) {
+                        Frames_recycle(run->frames, result);
+                        break;
+                }
+        }
+        queue_drain(&run->todo, run->frames);
+        queue_close(&run->done);
+        return NULL;
+}
+
+/********** write_main ********
+ *
+ *      the write thread: writes results until there are no more
+ *
+ *      Notes:
+ *              after a failed write nothing more is written; the queue
+ *              is closed so that the work thread stops too
+ *
+ ******************************/
+static void *write_main(void *arg)
+{
+        struct run *run = arg;
+        Pnm_ppm result;
+
+        while ((result = queue_take(&run->done)) != NULL) {
+                int written = P6_write(run->out, result, NULL);
+                run->pixels += (double)result->width * result->height;
+                Frames_recycle(run->frames, result);
+                if (!written) {
+                        run->write_failed = true;
+                        break;
+                }
+        }
+        queue_drain(&run->done, run->frames);
+        return NULL;
+}
+
+/********** Frames_run ********
+ *
+ *      transforms every frame of a stream
+ *
+ *      Parameters:
+ *              Frames_T frames: how to read the frames, and the spares
+ *              FILE *in: the frames, one after another
+ *              FILE *out: where the results go
+ *              Frames_work *work: transforms a frame
+ *              void *cl: passed to work
+ *              double *pixels: set to the pixels written
+ *
+ *      Return:
+ *              the number of frames
+ *
+ *      Notes:
+ *              work runs on a thread of its own, one frame at a time,
+ *              so it may use a Parallel_T that nothing else is using;
+ *              results are written without one
+ *              a malformed frame ends the stream: the frames before it
+ *              are finished and the threads joined before
+ *              Pnm_Badformat is raised again
+ *              a frame that work or the write fails on also ends it,
+ *              with Frames_Failed, raised here once the threads are
+ *              joined; frames not yet written are dropped
+ *              an empty stream is no frames, not an error
+ *
+ ******************************/
+int Frames_run(Frames_T frames, FILE *in, FILE *out, Frames_work *work,
+               void *cl, double *pixels)
+{
+        assert(frames != NULL && in != NULL && out != NULL);
+        assert(work != NULL && pixels != NULL);
+
+        struct run run = { frames, out, work, cl, .pixels = 0,
+                           .work_failed = false, .write_failed = false };
+        pthread_t work_thread, write_thread;
+        volatile int count = 0;
+        volatile bool failed = false;
+        int err;
+
+        queue_init(&run.todo);
+        queue_init(&run.done);
+        err = pthread_create(&work_thread, NULL, work_main, &run);
+        assert(err == 0);
+        err = pthread_create(&write_thread, NULL, write_main, &run);
+        assert(err == 0);
+
+        TRY
+                while (Frames_more(in)) {
+                        Pnm_ppm frame = read_frame(frames, in);
+                        if (!queue_put(&run.todo, frame)) {
+                                Frames_recycle(frames, frame);
+                                break;
+                        }
+                        count++;
+                }
+        EXCEPT(Pnm_Badformat)
+                failed = true;
+        END_TRY;
+
+        queue_close(&run.todo);
+        pthread_join(work_thread, NULL);
+        pthread_join(write_thread, NULL);
+        queue_destroy(&run.todo);
+        queue_destroy(&run.done);
+
+        if (failed)
+                RAISE(Pnm_Badformat);
+        if (run.work_failed || run.write_failed)
+                RAISE(Frames_Failed);
+        *pixels = run.pixels;
+        return count;
+}
@@ -0,0 +1,85 @@
+#ifndef FRAMES_INCLUDED
+#define FRAMES_INCLUDED
+/*
+ *      frames.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              interface to Frames_T, which transforms a stream of ppm
+ *              or pgm images, one after another in the same file, until
+ *              the file ends. Reading, transforming and writing are
+ *              three stages on three threads, joined by short queues,
+ *              so while one frame is transformed the next is read and
+ *              the one before is written. Each stage takes frames in
+ *              order, so they come out in the order they went in.
+ *
+ *              Pixmaps are recycled: one that has been written, or a
+ *              frame that has been transformed, is kept and filled
+ *              again by a later frame of the same size rather than
+ *              freed, so a stream of equally sized frames allocates
+ *              only its first few arrays.
+ *
+ *      Usage:
+ *
+ *              Frames_T frames = Frames_new(methods, 0, 0, 1);
+ *              int n = Frames_run(frames, stdin, stdout, work, cl,
+ *                                 &pixels);
+ *              Frames_free(&frames);
+ *
+ *      where work(frames, frame, cl) transforms frame on the middle
+ *      thread and returns the result, which may be frame itself or a
+ *      pixmap from Frames_result, and gives back whichever of them it
+ *      no longer needs with Frames_recycle.
+ *
+ *      The stack of TRY frames is one global, so work must not raise:
+ *      it returns NULL if it fails, having given back what it holds. A
+ *      frame that cannot be transformed or written stops the stream
+ *      and Frames_run raises Frames_Failed on the calling thread.
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "a2methods.h"
+#include "except.h"
+#include "pnm.h"
+
+typedef struct Frames_T *Frames_T;
+
+/* a frame could not be transformed or written */
+extern Except_T Frames_Failed;
+
+typedef Pnm_ppm Frames_work(Frames_T frames, Pnm_ppm frame, void *cl);
+
+/* frames are read into arrays of methods, which must have cursors, in
+   blockw x blockh blocks (0 x 0 for the methods' default); a pgm or
+   16-bit ppm is read packed (see p6.h) if packable is nonzero */
+extern Frames_T Frames_new(A2Methods_T methods, int blockw, int blockh,
+                           int packable);
+
+extern void Frames_free(Frames_T *frames);
+
+/* reads every frame of in, passes it through work and writes the result
+   to out; returns the number of frames, and sets *pixels to the pixels
+   written.  Malformed input raises Pnm_Badformat once the frames before
+   it have been written; a failure of work or of a write raises
+   Frames_Failed once the threads have stopped. */
+extern int Frames_run(Frames_T frames, FILE *in, FILE *out,
+                      Frames_work *work, void *cl, double *pixels);
+
+/* a width x height pixmap with like's methods, element size, block shape
+   and denominator, recycled if there is one, for work to fill */
+extern Pnm_ppm Frames_result(Frames_T frames, Pnm_ppm like, int width,
+                             int height);
+
+/* takes back a pixmap that work is done with */
+extern void Frames_recycle(Frames_T frames, Pnm_ppm pixmap);
+
+/* skips the white space after a frame, and says whether another frame
+   follows */
+extern bool Frames_more(FILE *fp);
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ *      fused.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the fused transformations in fused.h.
+ *              Input is read TILE rows at a time, and each band is cut
+ *              into TILE x TILE tiles so that the output rows one tile
+ *              writes to stay in cache while it is copied, whichever way
+ *              the transformation turns it. Pixels are moved as raw
+ *              bytes, never decoded.
+ *
+ *              The output raster is mapped straight onto the output
+ *              file when it is a regular file open for reading and
+ *              writing (as with 1<>out.ppm in the shell); otherwise it
+ *              is one malloc'd buffer written with write.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "except.h"
+#include "pnm.h"
+#include "p6.h"
+#include "fused.h"
+
+#define TILE 64         /* rows per band and columns per tile */
+
+/* for the per-pixel-size copies of the tile loop */
+#define FUSED_INLINE static inline __attribute__((always_inline))
+
+/* where input pixel (x, y) goes: output column xx x + xy y + col0 and
+   output row yx x + yy y + row0 */
+struct forward {
+        int xx, xy;
+        int yx, yy;
+        int turns;                      /* width and height swap */
+};
+
+static const struct forward forwards[] = {
+        [FUSED_ROTATE_0]        = {  1,  0,    0,  1,   0 },
+        [FUSED_ROTATE_90]       = {  0, -1,    1,  0,   1 },
+        [FUSED_ROTATE_180]      = { -1,  0,    0, -1,   0 },
+        [FUSED_ROTATE_270]      = {  0,  1,   -1,  0,   1 },
+        [FUSED_FLIP_HORIZONTAL] = { -1,  0,    0,  1,   0 },
+        [FUSED_FLIP_VERTICAL]   = {  1,  0,    0, -1,   0 },
+        [FUSED_TRANSPOSE]       = {  0,  1,    1,  0,   1 },
+};
+
+struct fused_job {
+        const unsigned char *band;      /* rows [y0, y0 + rows) of input */
+        int y0, rows;
+        int width;                      /* of the input */
+        size_t pitch;                   /* bytes per input row */
+        size_t pixbytes;
+        unsigned char *out;             /* the output raster */
+        unsigned char *origin;          /* where input (0, 0) goes */
+        long dx, dy;                    /* output bytes per input step */
+};
+
+
+/********** move_tile_with ********
+ *
+ *      copies a tw x th tile of input pixels to the output, each pixel
+ *      pixbytes long
+ *
+ *      Notes:
+ *              inlined once for each pixel size, so the copy is a fixed
+ *              size move
+ *
+ ******************************/
+FUSED_INLINE void move_tile_with(const unsigned char *in, size_t pitch,
+                                 unsigned char *out, long dx, long dy,
+                                 int tw, int th, size_t pixbytes)
+{
+        for (int y = 0; y < th; y++) {
+                const unsigned char *s = in + y * pitch;
+                unsigned char *d = out + y * dy;
+
+                for (int x = 0; x < tw; x++, s += pixbytes, d += dx)
+                        memcpy(d, s, pixbytes);
+        }
+}
+
+/********** move_tile ********
+ *
+ *      Parallel_work function: moves tile number item of the band
+ *
+ ******************************/
+static void move_tile(int item, int thread, void *cl)
+{
+        struct fused_job *job = cl;
+        int x0 = item * TILE;
+        int tw = job->width - x0 < TILE ? job->width - x0 : TILE;
+        const unsigned char *in = job->band + x0 * job->pixbytes;
+        unsigned char *out = job->origin + x0 * job->dx + job->y0 * job->dy;
+
+        (void)thread;
+        switch (job->pixbytes) {
+        case 1:
+                move_tile_with(in, job->pitch, out, job->dx, job->dy, tw,
+                               job->rows, 1);
+                break;
+        case 2:
+                move_tile_with(in, job->pitch, out, job->dx, job->dy, tw,
+                               job->rows, 2);
+                break;
+        case 3:
+                move_tile_with(in, job->pitch, out, job->dx, job->dy, tw,
+                               job->rows, 3);
+                break;
+        default:
+                move_tile_with(in, job->pitch, out, job->dx, job->dy, tw,
+                               job->rows, 6);
+        }
+}
+
+/********** map_output ********
+ *
+ *      tries to map the output file, header and raster, into memory
+ *
+ *      Return:
+ *              the mapping, or NULL if out cannot be mapped
+ *
+ *      Notes:
+ *              out must be a regular file open for reading and writing,
+ *              not appending, at offset 0; it is cut to exactly the
+ *              output's length, which the write that follows a failed
+ *              mapping then fills from the start
+ *
+ ******************************/
+static unsigned char *map_output(FILE *out, size_t length)
+{
+        int fd = fileno(out);
+        int flags = fcntl(fd, F_GETFL);
+        struct stat st;
+
+        if (flags < 0 || (flags & O_ACCMODE) != O_RDWR || (flags & O_APPEND)
+            || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+            || lseek(fd, 0, SEEK_CUR) != 0 || ftruncate(fd, length) != 0)
+                return NULL;
+
+        void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, 0);
+        return map == MAP_FAILED ? NULL : map;
+}
+
+/* writes n bytes to fd; returns 0 if a write fails */
+static int write_bytes(int fd, const unsigned char *p, size_t n)
+{
+        while (n > 0) {
+                ssize_t done = write(fd, p, n);
+                if (done < 0 && errno == EINTR)
+                        continue;
+                if (done <= 0)
+                        return 0;
+                p += done;
+                n -= done;
+        }
+        return 1;
+}
+
+/********** Fused_transform ********
+ *
+ *      transforms a P6 or P5 file into another without decoding it
+ *
+ *      Parameters:
+ *              FILE *in: the input, positioned after its header
+ *              const P6_header *header: the header, read with
+ *                               P6_readheader, of a P6 or P5 file
+ *              FILE *out: where to write the output
+ *              Fused_op op: the transformation
+ *              Parallel_T pool: threads to share each band's tiles, or
+ *                               NULL
+ *
+ *      Return:
+ *              the number of pixels
+ *
+ *      Notes:
+ *              raises Pnm_Badformat if in ends early; a plain (P3 or
+ *              P2) header is a checked runtime error, so callers check
+ *              header->raw first
+ *
+ ******************************/
+double Fused_transform(FILE *in, const P6_header *header, FILE *out,
+                       Fused_op op, Parallel_T pool)
+{
+        const struct forward *f = &forwards[op];
+
+        assert(in != NULL && header != NULL && out != NULL);
+        assert(header->raw);
+        assert(op >= FUSED_ROTATE_0 && op <= FUSED_TRANSPOSE);
+
+        int w = header->width;
+        int h = header->height;
+        int outw = f->turns ? h : w;
+        int outh = f->turns ? w : h;
+
+        struct fused_job job;
+        job.width = w;
+        job.pixbytes = P6_packedsize(header);
+        job.pitch = w * job.pixbytes;
+        job.dx = ((long)f->yx * outw + f->xx) * (long)job.pixbytes;
+        job.dy = ((long)f->yy * outw + f->xy) * (long)job.pixbytes;
+
+        char head[64];
+        size_t hlen = snprintf(head, sizeof(head), "P%c\n%d %d\n%u\n",
+                               header->channels == 1 ? '5' : '6', outw, outh,
+                               header->maxval);
+        size_t size = (size_t)outh * outw * job.pixbytes;
+
+        int err = fflush(out);
+        assert(err == 0);
+        unsigned char *map = map_output(out, hlen + size);
+        if (map != NULL) {
+                memcpy(map, head, hlen);
+                job.out = map + hlen;
+        } else {
+                job.out = malloc(size);
+                assert(job.out != NULL);
+        }
+
+        int col0 = (f->xx < 0 ? w - 1 : 0) + (f->xy < 0 ? h - 1 : 0);
+        int row0 = (f->yx < 0 ? w - 1 : 0) + (f->yy < 0 ? h - 1 : 0);
+        job.origin = job.out + ((size_t)row0 * outw + col0) * job.pixbytes;
+
+        unsigned char *band = malloc(TILE * job.pitch);
+        assert(band != NULL);
+        job.band = band;
+
+        int tiles = (w + TILE - 1) / TILE;
+        int whole = 1;
+        for (job.y0 = 0; job.y0 < h && whole; job.y0 += TILE) {
+                job.rows = h - job.y0 < TILE ? h - job.y0 : TILE;
+                whole = fread(band, job.pitch, job.rows, in)
+                        == (size_t)job.rows;
+                if (whole)
+                        Parallel_for(pool, tiles, move_tile, &job);
+        }
+        free(band);
+
+        int written = 1;
+        if (map != NULL) {
+                err = munmap(map, hlen + size);
+                assert(err == 0);
+                lseek(fileno(out), hlen + size, SEEK_SET);
+        } else {
+                if (whole)
+                        written = write_bytes(fileno(out),
+                                              (unsigned char *)head, hlen)
+                                  && write_bytes(fileno(out), job.out, size);
+                free(job.out);
+        }
+        if (!whole)
+                RAISE(Pnm_Badformat);
+        assert(written);
+        return (double)w * h;
+}
@@ -0,0 +1,43 @@
+#ifndef FUSED_INCLUDED
+#define FUSED_INCLUDED
+/*
+ *      fused.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the right-angle transformations done straight from a P6
+ *              (or P5) file to another, with no A2Methods array between. For
+ *              these the output position of every input pixel is a
+ *              closed-form function of its position, so each band of
+ *              input rows is read and its pixels' bytes are copied
+ *              directly to their places in the output raster, which is
+ *              the only full-size buffer and is written once.
+ *
+ */
+
+#include <stdio.h>
+#include "parallel.h"
+#include "p6.h"
+
+typedef enum {
+        FUSED_ROTATE_0 = 0,
+        FUSED_ROTATE_90,
+        FUSED_ROTATE_180,
+        FUSED_ROTATE_270,
+        FUSED_FLIP_HORIZONTAL,
+        FUSED_FLIP_VERTICAL,
+        FUSED_TRANSPOSE
+} Fused_op;
+
+/* reads the pixels of a P6 ppm or P5 pgm from in, whose header has been
+   read with P6_readheader, and writes the image, transformed and in the
+   same format, to out; returns the number of pixels.  A plain (P3 or P2)
+   header is a checked runtime error; raises Pnm_Badformat (see pnm.h) if
+   in ends early; failing to write is a checked runtime error. */
+extern double Fused_transform(FILE *in, const P6_header *header,
+                              FILE *out, Fused_op op, Parallel_T pool);
+
+#endif
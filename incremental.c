@@ -0,0 +1,297 @@
+/*
+ *      incremental.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of incremental.h. Each tile of the result
+ *              is an item of Parallel_for: its source rectangle is found
+ *              with Ppmtrans_source, compared between the two frames a
+ *              run at a time, and only if they differ is the tile redone
+ *              with Ppmtrans_region. An unchanged tile costs a read of
+ *              its source in both frames and no writes.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "incremental.h"
+
+#define TILE 64         /* cells across and down a tile of an unblocked
+                           result */
+
+struct Incremental_T {
+        Ppmtrans_op op;
+        Ppmtrans_hints hints;
+        Pnm_ppm prev;           /* the previous frame, NULL before the
+                                   first */
+        Pnm_ppm result;         /* kept from frame to frame */
+        int tile_w, tile_h;     /* of the result */
+        int tiles_down;
+        int ntiles;
+        unsigned char *touched; /* per tile, for the last frame */
+};
+
+
+Incremental_T Incremental_new(Ppmtrans_op op, const Ppmtrans_hints *hints)
+{
+        Incremental_T inc = malloc(sizeof(*inc));
+        assert(inc != NULL);
+
+        inc->op = op;
+        inc->hints = hints != NULL ? *hints : (Ppmtrans_hints){ 0, false };
+        inc->prev = NULL;
+        inc->result = NULL;
+        inc->ntiles = 0;
+        inc->touched = NULL;
+        return inc;
+}
+
+void Incremental_free(Incremental_T *inc)
+{
+        assert(inc != NULL && *inc != NULL);
+
+        if ((*inc)->prev != NULL)
+                Pnm_ppmfree(&(*inc)->prev);
+        if ((*inc)->result != NULL)
+                Pnm_ppmfree(&(*inc)->result);
+        free((*inc)->touched);
+        free(*inc);
+        *inc = NULL;
+}
+
+
+/********** like_prev ********
+ *
+ *      whether frame can be compared with the previous frame, which
+ *      needs the same size, methods and block shape
+ *
+ ******************************/
+static bool like_prev(Incremental_T inc, Pnm_ppm frame)
+{
+        Pnm_ppm prev = inc->prev;
+        int bw, bh, pw, ph;
+
+        if (prev == NULL || prev->width != frame->width
+            || prev->height != frame->height
+            || prev->methods != frame->methods
+            || prev->methods->size(prev->pixels)
+               != frame->methods->size(frame->pixels))
+                return false;
+
+        A2Methods_CursorT cursors = A2Methods_cursor(frame->methods);
+        cursors->blockshape(frame->pixels, &bw, &bh);
+        cursors->blockshape(prev->pixels, &pw, &ph);
+        return bw == pw && bh == ph;
+}
+
+/********** start_over ********
+ *
+ *      makes a new result for frame, with frame's methods and block
+ *      shape, and works out its tiles
+ *
+ ******************************/
+static void start_over(Incremental_T inc, Pnm_ppm frame)
+{
+        A2Methods_T methods = frame->methods;
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        int w, h, bw, bh;
+
+        Ppmtrans_size(inc->op, frame->width, frame->height, &w, &h);
+        cursors->blockshape(frame->pixels, &bw, &bh);
+        if (inc->result != NULL)
+                Pnm_ppmfree(&inc->result);
+
+        Pnm_ppm result = malloc(sizeof(*result));
+        assert(result != NULL);
+        result->width = w;
+        result->height = h;
+        result->methods = methods;
+        result->pixels = cursors->new_with_blockshape(w, h,
+                                methods->size(frame->pixels), bw, bh);
+        inc->result = result;
+
+        inc->tile_w = bw * bh > 1 ? bw : TILE;
+        inc->tile_h = bw * bh > 1 ? bh : TILE;
+        inc->tiles_down = (h + inc->tile_h - 1) / inc->tile_h;
+        inc->ntiles = (w + inc->tile_w - 1) / inc->tile_w * inc->tiles_down;
+        free(inc->touched);
+        inc->touched = calloc(inc->ntiles > 0 ? inc->ntiles : 1, 1);
+        assert(inc->touched != NULL);
+}
+
+
+/********** same_pixels ********
+ *
+ *      whether the w x h rectangles at (x, y) of the two frames hold
+ *      the same pixels
+ *
+ *      Notes:
+ *              the rectangles are walked along the storage direction,
+ *              where runs are longest; both frames have the same layout,
+ *              so a run of one matches a run of the other
+ *
+ ******************************/
+static bool same_pixels(Pnm_ppm a, Pnm_ppm b, int x, int y, int w, int h)
+{
+        A2Methods_CursorT cursors = A2Methods_cursor(a->methods);
+        int size = a->methods->size(a->pixels);
+        int vertical = A2Methods_by_column(cursors, a->pixels);
+        int lines = vertical ? w : h;
+        int len = vertical ? h : w;
+        A2Methods_Run ra, rb;
+
+        for (int l = 0; l < lines; l++) {
+                int col = vertical ? x + l : x;
+                int row = vertical ? y : y + l;
+
+                for (int k = 0; k < len; k += ra.count) {
+                        cursors->run_at(a->pixels, col, row, !vertical,
+                                        vertical, len - k, &ra);
+                        cursors->run_at(b->pixels, col, row, !vertical,
+                                        vertical, len - k, &rb);
+                        if (ra.stride == size) {
+                                if (memcmp(ra.elem, rb.elem,
+                                           (size_t)ra.count * size) != 0)
+                                        return false;
+                        } else {
+                                const char *pa = ra.elem, *pb = rb.elem;
+                                for (int i = 0; i < ra.count; i++,
+                                     pa += ra.stride, pb += ra.stride)
+                                        if (memcmp(pa, pb, size) != 0)
+                                                return false;
+                        }
+                        col += ra.count * ra.dcol;
+                        row += ra.count * ra.drow;
+                }
+        }
+        return true;
+}
+
+/********** in_memory ********
+ *
+ *      whether the frames and the result all keep their cells in
+ *      memory, so that tiles may be done on several threads; a
+ *      compressed array (see uarray2c.h) must stay on one
+ *
+ ******************************/
+static bool in_memory(Incremental_T inc, Pnm_ppm frame)
+{
+        A2Methods_CursorT cursors = A2Methods_cursor(frame->methods);
+        size_t len;
+
+        return cursors->storage(frame->pixels, &len) != NULL
+               && cursors->storage(inc->prev->pixels, &len) != NULL
+               && cursors->storage(inc->result->pixels, &len) != NULL;
+}
+
+/* the frames of one call of Incremental_next */
+struct tile_job {
+        Incremental_T inc;
+        Pnm_ppm frame;
+        int err;                /* PPMTRANS_OK unless a tile failed */
+};
+
+/********** redo_tile ********
+ *
+ *      Parallel_work function: redoes tile number item of the result
+ *      if its source changed, noting whether it did
+ *
+ *      Notes:
+ *              tiles are numbered down each column of tiles, the order
+ *              blocks are stored in
+ *              a failure is left in job->err, as the pool's threads
+ *              must not raise
+ *
+ ******************************/
+static void redo_tile(int item, int thread, void *cl)
+{
+        struct tile_job *job = cl;
+        Incremental_T inc = job->inc;
+        Pnm_ppm result = inc->result;
+        int x = item / inc->tiles_down * inc->tile_w;
+        int y = item % inc->tiles_down * inc->tile_h;
+        int w = (int)result->width - x;
+        int h = (int)result->height - y;
+        int sx, sy, sw, sh;
+
+        (void)thread;
+        w = w < inc->tile_w ? w : inc->tile_w;
+        h = h < inc->tile_h ? h : inc->tile_h;
+        Ppmtrans_source(inc->op, job->frame->width, job->frame->height, x, y,
+                        w, h, &sx, &sy, &sw, &sh);
+
+        inc->touched[item] = !same_pixels(job->frame, inc->prev, sx, sy, sw,
+                                          sh);
+        if (inc->touched[item]) {
+                int err = Ppmtrans_region(inc->op, job->frame, result, x, y,
+                                          w, h, &inc->hints);
+                if (err != PPMTRANS_OK)
+                        __atomic_store_n(&job->err, err, __ATOMIC_RELAXED);
+        }
+}
+
+
+/********** Incremental_next ********
+ *
+ *      transforms the next frame
+ *
+ *      Parameters:
+ *              Incremental_T inc: the sequence
+ *              Pnm_ppm frame: the frame, which inc takes over
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return:
+ *              the result, owned by inc
+ *
+ *      Notes:
+ *              CRE if frame's methods have no cursors
+ *              the first frame, and one unlike the frame before, is
+ *              transformed whole, and counts every tile as touched
+ *              frames in compressed arrays are done on the calling
+ *              thread, whatever the pool
+ *
+ ******************************/
+Pnm_ppm Incremental_next(Incremental_T inc, Pnm_ppm frame, Parallel_T pool)
+{
+        assert(inc != NULL && frame != NULL);
+        assert(A2Methods_cursor(frame->methods) != NULL);
+
+        int err;
+
+        if (!like_prev(inc, frame)) {
+                start_over(inc, frame);
+                inc->result->denominator = frame->denominator;
+                err = Ppmtrans_pixmap(inc->op, frame, inc->result,
+                                      &inc->hints, pool);
+                memset(inc->touched, 1, inc->ntiles);
+        } else {
+                struct tile_job job = { inc, frame, PPMTRANS_OK };
+                inc->result->denominator = frame->denominator;
+                Parallel_for(in_memory(inc, frame) ? pool : NULL,
+                             inc->ntiles, redo_tile, &job);
+                err = job.err;
+        }
+
+        if (inc->prev != NULL)
+                Pnm_ppmfree(&inc->prev);
+        inc->prev = frame;
+        assert(err == PPMTRANS_OK);
+        return inc->result;
+}
+
+int Incremental_touched(Incremental_T inc, int *tiles)
+{
+        assert(inc != NULL && tiles != NULL);
+        int touched = 0;
+
+        for (int t = 0; t < inc->ntiles; t++)
+                touched += inc->touched[t];
+        *tiles = inc->ntiles;
+        return touched;
+}
@@ -0,0 +1,54 @@
+#ifndef INCREMENTAL_INCLUDED
+#define INCREMENTAL_INCLUDED
+/*
+ *      incremental.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              right-angle transformation of a sequence of frames that
+ *              change little from one to the next. The result is kept
+ *              from frame to frame, cut into tiles (its blocks, or
+ *              64 x 64 pieces of an unblocked array), and a tile is only
+ *              redone when the pixels it comes from differ from those of
+ *              the previous frame. Frames are compared pixel for pixel,
+ *              not by hash, so a result is always exact.
+ *
+ *              A frame of a different size, methods or block shape from
+ *              the one before is transformed whole.
+ *
+ *      Usage:
+ *
+ *              Incremental_T inc = Incremental_new(PPMTRANS_ROTATE_90,
+ *                                                  NULL);
+ *              while ((frame = ... next frame ...) != NULL)
+ *                      P6_write(out, Incremental_next(inc, frame, pool),
+ *                               pool);
+ *              Incremental_free(&inc);
+ *
+ */
+
+#include "pnm.h"
+#include "parallel.h"
+#include "libppmtrans.h"
+
+typedef struct Incremental_T *Incremental_T;
+
+/* hints may be NULL; they are copied */
+extern Incremental_T Incremental_new(Ppmtrans_op op,
+                                     const Ppmtrans_hints *hints);
+
+extern void Incremental_free(Incremental_T *inc);
+
+/* transforms frame, whose methods must have cursors, and takes it over
+   to compare with the next one.  Returns the result, which belongs to
+   inc and stays good until the next call. */
+extern Pnm_ppm Incremental_next(Incremental_T inc, Pnm_ppm frame,
+                                Parallel_T pool);
+
+/* the tiles of the result redone for the last frame, out of *tiles */
+extern int Incremental_touched(Incremental_T inc, int *tiles);
+
+#endif
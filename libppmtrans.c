@@ -0,0 +1,791 @@
+/*
+ *      libppmtrans.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of libppmtrans.h. Pixmaps are transformed
+ *              by the cursor-driven copy that ppmtrans has always used:
+ *              the destination is walked in storage order, a run at a
+ *              time, and each run is filled from the matching line of
+ *              the source. Rasters are cut into TILE x TILE tiles of
+ *              the source, each copied with a fixed-size move per pixel.
+ *
+ *              The copy loops report every access to the cache simulator
+ *              in a CACHESIM build.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "a2cursor.h"
+#include "cachesim.h"
+#include "elemsize.h"
+#include "libppmtrans.h"
+
+/* of columns per item when a plain array is transformed in parallel */
+#define STRIP_BYTES (64 * 1024)
+
+#define TILE 64         /* pixels across and down a tile of a raster */
+
+/********** transformation coefficients ********
+ *
+ *      The same seven transformations written as coefficients, one
+ *      per Ppmtrans_op: the source of destination cell (i, j) is
+ *
+ *              column = ci * i + cj * j + cw * (width - 1)
+ *              row    = ri * i + rj * j + rh * (height - 1)
+ *
+ *      so a straight run of destination cells always comes from a
+ *      straight line of source cells.
+ *      
+ ******************************/
+struct Xform {
+        int ci, cj, cw;
+        int ri, rj, rh;
+};
+
+/*                                        source column   source row */
+static const struct Xform xforms[] = {
+        [PPMTRANS_ROTATE_0]             = {  1,  0,  0,    0,  1,  0 },
+        [PPMTRANS_ROTATE_90]            = {  0,  1,  0,   -1,  0,  1 },
+        [PPMTRANS_ROTATE_180]           = { -1,  0,  1,    0, -1,  1 },
+        [PPMTRANS_ROTATE_270]           = {  0, -1,  1,    1,  0,  0 },
+        [PPMTRANS_FLIP_HORIZONTAL]      = { -1,  0,  1,    0,  1,  0 },
+        [PPMTRANS_FLIP_VERTICAL]        = {  1,  0,  0,    0, -1,  1 },
+        [PPMTRANS_TRANSPOSE]            = {  0,  1,  0,    1,  0,  0 },
+};
+
+/* ops that swap width and height */
+static bool turns(Ppmtrans_op op)
+{
+        return op == PPMTRANS_ROTATE_90 || op == PPMTRANS_ROTATE_270
+               || op == PPMTRANS_TRANSPOSE;
+}
+
+
+/********** copy_run ********
+ *
+ *      copies n elements from a strided source run to a strided
+ *      destination run
+ *
+ *      Parameters:
+ *              char *dst: first destination element
+ *              long dstride: bytes between destination elements
+ *              const char *src: first source element
+ *              long sstride: bytes between source elements
+ *              int n: number of elements to copy
+ *              int size: the element size
+ *              int prefetch: prefetch the source element this many
+ *                            ahead of the one being copied, if > 0
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              runs a copy of the loop specialized to the element size
+ *              reports both elements of each copy to the cache simulator
+ *      
+ ******************************/
+#define COPY_ELEM(SIZE) do {                                            \
+        ELEMSIZE_COPY(dst, src, (SIZE));                                \
+        CACHESIM_TRACE(src, (SIZE));                                    \
+        CACHESIM_TRACE(dst, (SIZE));                                    \
+        dst += dstride;                                                 \
+        src += sstride;                                                 \
+} while (false)
+
+ELEMSIZE_INLINE void copy_run_sized(char *dst, long dstride, const char *src,
+                                    long sstride, int n, int size,
+                                    int prefetch)
+{
+        int k = 0;
+
+        if (prefetch > 0)
+                for (; k < n - prefetch; k++) {
+                        __builtin_prefetch(src + prefetch * sstride);
+                        COPY_ELEM(size);
+                }
+        for (; k < n; k++)
+                COPY_ELEM(size);
+}
+
+#define COPY_CASE(N, UNUSED)                                            \
+        case N: copy_run_sized(dst, dstride, src, sstride, n, N, prefetch); \
+                break;
+
+static void copy_run(char *dst, long dstride, const char *src, long sstride,
+                     int n, int size, int prefetch)
+{
+        switch (size) {
+        ELEMSIZE_FOREACH(COPY_CASE, _)
+        default:
+                copy_run_sized(dst, dstride, src, sstride, n, size, prefetch);
+        }
+}
+
+
+/********** stream_run ********
+ *
+ *      copy_run for a destination run whose elements are next to each
+ *      other, written with non-temporal stores so that it does not
+ *      push the source out of the cache
+ *
+ *      Parameters:
+ *              as for copy_run, less dstride, which is size
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              elements are copied normally up to the first 16-byte
+ *              boundary in the destination; from there they are
+ *              gathered a chunk at a time, a chunk being the fewest
+ *              elements that fill whole 16-byte lanes (4 Pnm_rgbs, 16
+ *              bytes), and each lane is stored past the cache; what is
+ *              left at the end is copied normally
+ *              the caller must call store_fence before anything else
+ *              reads the destination
+ *              without SSE2 this is copy_run
+ *      
+ ******************************/
+#ifdef __SSE2__
+ELEMSIZE_INLINE void stream_run_sized(char *dst, const char *src,
+                                      long sstride, int n, int size,
+                                      int prefetch)
+{
+        long dstride = size;
+        int lowbit = size & -size;
+        int chunk = lowbit < 16 ? 16 / lowbit : 1;
+        int lanes = chunk * size / 16;
+        __m128i buf[lanes];
+        int k = 0;
+
+        for (; k < n && ((uintptr_t)dst & 15) != 0; k++)
+                COPY_ELEM(size);
+        for (; k + chunk <= n; k += chunk) {
+                char *b = (char *)buf;
+                for (int e = 0; e < chunk; e++, b += size) {
+                        if (prefetch > 0 && prefetch < n - k - e)
+                                __builtin_prefetch(src + prefetch * sstride);
+                        ELEMSIZE_COPY(b, src, size);
+                        CACHESIM_TRACE(src, size);
+                        CACHESIM_TRACE(dst + e * size, size);
+                        src += sstride;
+                }
+                for (int l = 0; l < lanes; l++)
+                        _mm_stream_si128((__m128i *)dst + l, buf[l]);
+                dst += chunk * size;
+        }
+        for (; k < n; k++)
+                COPY_ELEM(size);
+}
+
+#define STREAM_CASE(N, UNUSED)                                          \
+        case N: stream_run_sized(dst, src, sstride, n, N, prefetch); break;
+
+static void stream_run(char *dst, const char *src, long sstride, int n,
+                       int size, int prefetch)
+{
+        switch (size) {
+        ELEMSIZE_FOREACH(STREAM_CASE, _)
+        default:
+                stream_run_sized(dst, src, sstride, n, size, prefetch);
+        }
+}
+#else
+static void stream_run(char *dst, const char *src, long sstride, int n,
+                       int size, int prefetch)
+{
+        copy_run(dst, size, src, sstride, n, size, prefetch);
+}
+#endif
+
+/* orders non-temporal stores before whatever comes next */
+static inline void store_fence(void)
+{
+#ifdef __SSE2__
+        _mm_sfence();
+#endif
+}
+
+
+/********** prefetch_line ********
+ *
+ *      prefetches the first n elements of a source run
+ *
+ ******************************/
+static inline void prefetch_line(const char *p, long stride, int n)
+{
+        for (int k = 0; k < n; k++, p += stride)
+                __builtin_prefetch(p);
+}
+
+
+/* one call's worth of Ppmtrans_pixmap, shared by every thread of it */
+struct pass {
+        Pnm_ppm src, dst;
+        A2Methods_CursorT from;         /* cursors of src */
+        A2Methods_CursorT to;           /* cursors of dst */
+        const struct Xform *xf;
+        const Ppmtrans_hints *hints;
+        bool in_memory;                 /* both arrays keep all their
+                                           cells in memory, so threads
+                                           may share them */
+};
+
+
+/********** transform_run ********
+ *
+ *      fills one run of the destination from the matching line of the
+ *      source, split wherever the source stride changes
+ *
+ *      Parameters:
+ *              const struct pass *p: the images and transformation
+ *              const A2Methods_Run *dst: the run to fill
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              when prefetching, the next source run (in the next
+ *              block, or the next column of a plain array) is looked
+ *              up before the current one is copied, and its first
+ *              hints->prefetch elements are prefetched, since the
+ *              hardware prefetcher loses the walk where it jumps
+ *      
+ ******************************/
+static void transform_run(const struct pass *p, const A2Methods_Run *dst)
+{
+        A2Methods_UArray2 src = p->src->pixels;
+        A2Methods_CursorT cursors = p->from;
+        const struct Xform *xf = p->xf;
+        int size = p->src->methods->size(src);
+        int wmax = p->src->width - 1;
+        int hmax = p->src->height - 1;
+        int col  = xf->ci * dst->col + xf->cj * dst->row + xf->cw * wmax;
+        int row  = xf->ri * dst->col + xf->rj * dst->row + xf->rh * hmax;
+        int dcol = xf->ci * dst->dcol + xf->cj * dst->drow;
+        int drow = xf->ri * dst->dcol + xf->rj * dst->drow;
+        char *d = dst->elem;
+        int ahead = p->hints->prefetch;
+        bool stream = p->hints->stream && dst->stride == size;
+        A2Methods_Run run, next;
+        int left = dst->count;
+        int n = cursors->run_at(src, col, row, dcol, drow, left, &run);
+
+        for (;;) {
+                int m = 0;
+                if (ahead > 0 && left > n) {
+                        m = cursors->run_at(src, col + n * dcol,
+                                            row + n * drow, dcol, drow,
+                                            left - n, &next);
+                        prefetch_line(next.elem, next.stride,
+                                      m < ahead ? m : ahead);
+                }
+                if (stream)
+                        stream_run(d, run.elem, run.stride, n, size, ahead);
+                else
+                        copy_run(d, dst->stride, run.elem, run.stride, n,
+                                 size, ahead);
+                d += n * dst->stride;
+                col += n * dcol;
+                row += n * drow;
+                left -= n;
+                if (left == 0)
+                        return;
+                if (m > 0) {
+                        run = next;
+                        n = m;
+                } else {
+                        n = cursors->run_at(src, col, row, dcol, drow, left,
+                                            &run);
+                }
+        }
+}
+
+
+/********** cursor_transform ********
+ *
+ *      fills the destination without a callback per element: walks its
+ *      runs in storage order, and fills each with transform_run
+ *
+ ******************************/
+static void cursor_transform(const struct pass *p)
+{
+        A2Methods_Cursor cursor;
+        A2Methods_Run dst;
+
+        p->to->cursor_begin(p->dst->pixels, &cursor);
+        while (p->to->cursor_next_run(&cursor, &dst))
+                transform_run(p, &dst);
+        if (p->hints->stream)
+                store_fence();
+}
+
+
+/* a piece of the destination for one thread to fill */
+struct tile_job {
+        const struct pass *p;
+        int vertical;           /* dst keeps columns together */
+        int tile_w, tile_h;
+        int tiles_down;
+        int block_w, block_h;   /* pieces of a tile, done in turn */
+};
+
+/********** transform_block ********
+ *
+ *      fills the w x h piece of the destination at (x0, y0) a line at a
+ *      time along its storage direction
+ *
+ ******************************/
+static void transform_block(struct tile_job *job, int x0, int y0, int w,
+                            int h)
+{
+        const struct pass *p = job->p;
+        int lines = job->vertical ? w : h;
+        int len = job->vertical ? h : w;
+        A2Methods_Run dst;
+
+        for (int l = 0; l < lines; l++) {
+                int col = job->vertical ? x0 + l : x0;
+                int row = job->vertical ? y0 : y0 + l;
+
+                for (int k = 0; k < len; k += dst.count) {
+                        p->to->run_at(p->dst->pixels, col, row,
+                                      !job->vertical, job->vertical,
+                                      len - k, &dst);
+                        transform_run(p, &dst);
+                        col += dst.count * dst.dcol;
+                        row += dst.count * dst.drow;
+                }
+        }
+}
+
+/********** transform_tile ********
+ *
+ *      Parallel_work function: fills tile number item of the
+ *      destination, block by block down each column of blocks
+ *
+ *      Notes:
+ *              tiles are numbered down each column of tiles, and the
+ *              blocks of a tile visited down each column of blocks,
+ *              which is the order they are stored in for every kind of
+ *              array; a tile of an array blocked once is one block
+ *      
+ ******************************/
+static void transform_tile(int item, int thread, void *cl)
+{
+        struct tile_job *job = cl;
+        int x0 = item / job->tiles_down * job->tile_w;
+        int y0 = item % job->tiles_down * job->tile_h;
+        int w = job->p->dst->width - x0;
+        int h = job->p->dst->height - y0;
+        w = w < job->tile_w ? w : job->tile_w;
+        h = h < job->tile_h ? h : job->tile_h;
+
+        (void)thread;
+        for (int x = 0; x < w; x += job->block_w) {
+                int bw = w - x < job->block_w ? w - x : job->block_w;
+                for (int y = 0; y < h; y += job->block_h) {
+                        int bh = h - y < job->block_h ? h - y : job->block_h;
+                        transform_block(job, x0 + x, y0 + y, bw, bh);
+                }
+        }
+        if (job->p->hints->stream)
+                store_fence();
+}
+
+
+/********** parallel_transform ********
+ *
+ *      cursor_transform spread over a pool: the destination is cut into
+ *      tiles, whole blocks of a blocked array, whole tiles of blocks of
+ *      a two-level one, or strips of about STRIP_BYTES of columns of a
+ *      plain one, and each tile is an item
+ *
+ ******************************/
+static void parallel_transform(const struct pass *p, Parallel_T pool)
+{
+        A2Methods_UArray2 dst = p->dst->pixels;
+        int w = p->dst->width;
+        int h = p->dst->height;
+        long column = (long)h * p->dst->methods->size(dst);
+        struct tile_job job;
+
+        job.p = p;
+        job.vertical = A2Methods_by_column(p->to, dst);
+        if (job.vertical) {
+                job.tile_w = column < STRIP_BYTES ? STRIP_BYTES / column : 1;
+                job.tile_h = h > 0 ? h : 1;
+                job.block_w = job.tile_w;
+                job.block_h = job.tile_h;
+        } else {
+                p->to->tileshape(dst, &job.tile_w, &job.tile_h);
+                p->to->blockshape(dst, &job.block_w, &job.block_h);
+        }
+        job.tiles_down = (h + job.tile_h - 1) / job.tile_h;
+
+        int across = (w + job.tile_w - 1) / job.tile_w;
+        Parallel_for(pool, across * job.tiles_down, transform_tile, &job);
+}
+
+
+/********** overlaps ********
+ *
+ *      whether the len_a bytes at a share any with the len_b bytes at b
+ *
+ ******************************/
+static bool overlaps(const void *a, size_t len_a, const void *b,
+                     size_t len_b)
+{
+        const char *pa = a, *pb = b;
+
+        return len_a > 0 && len_b > 0 && pa < pb + len_b && pb < pa + len_a;
+}
+
+
+/********** Ppmtrans_size ********
+ *
+ *      the size of the result of op on a width x height image
+ *
+ *      Return:
+ *              PPMTRANS_OK, or PPMTRANS_EINVAL for an unknown op, a
+ *              negative size or a NULL out pointer
+ *
+ ******************************/
+int Ppmtrans_size(Ppmtrans_op op, int width, int height, int *out_width,
+                  int *out_height)
+{
+        if ((unsigned)op > PPMTRANS_TRANSPOSE || width < 0 || height < 0
+            || out_width == NULL || out_height == NULL)
+                return PPMTRANS_EINVAL;
+
+        *out_width = turns(op) ? height : width;
+        *out_height = turns(op) ? width : height;
+        return PPMTRANS_OK;
+}
+
+
+/********** begin_pass ********
+ *
+ *      checks that src can be transformed by op into dst, and fills in
+ *      p for doing it
+ *
+ *      Return:
+ *              PPMTRANS_OK, or the code of the first problem found
+ *
+ ******************************/
+static int begin_pass(Ppmtrans_op op, Pnm_ppm src, Pnm_ppm dst,
+                      const Ppmtrans_hints *hints, struct pass *p)
+{
+        static const Ppmtrans_hints no_hints = { 0, false };
+        int w, h;
+
+        if (src == NULL || dst == NULL || src->pixels == NULL
+            || dst->pixels == NULL || src->methods == NULL
+            || dst->methods == NULL)
+                return PPMTRANS_EINVAL;
+
+        if (Ppmtrans_size(op, (int)src->width, (int)src->height, &w, &h)
+            != PPMTRANS_OK)
+                return PPMTRANS_EINVAL;
+
+        p->src = src;
+        p->dst = dst;
+        p->from = A2Methods_cursor(src->methods);
+        p->to = A2Methods_cursor(dst->methods);
+        p->xf = &xforms[op];
+        p->hints = hints != NULL ? hints : &no_hints;
+        if (p->hints->prefetch < 0
+            || p->hints->prefetch > PPMTRANS_PREFETCH_MAX)
+                return PPMTRANS_EINVAL;
+
+        size_t src_len, dst_len;
+
+        if (p->from == NULL || p->to == NULL)
+                return PPMTRANS_ECURSOR;
+        if (dst->methods->size(dst->pixels)
+            != src->methods->size(src->pixels))
+                return PPMTRANS_EPIXEL;
+        if ((int)dst->width != w || (int)dst->height != h
+            || src->methods->width(src->pixels) != (int)src->width
+            || src->methods->height(src->pixels) != (int)src->height
+            || dst->methods->width(dst->pixels) != w
+            || dst->methods->height(dst->pixels) != h)
+                return PPMTRANS_ESHAPE;
+
+        void *src_mem = p->from->storage(src->pixels, &src_len);
+        void *dst_mem = p->to->storage(dst->pixels, &dst_len);
+        if (overlaps(src_mem, src_len, dst_mem, dst_len))
+                return PPMTRANS_EOVERLAP;
+        p->in_memory = src_mem != NULL && dst_mem != NULL;
+        return PPMTRANS_OK;
+}
+
+
+/********** Ppmtrans_pixmap ********
+ *
+ *      transforms the pixels of src into those of dst
+ *
+ *      Parameters:
+ *              Ppmtrans_op op: the transformation
+ *              Pnm_ppm src: the image to transform
+ *              Pnm_ppm dst: the image to fill, already the result's size
+ *              const Ppmtrans_hints *hints: prefetching and stores, or
+ *                                           NULL for neither
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return:
+ *              PPMTRANS_OK, or the code of the first problem found
+ *
+ *      Notes:
+ *              without a pool the destination is filled in storage
+ *              order; with one it is cut into tiles as for
+ *              parallel_transform
+ *              the pool is not used when either array does not keep its
+ *              cells in memory (storage gives NULL), as a compressed
+ *              array decodes blocks even to be read and so must stay on
+ *              one thread; empty arrays take that path too, harmlessly
+ *
+ ******************************/
+int Ppmtrans_pixmap(Ppmtrans_op op, Pnm_ppm src, Pnm_ppm dst,
+                    const Ppmtrans_hints *hints, Parallel_T pool)
+{
+        struct pass p;
+        int err = begin_pass(op, src, dst, hints, &p);
+
+        if (err != PPMTRANS_OK)
+                return err;
+        if (pool != NULL && p.in_memory)
+                parallel_transform(&p, pool);
+        else
+                cursor_transform(&p);
+        return PPMTRANS_OK;
+}
+
+
+/********** Ppmtrans_region ********
+ *
+ *      transforms into the w x h rectangle of dst at (x, y) the pixels
+ *      of src that belong there, leaving the rest of dst alone
+ *
+ *      Return:
+ *              PPMTRANS_OK, or the code of the first problem found;
+ *              PPMTRANS_ESHAPE if the rectangle is not inside dst
+ *
+ *      Notes:
+ *              the rectangle is filled a line at a time along dst's
+ *              storage direction, as one block of parallel_transform
+ *
+ ******************************/
+int Ppmtrans_region(Ppmtrans_op op, Pnm_ppm src, Pnm_ppm dst, int x, int y,
+                    int w, int h, const Ppmtrans_hints *hints)
+{
+        struct pass p;
+        int err = begin_pass(op, src, dst, hints, &p);
+
+        if (err != PPMTRANS_OK)
+                return err;
+        if (x < 0 || y < 0 || w < 0 || h < 0 || x > (int)dst->width - w
+            || y > (int)dst->height - h)
+                return PPMTRANS_ESHAPE;
+        if (w == 0 || h == 0)
+                return PPMTRANS_OK;
+
+        struct tile_job job = { .p = &p };
+        job.vertical = A2Methods_by_column(p.to, dst->pixels);
+        transform_block(&job, x, y, w, h);
+        if (p.hints->stream)
+                store_fence();
+        return PPMTRANS_OK;
+}
+
+
+/********** Ppmtrans_source ********
+ *
+ *      finds the rectangle of a width x height image that op moves to
+ *      the w x h rectangle of the result at (x, y)
+ *
+ *      Return:
+ *              PPMTRANS_OK, or PPMTRANS_EINVAL for an unknown op, an
+ *              empty rectangle or a NULL out pointer
+ *
+ *      Notes:
+ *              the coefficients map the rectangle's opposite corners
+ *              to opposite corners of the source rectangle
+ *
+ ******************************/
+int Ppmtrans_source(Ppmtrans_op op, int width, int height, int x, int y,
+                    int w, int h, int *src_x, int *src_y, int *src_w,
+                    int *src_h)
+{
+        if ((unsigned)op > PPMTRANS_TRANSPOSE || w < 1 || h < 1
+            || src_x == NULL || src_y == NULL || src_w == NULL
+            || src_h == NULL)
+                return PPMTRANS_EINVAL;
+
+        const struct Xform *xf = &xforms[op];
+        int c0 = xf->ci * x + xf->cj * y + xf->cw * (width - 1);
+        int r0 = xf->ri * x + xf->rj * y + xf->rh * (height - 1);
+        int c1 = c0 + xf->ci * (w - 1) + xf->cj * (h - 1);
+        int r1 = r0 + xf->ri * (w - 1) + xf->rj * (h - 1);
+
+        *src_x = c0 < c1 ? c0 : c1;
+        *src_y = r0 < r1 ? r0 : r1;
+        *src_w = (c0 < c1 ? c1 - c0 : c0 - c1) + 1;
+        *src_h = (r0 < r1 ? r1 - r0 : r0 - r1) + 1;
+        return PPMTRANS_OK;
+}
+
+
+/* one call's worth of Ppmtrans_buffer */
+struct raster_job {
+        const Ppmtrans_image *src, *dst;
+        const struct Xform *xf;
+        int tiles_across;
+};
+
+/********** raster_tile ********
+ *
+ *      Parallel_work function: fills tile number item of the
+ *      destination raster, row by row
+ *
+ *      Notes:
+ *              tiles are numbered along each row of tiles; a row of a
+ *              tile is a line of the source, so it is one copy_run
+ *              with the source step worked out from the coefficients
+ *
+ ******************************/
+static void raster_tile(int item, int thread, void *cl)
+{
+        struct raster_job *job = cl;
+        const Ppmtrans_image *src = job->src, *dst = job->dst;
+        const struct Xform *xf = job->xf;
+        int size = src->pixbytes;
+        int x0 = item % job->tiles_across * TILE;
+        int y0 = item / job->tiles_across * TILE;
+        int w = dst->width - x0 < TILE ? dst->width - x0 : TILE;
+        int h = dst->height - y0 < TILE ? dst->height - y0 : TILE;
+        long across = xf->ci * (long)size + xf->ri * src->stride;
+
+        (void)thread;
+        for (int y = y0; y < y0 + h; y++) {
+                int col = xf->ci * x0 + xf->cj * y
+                          + xf->cw * (src->width - 1);
+                int row = xf->ri * x0 + xf->rj * y
+                          + xf->rh * (src->height - 1);
+                const char *s = (const char *)src->pixels
+                                + (long)row * src->stride
+                                + (long)col * size;
+                char *d = (char *)dst->pixels + (long)y * dst->stride
+                          + (long)x0 * size;
+
+                copy_run(d, size, s, across, w, size, 0);
+        }
+}
+
+
+/********** raster_bytes ********
+ *
+ *      how many bytes image spans, from its first pixel to past its last
+ *
+ ******************************/
+static size_t raster_bytes(const Ppmtrans_image *image)
+{
+        if (image->width == 0 || image->height == 0)
+                return 0;
+        return (size_t)(image->height - 1) * image->stride
+               + (size_t)image->width * image->pixbytes;
+}
+
+/********** bad_raster ********
+ *
+ *      whether image cannot be described by a Ppmtrans_image: a
+ *      negative size, rows that run into each other, or no pixels
+ *
+ ******************************/
+static bool bad_raster(const Ppmtrans_image *image)
+{
+        return image->width < 0 || image->height < 0
+               || image->stride < (long)image->width * image->pixbytes
+               || (image->pixels == NULL && raster_bytes(image) > 0);
+}
+
+
+/********** Ppmtrans_buffer ********
+ *
+ *      transforms the raster src into the raster dst
+ *
+ *      Parameters:
+ *              Ppmtrans_op op: the transformation
+ *              const Ppmtrans_image *src: the raster to transform
+ *              const Ppmtrans_image *dst: the raster to fill, already
+ *                                         the result's size
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return:
+ *              PPMTRANS_OK, or the code of the first problem found
+ *
+ *      Notes:
+ *              the destination is cut into TILE x TILE tiles, each an
+ *              item of Parallel_for, so the source lines a tile reads
+ *              stay in the cache while the tile is written
+ *
+ ******************************/
+int Ppmtrans_buffer(Ppmtrans_op op, const Ppmtrans_image *src,
+                    const Ppmtrans_image *dst, Parallel_T pool)
+{
+        int w, h;
+
+        if (src == NULL || dst == NULL
+            || Ppmtrans_size(op, src->width, src->height, &w, &h)
+               != PPMTRANS_OK)
+                return PPMTRANS_EINVAL;
+        if (src->pixbytes < 1 || dst->pixbytes != src->pixbytes)
+                return PPMTRANS_EPIXEL;
+        if (bad_raster(src) || bad_raster(dst))
+                return PPMTRANS_EINVAL;
+        if (dst->width != w || dst->height != h)
+                return PPMTRANS_ESHAPE;
+        if (overlaps(src->pixels, raster_bytes(src), dst->pixels,
+                     raster_bytes(dst)))
+                return PPMTRANS_EOVERLAP;
+
+        struct raster_job job = {
+                .src = src,
+                .dst = dst,
+                .xf = &xforms[op],
+                .tiles_across = (w + TILE - 1) / TILE
+        };
+        Parallel_for(pool, job.tiles_across * ((h + TILE - 1) / TILE),
+                     raster_tile, &job);
+        return PPMTRANS_OK;
+}
+
+
+const char *Ppmtrans_strerror(int err)
+{
+        switch (err) {
+        case PPMTRANS_OK:
+                return "no error";
+        case PPMTRANS_EINVAL:
+                return "missing image, bad image or unknown transformation";
+        case PPMTRANS_ESHAPE:
+                return "destination is not the size of the result";
+        case PPMTRANS_EPIXEL:
+                return "pixel sizes differ or are less than one byte";
+        case PPMTRANS_ECURSOR:
+                return "image methods have no cursors";
+        case PPMTRANS_EOVERLAP:
+                return "source and destination share memory";
+        default:
+                return "unknown error";
+        }
+}
@@ -0,0 +1,123 @@
+#ifndef LIBPPMTRANS_INCLUDED
+#define LIBPPMTRANS_INCLUDED
+/*
+ *      libppmtrans.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              the right-angle transformations of ppmtrans as a library,
+ *              for programs that want them without a process per image.
+ *              Either kind of image can be transformed:
+ *
+ *                - a raster in memory, described by a Ppmtrans_image:
+ *                  rows of width pixels, pixbytes bytes each, rows
+ *                  stride bytes apart
+ *                - a Pnm_ppm whose methods have cursors (see a2cursor.h),
+ *                  into another such Pnm_ppm
+ *
+ *              The caller provides the destination, already the size of
+ *              the result (see Ppmtrans_size); nothing is allocated and
+ *              nothing is printed. Errors are returned as codes, never
+ *              raised, and nothing is kept between calls, so calls on
+ *              different images may run at once on different threads.
+ *              A Parallel_T may be passed to split one call's work; a
+ *              pool runs one call at a time.
+ *
+ *              PPMTRANS_API_VERSION changes whenever a declaration here
+ *              changes in a way that breaks callers.
+ *
+ *      Usage:
+ *
+ *              int w, h;
+ *              Ppmtrans_size(PPMTRANS_ROTATE_90, src.width, src.height,
+ *                            &w, &h);
+ *              ... make dst, w x h pixels of src.pixbytes bytes ...
+ *              int err = Ppmtrans_buffer(PPMTRANS_ROTATE_90, &src, &dst,
+ *                                        pool);
+ *              if (err != PPMTRANS_OK)
+ *                      fprintf(stderr, "%s\n", Ppmtrans_strerror(err));
+ *
+ */
+
+#include <stdbool.h>
+#include "pnm.h"
+#include "parallel.h"
+
+#define PPMTRANS_API_VERSION 1
+
+typedef enum Ppmtrans_op {
+        PPMTRANS_ROTATE_0,
+        PPMTRANS_ROTATE_90,             /* clockwise */
+        PPMTRANS_ROTATE_180,
+        PPMTRANS_ROTATE_270,
+        PPMTRANS_FLIP_HORIZONTAL,       /* mirror left to right */
+        PPMTRANS_FLIP_VERTICAL,         /* mirror top to bottom */
+        PPMTRANS_TRANSPOSE              /* across the main diagonal */
+} Ppmtrans_op;
+
+enum {
+        PPMTRANS_OK = 0,
+        PPMTRANS_EINVAL = -1,           /* NULL image, unknown op or hint */
+        PPMTRANS_ESHAPE = -2,           /* dst is not the result's size */
+        PPMTRANS_EPIXEL = -3,           /* pixel sizes differ or are < 1 */
+        PPMTRANS_ECURSOR = -4,          /* methods without cursors */
+        PPMTRANS_EOVERLAP = -5          /* src and dst share memory */
+};
+
+/* a raster in memory; stride may be more than width * pixbytes */
+typedef struct Ppmtrans_image {
+        void *pixels;                   /* the first pixel of the top row */
+        int width, height;
+        int pixbytes;
+        long stride;                    /* bytes from one row to the next */
+} Ppmtrans_image;
+
+/* the farthest ahead a Ppmtrans_hints may prefetch */
+#define PPMTRANS_PREFETCH_MAX 4096
+
+/* how Ppmtrans_pixmap moves pixels; a NULL Ppmtrans_hints is all off */
+typedef struct Ppmtrans_hints {
+        int prefetch;                   /* source pixels to prefetch ahead
+                                           of the copy, 0 for none, at
+                                           most PPMTRANS_PREFETCH_MAX */
+        bool stream;                    /* write with non-temporal stores,
+                                           where the machine has them */
+} Ppmtrans_hints;
+
+/* the width and height of the result of op on a width x height image */
+extern int Ppmtrans_size(Ppmtrans_op op, int width, int height,
+                         int *out_width, int *out_height);
+
+/* transforms the raster src into the raster dst */
+extern int Ppmtrans_buffer(Ppmtrans_op op, const Ppmtrans_image *src,
+                           const Ppmtrans_image *dst, Parallel_T pool);
+
+/* transforms the pixels of src into those of dst; their methods may
+   differ but their element sizes may not.  dst's denominator is left
+   alone.  If either array does not keep all its cells in memory (a
+   compressed one, see uarray2c.h) the work is done on the calling
+   thread and pool is not used, since such an array must never be used
+   by two threads at once. */
+extern int Ppmtrans_pixmap(Ppmtrans_op op, Pnm_ppm src, Pnm_ppm dst,
+                           const Ppmtrans_hints *hints, Parallel_T pool);
+
+/* transforms into the w x h rectangle of dst at (x, y) only the pixels
+   of src that belong there; otherwise as Ppmtrans_pixmap, without a
+   pool.  For redoing part of a result whose source partly changed. */
+extern int Ppmtrans_region(Ppmtrans_op op, Pnm_ppm src, Pnm_ppm dst,
+                           int x, int y, int w, int h,
+                           const Ppmtrans_hints *hints);
+
+/* the rectangle of a width x height image that op moves to the w x h
+   rectangle of the result at (x, y) */
+extern int Ppmtrans_source(Ppmtrans_op op, int width, int height, int x,
+                           int y, int w, int h, int *src_x, int *src_y,
+                           int *src_w, int *src_h);
+
+/* a sentence describing an error code */
+extern const char *Ppmtrans_strerror(int err);
+
+#endif
@@ -0,0 +1,538 @@
+/*
+ *      libppmtrans_test.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              checks libppmtrans against ppmtrans. A few test images
+ *              are written to a temporary file and put through ppmtrans
+ *              once per transformation; the same transformation is then
+ *              done by every entry point of the library and the result
+ *              compared with ppmtrans's, pixel for pixel:
+ *
+ *                - Ppmtrans_pixmap, from and to every method suite that
+ *                  has cursors, with and without a pool and hints
+ *                - Ppmtrans_region, filling the result a quarter at a
+ *                  time
+ *                - Ppmtrans_buffer, on packed rasters with padded rows,
+ *                  with and without a pool
+ *
+ *              Then each error code is provoked through each entry
+ *              point that can return it. Every failed check is printed,
+ *              and the exit status is 1 if any failed.
+ *
+ *      Usage:
+ *
+ *              libppmtrans_test [ppmtrans]
+ *
+ *              where ppmtrans is the program to compare against,
+ *              ./ppmtrans by default ("make check" runs this).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "pnm.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2hier.h"
+#include "a2compressed.h"
+#include "parallel.h"
+#include "libppmtrans.h"
+
+#define RGB_BYTES 3             /* bytes of a pixel in a test raster */
+
+/* a pixel no test image has, for cells a call should have written */
+#define UNWRITTEN 1000
+
+/* a transformation and the ppmtrans options that ask for it */
+static const struct op {
+        Ppmtrans_op op;
+        const char *options;
+} ops[] = {
+        { PPMTRANS_ROTATE_0,            "-rotate 0" },
+        { PPMTRANS_ROTATE_90,           "-rotate 90" },
+        { PPMTRANS_ROTATE_180,          "-rotate 180" },
+        { PPMTRANS_ROTATE_270,          "-rotate 270" },
+        { PPMTRANS_FLIP_HORIZONTAL,     "-flip horizontal" },
+        { PPMTRANS_FLIP_VERTICAL,       "-flip vertical" },
+        { PPMTRANS_TRANSPOSE,           "-transpose" }
+};
+#define NOPS (int)(sizeof(ops) / sizeof(ops[0]))
+
+/* the test images: wider than a raster tile, a single pixel, and tall */
+static const int shapes[][2] = { { 70, 45 }, { 1, 1 }, { 3, 130 } };
+#define NSHAPES (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+static int checks, failures;
+
+
+/********** expect ********
+ *
+ *      counts a check, and prints the printf-style description of it
+ *      if it failed
+ *
+ ******************************/
+static void expect(bool ok, const char *fmt, ...)
+{
+        va_list args;
+
+        checks++;
+        if (ok)
+                return;
+        failures++;
+        fprintf(stderr, "FAILED: ");
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+        fprintf(stderr, "\n");
+}
+
+
+/********** suite_name ********
+ *
+ *      a name for methods, for the failure messages
+ *
+ ******************************/
+static const char *suite_name(A2Methods_T methods)
+{
+        if (methods == uarray2_methods_plain)
+                return "plain";
+        if (methods == uarray2_methods_blocked)
+                return "blocked";
+        if (methods == uarray2_methods_hier)
+                return "hier";
+        if (methods == uarray2_methods_compressed)
+                return "compressed";
+        return "no cursors";
+}
+
+
+/********** new_pixmap ********
+ *
+ *      makes a width x height Pnm_ppm of elements size bytes with
+ *      methods, every pixel set to UNWRITTEN if they are Pnm_rgbs
+ *
+ *      Return:
+ *              the pixmap, to be freed with Pnm_ppmfree
+ *
+ ******************************/
+static Pnm_ppm new_pixmap(A2Methods_T methods, int width, int height,
+                          int size)
+{
+        Pnm_ppm pixmap = malloc(sizeof(*pixmap));
+
+        if (pixmap == NULL) {
+                perror("malloc");
+                exit(1);
+        }
+        pixmap->width = width;
+        pixmap->height = height;
+        pixmap->denominator = 255;
+        pixmap->methods = methods;
+        pixmap->pixels = methods->new(width, height, size);
+        if (size != sizeof(struct Pnm_rgb))
+                return pixmap;
+
+        for (int i = 0; i < width; i++)
+                for (int j = 0; j < height; j++) {
+                        Pnm_rgb pixel = methods->at(pixmap->pixels, i, j);
+                        pixel->red = UNWRITTEN;
+                        pixel->green = UNWRITTEN;
+                        pixel->blue = UNWRITTEN;
+                }
+        return pixmap;
+}
+
+
+/********** test_image ********
+ *
+ *      makes a width x height image with methods in which neighbouring
+ *      pixels differ, so that any pixel put in the wrong place shows
+ *
+ ******************************/
+static Pnm_ppm test_image(A2Methods_T methods, int width, int height)
+{
+        Pnm_ppm image = new_pixmap(methods, width, height,
+                                   sizeof(struct Pnm_rgb));
+
+        for (int i = 0; i < width; i++)
+                for (int j = 0; j < height; j++) {
+                        Pnm_rgb pixel = methods->at(image->pixels, i, j);
+                        pixel->red = (i * 5 + j) % 256;
+                        pixel->green = (i + j * 3) % 256;
+                        pixel->blue = (i * j + 7) % 256;
+                }
+        return image;
+}
+
+
+/********** run_ppmtrans ********
+ *
+ *      runs ppmtrans with options on the image in the file at path
+ *
+ *      Return:
+ *              the image ppmtrans wrote, read with the plain methods
+ *
+ *      Notes:
+ *              exits if ppmtrans cannot be run or does not succeed, as
+ *              there is then nothing to compare against
+ *
+ ******************************/
+static Pnm_ppm run_ppmtrans(const char *ppmtrans, const char *options,
+                            const char *path)
+{
+        char command[1024];
+
+        snprintf(command, sizeof(command), "%s %s %s", ppmtrans, options,
+                 path);
+
+        FILE *fp = popen(command, "r");
+        if (fp == NULL) {
+                perror(ppmtrans);
+                exit(1);
+        }
+
+        Pnm_ppm result = Pnm_ppmread(fp, uarray2_methods_plain);
+        if (pclose(fp) != 0) {
+                fprintf(stderr, "%s failed\n", command);
+                exit(1);
+        }
+        return result;
+}
+
+
+/********** same_pixels ********
+ *
+ *      whether pixmap holds the same image as expected
+ *
+ ******************************/
+static bool same_pixels(Pnm_ppm pixmap, Pnm_ppm expected)
+{
+        if (pixmap->width != expected->width
+            || pixmap->height != expected->height)
+                return false;
+
+        for (int i = 0; i < (int)expected->width; i++)
+                for (int j = 0; j < (int)expected->height; j++) {
+                        Pnm_rgb a = pixmap->methods->at(pixmap->pixels,
+                                                        i, j);
+                        Pnm_rgb b = expected->methods->at(expected->pixels,
+                                                          i, j);
+                        if (a->red != b->red || a->green != b->green
+                            || a->blue != b->blue)
+                                return false;
+                }
+        return true;
+}
+
+
+/********** to_raster, same_raster ********
+ *
+ *      copy a Pnm_ppm into a raster of RGB_BYTES-byte pixels whose rows
+ *      are padded by pad bytes, and compare such a raster with one
+ *
+ *      Notes:
+ *              the test images have no value above 255, so a pixel fits
+ *              in three bytes
+ *
+ ******************************/
+static Ppmtrans_image to_raster(Pnm_ppm pixmap, int pad)
+{
+        Ppmtrans_image raster = {
+                .width = pixmap->width,
+                .height = pixmap->height,
+                .pixbytes = RGB_BYTES,
+                .stride = (long)pixmap->width * RGB_BYTES + pad
+        };
+
+        raster.pixels = calloc(raster.height, raster.stride);
+        if (raster.pixels == NULL) {
+                perror("calloc");
+                exit(1);
+        }
+        for (int i = 0; i < raster.width; i++)
+                for (int j = 0; j < raster.height; j++) {
+                        Pnm_rgb pixel = pixmap->methods->at(pixmap->pixels,
+                                                            i, j);
+                        unsigned char *p = (unsigned char *)raster.pixels
+                                           + j * raster.stride
+                                           + i * RGB_BYTES;
+                        p[0] = pixel->red;
+                        p[1] = pixel->green;
+                        p[2] = pixel->blue;
+                }
+        return raster;
+}
+
+static bool same_raster(const Ppmtrans_image *raster, Pnm_ppm expected)
+{
+        Ppmtrans_image want = to_raster(expected, 0);
+        bool same = raster->width == want.width
+                    && raster->height == want.height;
+
+        for (int j = 0; same && j < want.height; j++)
+                same = memcmp((char *)raster->pixels + j * raster->stride,
+                              (char *)want.pixels + j * want.stride,
+                              (size_t)want.width * RGB_BYTES) == 0;
+        free(want.pixels);
+        return same;
+}
+
+
+/********** check_pixmap ********
+ *
+ *      Ppmtrans_pixmap of image, and Ppmtrans_region of it a quarter
+ *      of the result at a time, between every pair of method suites
+ *
+ ******************************/
+static void check_pixmap(const struct op *op, Pnm_ppm image,
+                         Pnm_ppm expected, Parallel_T pool)
+{
+        static const Ppmtrans_hints hints = { 64, true };
+        A2Methods_T suites[] = {
+                uarray2_methods_plain, uarray2_methods_blocked,
+                uarray2_methods_hier, uarray2_methods_compressed
+        };
+        int nsuites = sizeof(suites) / sizeof(suites[0]);
+        int w = expected->width, h = expected->height;
+
+        for (int s = 0; s < nsuites; s++) {
+                Pnm_ppm src = test_image(suites[s], image->width,
+                                         image->height);
+
+                for (int d = 0; d < nsuites; d++) {
+                        for (int k = 0; k < 4; k++) {
+                                Pnm_ppm dst = new_pixmap(suites[d], w, h,
+                                                 sizeof(struct Pnm_rgb));
+                                int err = Ppmtrans_pixmap(op->op, src, dst,
+                                                k & 1 ? &hints : NULL,
+                                                k & 2 ? pool : NULL);
+                                expect(err == PPMTRANS_OK
+                                       && same_pixels(dst, expected),
+                                       "Ppmtrans_pixmap %s %dx%d %s to %s%s%s",
+                                       op->options, image->width,
+                                       image->height, suite_name(suites[s]),
+                                       suite_name(suites[d]),
+                                       k & 1 ? " with hints" : "",
+                                       k & 2 ? " with a pool" : "");
+                                Pnm_ppmfree(&dst);
+                        }
+
+                        Pnm_ppm dst = new_pixmap(suites[d], w, h,
+                                                 sizeof(struct Pnm_rgb));
+                        int err = PPMTRANS_OK;
+                        for (int q = 0; q < 4 && err == PPMTRANS_OK; q++) {
+                                int x = q & 1 ? w / 2 : 0;
+                                int y = q & 2 ? h / 2 : 0;
+                                err = Ppmtrans_region(op->op, src, dst, x, y,
+                                                      q & 1 ? w - x : w / 2,
+                                                      q & 2 ? h - y : h / 2,
+                                                      NULL);
+                        }
+                        expect(err == PPMTRANS_OK
+                               && same_pixels(dst, expected),
+                               "Ppmtrans_region %s %dx%d %s to %s",
+                               op->options, image->width, image->height,
+                               suite_name(suites[s]), suite_name(suites[d]));
+                        Pnm_ppmfree(&dst);
+                }
+                Pnm_ppmfree(&src);
+        }
+}
+
+
+/********** check_buffer ********
+ *
+ *      Ppmtrans_buffer of image as a raster, with and without a pool
+ *
+ ******************************/
+static void check_buffer(const struct op *op, Pnm_ppm image,
+                         Pnm_ppm expected, Parallel_T pool)
+{
+        Ppmtrans_image src = to_raster(image, 5);
+
+        for (int k = 0; k < 2; k++) {
+                Ppmtrans_image dst = to_raster(expected, 7);
+                memset(dst.pixels, 0, dst.height * dst.stride);
+
+                int err = Ppmtrans_buffer(op->op, &src, &dst,
+                                          k ? pool : NULL);
+                expect(err == PPMTRANS_OK && same_raster(&dst, expected),
+                       "Ppmtrans_buffer %s %dx%d%s", op->options,
+                       image->width, image->height,
+                       k ? " with a pool" : "");
+                free(dst.pixels);
+        }
+        free(src.pixels);
+}
+
+
+/********** check_errors ********
+ *
+ *      provokes each error code through each entry point that can
+ *      return it, and checks that every code has its own message
+ *
+ ******************************/
+static void check_errors(void)
+{
+        const Ppmtrans_op bad_op = (Ppmtrans_op)(PPMTRANS_TRANSPOSE + 1);
+        const Ppmtrans_op turn = PPMTRANS_ROTATE_90;
+        struct A2Methods_T copy = *uarray2_methods_plain;
+        A2Methods_T no_cursors = &copy;
+        Ppmtrans_hints far = { PPMTRANS_PREFETCH_MAX + 1, false };
+        int rgb = sizeof(struct Pnm_rgb);
+
+        Pnm_ppm image = test_image(uarray2_methods_plain, 5, 3);
+        Pnm_ppm turned = new_pixmap(uarray2_methods_plain, 3, 5, rgb);
+        Pnm_ppm unturned = new_pixmap(uarray2_methods_plain, 5, 3, rgb);
+        Pnm_ppm narrow = new_pixmap(uarray2_methods_plain, 3, 5, RGB_BYTES);
+
+        expect(Ppmtrans_pixmap(turn, NULL, turned, NULL, NULL)
+               == PPMTRANS_EINVAL, "Ppmtrans_pixmap of NULL");
+        expect(Ppmtrans_pixmap(bad_op, image, turned, NULL, NULL)
+               == PPMTRANS_EINVAL, "Ppmtrans_pixmap of an unknown op");
+        expect(Ppmtrans_pixmap(turn, image, turned, &far, NULL)
+               == PPMTRANS_EINVAL, "Ppmtrans_pixmap prefetching too far");
+        expect(Ppmtrans_pixmap(turn, image, turned, NULL, NULL)
+               == PPMTRANS_OK, "Ppmtrans_pixmap of the error image");
+        expect(Ppmtrans_pixmap(turn, image, unturned, NULL, NULL)
+               == PPMTRANS_ESHAPE, "Ppmtrans_pixmap into the wrong shape");
+        expect(Ppmtrans_pixmap(turn, image, narrow, NULL, NULL)
+               == PPMTRANS_EPIXEL, "Ppmtrans_pixmap into other pixels");
+        expect(Ppmtrans_pixmap(PPMTRANS_ROTATE_0, image, image, NULL, NULL)
+               == PPMTRANS_EOVERLAP, "Ppmtrans_pixmap in place");
+        image->methods = no_cursors;
+        expect(Ppmtrans_pixmap(turn, image, turned, NULL, NULL)
+               == PPMTRANS_ECURSOR, "Ppmtrans_pixmap without cursors");
+        expect(Ppmtrans_region(turn, image, turned, 0, 0, 1, 1, NULL)
+               == PPMTRANS_ECURSOR, "Ppmtrans_region without cursors");
+        image->methods = uarray2_methods_plain;
+
+        expect(Ppmtrans_region(turn, NULL, turned, 0, 0, 1, 1, NULL)
+               == PPMTRANS_EINVAL, "Ppmtrans_region of NULL");
+        expect(Ppmtrans_region(turn, image, turned, 0, 0, 1, 1, &far)
+               == PPMTRANS_EINVAL, "Ppmtrans_region prefetching too far");
+        expect(Ppmtrans_region(turn, image, turned, 1, 0, 3, 5, NULL)
+               == PPMTRANS_ESHAPE, "Ppmtrans_region past the right edge");
+        expect(Ppmtrans_region(turn, image, turned, 0, 0, 3, -1, NULL)
+               == PPMTRANS_ESHAPE, "Ppmtrans_region of a negative height");
+        expect(Ppmtrans_region(turn, image, unturned, 0, 0, 1, 1, NULL)
+               == PPMTRANS_ESHAPE, "Ppmtrans_region into the wrong shape");
+        expect(Ppmtrans_region(turn, image, narrow, 0, 0, 1, 1, NULL)
+               == PPMTRANS_EPIXEL, "Ppmtrans_region into other pixels");
+        expect(Ppmtrans_region(PPMTRANS_ROTATE_0, image, image, 0, 0, 1, 1,
+                               NULL)
+               == PPMTRANS_EOVERLAP, "Ppmtrans_region in place");
+
+        Ppmtrans_image src = to_raster(image, 0);
+        Ppmtrans_image dst = to_raster(turned, 0);
+        Ppmtrans_image bad;
+
+        expect(Ppmtrans_buffer(turn, NULL, &dst, NULL) == PPMTRANS_EINVAL,
+               "Ppmtrans_buffer of NULL");
+        expect(Ppmtrans_buffer(bad_op, &src, &dst, NULL) == PPMTRANS_EINVAL,
+               "Ppmtrans_buffer of an unknown op");
+        bad = src;
+        bad.stride = (long)bad.width * RGB_BYTES - 1;
+        expect(Ppmtrans_buffer(turn, &bad, &dst, NULL) == PPMTRANS_EINVAL,
+               "Ppmtrans_buffer of overlapping rows");
+        bad = src;
+        bad.pixels = NULL;
+        expect(Ppmtrans_buffer(turn, &bad, &dst, NULL) == PPMTRANS_EINVAL,
+               "Ppmtrans_buffer of no pixels");
+        bad = src;
+        bad.pixbytes = 0;
+        expect(Ppmtrans_buffer(turn, &bad, &dst, NULL) == PPMTRANS_EPIXEL,
+               "Ppmtrans_buffer of empty pixels");
+        bad = dst;
+        bad.pixbytes = RGB_BYTES + 1;
+        expect(Ppmtrans_buffer(turn, &src, &bad, NULL) == PPMTRANS_EPIXEL,
+               "Ppmtrans_buffer into other pixels");
+        expect(Ppmtrans_buffer(turn, &src, &src, NULL) == PPMTRANS_ESHAPE,
+               "Ppmtrans_buffer into the wrong shape");
+        expect(Ppmtrans_buffer(PPMTRANS_ROTATE_0, &src, &src, NULL)
+               == PPMTRANS_EOVERLAP, "Ppmtrans_buffer in place");
+
+        int codes[] = {
+                PPMTRANS_OK, PPMTRANS_EINVAL, PPMTRANS_ESHAPE,
+                PPMTRANS_EPIXEL, PPMTRANS_ECURSOR, PPMTRANS_EOVERLAP
+        };
+        int ncodes = sizeof(codes) / sizeof(codes[0]);
+        const char *unknown = Ppmtrans_strerror(1);
+
+        for (int c = 0; c < ncodes; c++) {
+                bool own = strcmp(Ppmtrans_strerror(codes[c]), unknown) != 0;
+                for (int d = 0; d < c; d++)
+                        own = own && strcmp(Ppmtrans_strerror(codes[c]),
+                                            Ppmtrans_strerror(codes[d]))
+                                     != 0;
+                expect(own, "Ppmtrans_strerror(%d) is not its own message",
+                       codes[c]);
+        }
+
+        free(src.pixels);
+        free(dst.pixels);
+        Pnm_ppmfree(&narrow);
+        Pnm_ppmfree(&unturned);
+        Pnm_ppmfree(&turned);
+        Pnm_ppmfree(&image);
+}
+
+
+int main(int argc, char *argv[])
+{
+        const char *ppmtrans = argc > 1 ? argv[1] : "./ppmtrans";
+        char path[] = "/tmp/libppmtrans_testXXXXXX";
+
+        if (argc > 2) {
+                fprintf(stderr, "Usage: %s [ppmtrans]\n", argv[0]);
+                exit(1);
+        }
+
+        int fd = mkstemp(path);
+        if (fd < 0) {
+                perror(path);
+                exit(1);
+        }
+        close(fd);
+
+        Parallel_T pool = Parallel_new(3);
+
+        for (int s = 0; s < NSHAPES; s++) {
+                Pnm_ppm image = test_image(uarray2_methods_plain,
+                                           shapes[s][0], shapes[s][1]);
+                FILE *fp = fopen(path, "w");
+
+                if (fp == NULL) {
+                        perror(path);
+                        exit(1);
+                }
+                Pnm_ppmwrite(fp, image);
+                fclose(fp);
+
+                for (int o = 0; o < NOPS; o++) {
+                        Pnm_ppm expected = run_ppmtrans(ppmtrans,
+                                                        ops[o].options,
+                                                        path);
+                        check_pixmap(&ops[o], image, expected, pool);
+                        check_buffer(&ops[o], image, expected, pool);
+                        Pnm_ppmfree(&expected);
+                }
+                Pnm_ppmfree(&image);
+        }
+        unlink(path);
+        check_errors();
+        Parallel_free(&pool);
+
+        printf("%d of %d checks failed\n", failures, checks);
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,313 @@
+/*
+ *      numa.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of Numa_T. The machine's nodes and their
+ *              cpus are read from /sys/devices/system/node; memory is
+ *              bound with the mbind system call directly, so there is
+ *              no dependence on libnuma. The policy is MPOL_PREFERRED,
+ *              which falls back to another node when one is full
+ *              rather than failing.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "numa.h"
+
+#define NODE_DIR "/sys/devices/system/node"
+#define MAX_NODES 64            /* bits in the mbind node mask */
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+struct Numa_T {
+        int nodes;
+        int simulated;          /* count, but do not bind or pin */
+        int *ids;               /* each node's number on the machine */
+        cpu_set_t *cpus;        /* each node's cpus */
+        int *threads;           /* pinned to each node */
+        double *placed;         /* bytes bound to each node */
+        long arrays;            /* placed */
+        long refused;           /* mbind calls that failed */
+        int unpinned;           /* threads that could not be pinned */
+};
+
+static Numa_T attached = NULL;
+
+
+/********** read_cpulist ********
+ *
+ *      reads a node's cpulist file, as in "0-3,8-11", into a cpu set
+ *
+ *      Return:
+ *              nonzero if the node has any cpus
+ *
+ ******************************/
+static int read_cpulist(int node, cpu_set_t *set)
+{
+        char name[64];
+        snprintf(name, sizeof(name), NODE_DIR "/node%d/cpulist", node);
+        FILE *fp = fopen(name, "r");
+
+        CPU_ZERO(set);
+        if (fp == NULL)
+                return 0;
+
+        unsigned lo, hi;
+        int c;
+        while (fscanf(fp, "%u", &lo) == 1) {
+                hi = lo;
+                c = getc(fp);
+                if (c == '-' && fscanf(fp, "%u", &hi) == 1)
+                        c = getc(fp);
+                for (unsigned cpu = lo; cpu <= hi && cpu < CPU_SETSIZE;
+                     cpu++)
+                        CPU_SET(cpu, set);
+                if (c != ',')
+                        break;
+        }
+        fclose(fp);
+        return CPU_COUNT(set) > 0;
+}
+
+/********** Numa_new ********
+ *
+ *      finds the machine's nodes, or makes up a topology
+ *
+ *      Parameters:
+ *              int nodes: how many nodes to simulate, or 0 for the
+ *                         machine's own
+ *
+ *      Return:
+ *              the new Numa_T
+ *
+ *      Notes:
+ *              only nodes with cpus count; memory-only nodes would
+ *              have no threads writing to them
+ *
+ ******************************/
+Numa_T Numa_new(int nodes)
+{
+        assert(nodes >= 0 && nodes <= MAX_NODES);
+
+        Numa_T numa = calloc(1, sizeof(*numa));
+        assert(numa != NULL);
+        numa->simulated = nodes > 0;
+        numa->ids = calloc(MAX_NODES, sizeof(*numa->ids));
+        numa->cpus = calloc(MAX_NODES, sizeof(*numa->cpus));
+        assert(numa->ids != NULL && numa->cpus != NULL);
+
+        if (numa->simulated) {
+                numa->nodes = nodes;
+                for (int k = 0; k < nodes; k++)
+                        numa->ids[k] = k;
+        } else {
+                for (int id = 0; id < MAX_NODES; id++)
+                        if (read_cpulist(id, &numa->cpus[numa->nodes]))
+                                numa->ids[numa->nodes++] = id;
+                if (numa->nodes == 0)
+                        numa->nodes = 1;        /* cannot tell */
+        }
+
+        numa->threads = calloc(numa->nodes, sizeof(*numa->threads));
+        numa->placed = calloc(numa->nodes, sizeof(*numa->placed));
+        assert(numa->threads != NULL && numa->placed != NULL);
+        return numa;
+}
+
+void Numa_free(Numa_T *numa)
+{
+        assert(numa != NULL && *numa != NULL);
+        if (attached == *numa)
+                attached = NULL;
+        free((*numa)->ids);
+        free((*numa)->cpus);
+        free((*numa)->threads);
+        free((*numa)->placed);
+        free(*numa);
+        *numa = NULL;
+}
+
+int Numa_nodes(Numa_T numa)
+{
+        assert(numa != NULL);
+        return numa->nodes;
+}
+
+struct pin_job {
+        Numa_T numa;
+        int nthreads;
+};
+
+/********** pin_thread ********
+ *
+ *      Parallel_work function: pins the calling thread to its node
+ *
+ ******************************/
+static void pin_thread(int item, int thread, void *cl)
+{
+        struct pin_job *job = cl;
+        Numa_T numa = job->numa;
+        int node = (long)thread * numa->nodes / job->nthreads;
+
+        (void)item;
+        __atomic_fetch_add(&numa->threads[node], 1, __ATOMIC_RELAXED);
+        if (numa->simulated || numa->nodes == 1)
+                return;
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                   &numa->cpus[node]) != 0)
+                __atomic_fetch_add(&numa->unpinned, 1, __ATOMIC_RELAXED);
+}
+
+/********** Numa_pin ********
+ *
+ *      pins the threads of a pool, a contiguous group per node, and
+ *      makes the pool affine
+ *
+ *      Notes:
+ *              with more nodes than threads some nodes get none; with
+ *              a NULL pool only the calling thread is pinned
+ *
+ ******************************/
+void Numa_pin(Numa_T numa, Parallel_T pool)
+{
+        struct pin_job job = { numa, Parallel_threads(pool) };
+
+        assert(numa != NULL);
+        Parallel_each(pool, pin_thread, &job);
+        if (pool != NULL)
+                Parallel_affine(pool, 1);
+}
+
+void Numa_Attach(Numa_T numa)
+{
+        attached = numa;
+}
+
+void Numa_Detach(void)
+{
+        attached = NULL;
+}
+
+/********** prefer ********
+ *
+ *      prefers node k of numa for the pages of [start, end)
+ *
+ ******************************/
+static void prefer(Numa_T numa, int k, char *start, char *end)
+{
+        numa->placed[k] += end - start;
+        if (numa->simulated || numa->nodes == 1 || end <= start)
+                return;
+
+        unsigned long mask = 1UL << numa->ids[k];
+        /* the kernel reads maxnode - 1 bits of the mask */
+        if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &mask,
+                    MAX_NODES + 1, MPOL_MF_MOVE) != 0)
+                numa->refused++;
+}
+
+/********** Numa_Place ********
+ *
+ *      splits the storage of array2 over the nodes with pinned
+ *      threads, in order, each node's part in proportion to its threads
+ *
+ *      Notes:
+ *              a node with no threads gets none of the array, as no
+ *                      thread would write there; if nothing has been
+ *                      pinned yet every node gets an equal part
+ *              parts are rounded to whole pages, so a page shared by
+ *                      two parts goes to the later one; the pages an
+ *                      affine job's thread t writes then mostly belong
+ *                      to thread t's node
+ *
+ ******************************/
+void Numa_Place(A2Methods_T methods, A2Methods_UArray2 array2)
+{
+        Numa_T numa = attached;
+        if (numa == NULL)
+                return;
+
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        assert(cursors != NULL);
+        size_t len;
+        char *base = cursors->storage(array2, &len);
+        if (base == NULL)
+                return;
+
+        /* a node's weight is its threads, or 1 each if none are pinned */
+        long total = 0;
+        for (int k = 0; k < numa->nodes; k++)
+                total += numa->threads[k];
+        int even = total == 0;
+        if (even)
+                total = numa->nodes;
+
+        uintptr_t page = sysconf(_SC_PAGESIZE);
+        char *start = (char *)((uintptr_t)base & ~(page - 1));
+        long upto = 0;
+        numa->arrays++;
+        for (int k = 0; k < numa->nodes; k++) {
+                int weight = even ? 1 : numa->threads[k];
+                if (weight == 0)
+                        continue;
+                upto += weight;
+
+                char *end = base + len;
+                if (upto < total) {
+                        uintptr_t cut = (uintptr_t)base
+                                        + len * upto / total;
+                        end = (char *)(cut & ~(page - 1));
+                }
+                if (end > start) {
+                        prefer(numa, k, start, end);
+                        start = end;
+                }
+        }
+}
+
+/********** Numa_report ********
+ *
+ *      prints the topology, where threads and arrays went, and how
+ *      many of the pool's items stayed on their own thread
+ *
+ ******************************/
+void Numa_report(Numa_T numa, Parallel_T pool, FILE *fp)
+{
+        long home, stolen;
+
+        assert(numa != NULL && fp != NULL);
+        fprintf(fp, "NUMA: %d node%s%s, %ld array%s placed\n", numa->nodes,
+                numa->nodes == 1 ? "" : "s",
+                numa->simulated ? " (simulated)"
+                : numa->nodes == 1 ? " (nothing to bind)" : "",
+                numa->arrays, numa->arrays == 1 ? "" : "s");
+        for (int k = 0; k < numa->nodes; k++)
+                fprintf(fp, "  node %-3d %3d threads %10.1f MB placed\n",
+                        numa->ids[k], numa->threads[k],
+                        numa->placed[k] / (1 << 20));
+        if (numa->refused > 0)
+                fprintf(fp, "  %ld mbind calls refused\n", numa->refused);
+        if (numa->unpinned > 0)
+                fprintf(fp, "  %d threads not pinned\n", numa->unpinned);
+
+        Parallel_stats(pool, &home, &stolen);
+        if (home + stolen > 0)
+                fprintf(fp, "  %.1f%% of parallel items ran on their own "
+                            "thread (%ld taken by others)\n",
+                        100.0 * home / (home + stolen), stolen);
+}
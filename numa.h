@@ -0,0 +1,74 @@
+#ifndef NUMA_INCLUDED
+#define NUMA_INCLUDED
+/*
+ *      numa.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              interface to placing arrays and threads on the nodes of a
+ *              NUMA machine, type Numa_T. An array's storage is split
+ *              into one contiguous part per node that has pinned
+ *              threads, in storage order and sized by those threads,
+ *              and each part is bound to its node with mbind before
+ *              anything touches it. The threads of a Parallel_T are pinned in
+ *              order, a contiguous group per node, and the pool hands
+ *              each thread a contiguous share of every job's items, so a
+ *              job whose items follow the destination's storage order
+ *              writes mostly to memory on the writer's own node.
+ *
+ *              A topology can also be simulated: everything is worked
+ *              out and counted as on a real machine, but nothing is
+ *              bound or pinned. On a machine with one node (or no NUMA
+ *              support) placement does nothing.
+ *
+ *      Usage:
+ *
+ *              Numa_T numa = Numa_new(0);
+ *              Numa_pin(numa, pool);
+ *              Numa_Attach(numa);
+ *                ... arrays made here are placed by Numa_Place
+ *              Numa_Detach();
+ *              Numa_report(numa, pool, stderr);
+ *              Numa_free(&numa);
+ *
+ *      Code that makes an array for a parallel job passes it to
+ *      Numa_Place, which does nothing unless a Numa_T is attached.
+ *
+ */
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "parallel.h"
+
+typedef struct Numa_T *Numa_T;
+
+/* the machine's topology if nodes is 0, or a simulated one with nodes
+   nodes; a machine that cannot tell has one node */
+extern Numa_T Numa_new(int nodes);
+
+extern void Numa_free(Numa_T *numa);
+
+extern int Numa_nodes(Numa_T numa);
+
+/* pins thread t of pool (which may be NULL) to the cpus of node
+   t * nodes / nthreads, and has the pool split each job's items into
+   one contiguous share per thread (see Parallel_affine) */
+extern void Numa_pin(Numa_T numa, Parallel_T pool);
+
+/* route Numa_Place to numa until the next Numa_Detach */
+extern void Numa_Attach(Numa_T numa);
+extern void Numa_Detach(void);
+
+/* spreads the storage of array2, which must be untouched so far and
+   have cursors, over the nodes of the attached Numa_T that have pinned
+   threads (all its nodes if none do), if there is one */
+extern void Numa_Place(A2Methods_T methods, A2Methods_UArray2 array2);
+
+/* prints where threads and arrays went, and how many of pool's items
+   ran on the thread whose share they were in */
+extern void Numa_report(Numa_T numa, Parallel_T pool, FILE *fp);
+
+#endif
@@ -0,0 +1,1043 @@
+/*
+ *      p6.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the raw ppm reader in p6.h. Rows of
+ *              raw bytes are decoded straight into the pixmap's array by
+ *              decode_band, which walks the array in its own storage
+ *              order; a contiguous run of 8-bit samples is widened to
+ *              unsigned 16 at a time with a vector conversion. A packed
+ *              array holds the file's own bytes, so decoding it is a
+ *              copy, specialized to the pixel size with elemsize.h.
+ *
+ *              P6_read reads a band at a time: a row of blocks for a
+ *              blocked array, and about BAND_BYTES of the file for a
+ *              plain one. Given a pool and a regular file, P6_readimage
+ *              hands the bands to the threads instead, each of which
+ *              preads its band's bytes and decodes them; bands are then
+ *              a whole number of tile rows, so no two threads write one
+ *              tile. P6_write formats bands the same size with
+ *              encode_band, the mirror of decode_band, and hands each
+ *              group of bands to writev. A window is read one row at a
+ *              time: each row's
+ *              bytes are found by seeking when the file allows it, or by
+ *              reading and throwing away the bytes in between when it
+ *              does not (a pipe).
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "assert.h"
+#include "except.h"
+#include "a2cursor.h"
+#include "elemsize.h"
+#include "numa.h"
+#include "p6.h"
+
+#define SKIP_CHUNK 16384        /* bytes thrown away per read on a pipe */
+#define BAND_BYTES (1 << 20)    /* of the file per band, plain arrays */
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024            /* buffers per writev, the Linux limit */
+#endif
+
+typedef unsigned char u8x16 __attribute__((vector_size(16)));
+typedef unsigned u32x16 __attribute__((vector_size(64)));
+
+/* how the pixels of the file are stored in the array */
+struct layout {
+        int channels;           /* samples per pixel: 1 (gray) or 3 */
+        int bytes;              /* per sample in the file: 1 or 2 */
+        int packed;             /* elements are the file's bytes, rather
+                                   than Pnm_rgb */
+};
+
+
+/********** next_token ********
+ *
+ *      skips whitespace and comments in a header
+ *
+ *      Return:
+ *              the first character after them
+ *
+ ******************************/
+static int next_token(FILE *fp)
+{
+        int c = getc(fp);
+
+        for (;;) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF)
+                                c = getc(fp);
+                } else if (c == EOF || !isspace(c)) {
+                        return c;
+                }
+                c = getc(fp);
+        }
+}
+
+/********** read_number ********
+ *
+ *      reads a positive decimal number from a header, and the single
+ *      character after it
+ *
+ *      Notes:
+ *              raises Pnm_Badformat unless the number is followed by
+ *              whitespace (or, for all but the last number, a comment)
+ *
+ ******************************/
+static unsigned read_number(FILE *fp, int last)
+{
+        int c = next_token(fp);
+        unsigned long n = 0;
+
+        if (!isdigit(c))
+                RAISE(Pnm_Badformat);
+        do {
+                n = n * 10 + (c - '0');
+                if (n > INT_MAX)
+                        RAISE(Pnm_Badformat);
+                c = getc(fp);
+        } while (isdigit(c));
+
+        if (c == '#' && !last)
+                ungetc(c, fp);
+        else if (c == EOF || !isspace(c))
+                RAISE(Pnm_Badformat);
+        if (n == 0)
+                RAISE(Pnm_Badformat);
+        return n;
+}
+
+/********** P6_readheader ********
+ *
+ *      reads the header of a ppm or pgm
+ *
+ *      Parameters:
+ *              FILE *fp: the file, positioned at its start
+ *              P6_header *header: where to put the header
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              raises Pnm_Badformat if fp is not a P6, P5, P3 or P2
+ *              file
+ *
+ ******************************/
+void P6_readheader(FILE *fp, P6_header *header)
+{
+        assert(fp != NULL && header != NULL);
+
+        int c = getc(fp) == 'P' ? getc(fp) : EOF;
+        if (c != '6' && c != '5' && c != '3' && c != '2')
+                RAISE(Pnm_Badformat);
+        header->raw = c == '6' || c == '5';
+        header->channels = c == '5' || c == '2' ? 1 : 3;
+
+        header->width = read_number(fp, 0);
+        header->height = read_number(fp, 0);
+        header->maxval = read_number(fp, 1);
+        if (header->maxval > 65535)
+                RAISE(Pnm_Badformat);
+        header->bytes = header->maxval > 255 ? 2 : 1;
+        header->offset = ftello(fp);
+}
+
+/********** skip ********
+ *
+ *      reads and throws away n bytes
+ *
+ *      Return:
+ *              1, or 0 if the file ended first
+ *
+ ******************************/
+static int skip(FILE *fp, off_t n)
+{
+        char junk[SKIP_CHUNK];
+
+        while (n > 0) {
+                size_t chunk = n < SKIP_CHUNK ? n : SKIP_CHUNK;
+                if (fread(junk, 1, chunk, fp) != chunk)
+                        return 0;
+                n -= chunk;
+        }
+        return 1;
+}
+
+/********** expand ********
+ *
+ *      widens n 8-bit samples to unsigned
+ *
+ ******************************/
+static inline void expand(const unsigned char *in, unsigned *out, size_t n)
+{
+        size_t k = 0;
+
+        for (; k + 16 <= n; k += 16) {
+                u8x16 v;
+                memcpy(&v, in + k, sizeof(v));
+                u32x16 wide = __builtin_convertvector(v, u32x16);
+                memcpy(out + k, &wide, sizeof(wide));
+        }
+        for (; k < n; k++)
+                out[k] = in[k];
+}
+
+/********** narrow ********
+ *
+ *      stores n samples, each at most 255, as bytes
+ *
+ ******************************/
+static inline void narrow(const unsigned *in, unsigned char *out, size_t n)
+{
+        size_t k = 0;
+
+        for (; k + 16 <= n; k += 16) {
+                u32x16 v;
+                memcpy(&v, in + k, sizeof(v));
+                u8x16 bytes = __builtin_convertvector(v, u8x16);
+                memcpy(out + k, &bytes, sizeof(bytes));
+        }
+        for (; k < n; k++)
+                out[k] = in[k];
+}
+
+/********** copy_pixels ********
+ *
+ *      copies n pixels of size bytes between strided runs
+ *
+ *      Notes:
+ *              runs a copy of the loop specialized to the pixel size:
+ *              1 and 2 bytes for a pgm, 3 and 6 for a ppm
+ *
+ ******************************/
+ELEMSIZE_INLINE void copy_pixels_sized(char *dst, long dstride,
+                                       const char *src, long sstride,
+                                       int n, int size)
+{
+        for (int k = 0; k < n; k++, dst += dstride, src += sstride)
+                ELEMSIZE_COPY(dst, src, size);
+}
+
+#define COPY_CASE(N, UNUSED)                                            \
+        case N: copy_pixels_sized(dst, dstride, src, sstride, n, N); break;
+
+static void copy_pixels(void *dst, long dstride, const void *src,
+                        long sstride, int n, int size)
+{
+        switch (size) {
+        ELEMSIZE_FOREACH(COPY_CASE, _)
+        default:
+                copy_pixels_sized(dst, dstride, src, sstride, n, size);
+        }
+}
+
+static inline unsigned sample(const unsigned char *in, int bytes)
+{
+        return bytes == 1 ? in[0] : (unsigned)in[0] << 8 | in[1];
+}
+
+static inline void decode_pixel(const unsigned char *in,
+                                const struct layout *lay, Pnm_rgb px)
+{
+        int b = lay->bytes;
+
+        px->red = sample(in, b);
+        if (lay->channels == 1) {
+                px->green = px->blue = px->red;
+        } else {
+                px->green = sample(in + b, b);
+                px->blue = sample(in + 2 * b, b);
+        }
+}
+
+/********** decode_band ********
+ *
+ *      stores rows of raw samples into rows [y0, y0 + rows) and
+ *      columns [0, w) of the array
+ *
+ *      Parameters:
+ *              const unsigned char *in: the first row's bytes
+ *              size_t pitch: bytes from one row to the next in in
+ *              const struct layout *lay: the file's pixels, and whether
+ *                                        the array holds them packed
+ *              int vertical: walk the array down its columns rather
+ *                            than along its rows; best when that is
+ *                            how it is stored
+ *
+ *      Notes:
+ *              the array is written along its storage direction, a
+ *              stretch of lines at a time, as load_rect in vec4.h reads,
+ *              so a band of block rows fills one block after another
+ *              a run of pixels that are next to each other both in the
+ *              array and in the file is copied, or expanded as one run
+ *              of samples, since a Pnm_rgb is three unsigneds
+ *
+ ******************************/
+static void decode_band(const unsigned char *in, size_t pitch,
+                        const struct layout *lay,
+                        A2Methods_CursorT cursors, A2Methods_UArray2 array2,
+                        int vertical, int y0, int rows, int w)
+{
+        int lines = vertical ? w : rows;
+        int len = vertical ? rows : w;
+        size_t pixbytes = lay->channels * lay->bytes;
+        size_t step = vertical ? pitch : pixbytes;
+
+        for (int k = 0; k < len; ) {
+                int n = 0;
+                for (int l = 0; l < lines; l++) {
+                        int x = vertical ? l : k;
+                        int y = vertical ? k : l;
+                        A2Methods_Run run;
+                        n = cursors->run_at(array2, x, y0 + y, !vertical,
+                                            vertical, len - k, &run);
+                        const unsigned char *src = in + y * pitch
+                                                   + x * pixbytes;
+                        char *p = run.elem;
+
+                        if (lay->packed) {
+                                if (!vertical
+                                    && run.stride == (long)pixbytes)
+                                        memcpy(p, src, n * pixbytes);
+                                else
+                                        copy_pixels(p, run.stride, src,
+                                                    step, n, pixbytes);
+                                continue;
+                        }
+                        if (!vertical && lay->channels == 3
+                            && lay->bytes == 1
+                            && run.stride == sizeof(struct Pnm_rgb)) {
+                                expand(src, (unsigned *)p, 3 * (size_t)n);
+                                continue;
+                        }
+                        for (int i = 0; i < n; i++, p += run.stride,
+                                                  src += step)
+                                decode_pixel(src, lay, (Pnm_rgb)p);
+                }
+                k += n;
+        }
+}
+
+static inline void encode_pixel(const struct Pnm_rgb *px, int bytes,
+                                unsigned char *out)
+{
+        if (bytes == 1) {
+                out[0] = px->red;
+                out[1] = px->green;
+                out[2] = px->blue;
+        } else {
+                out[0] = px->red >> 8;
+                out[1] = px->red;
+                out[2] = px->green >> 8;
+                out[3] = px->green;
+                out[4] = px->blue >> 8;
+                out[5] = px->blue;
+        }
+}
+
+/********** encode_band ********
+ *
+ *      formats rows [y0, y0 + rows) of the array as raw samples, the
+ *      reverse of decode_band, which takes the same parameters
+ *
+ *      Notes:
+ *              an array of Pnm_rgb is always written with 3 channels
+ *
+ ******************************/
+static void encode_band(unsigned char *out, size_t pitch,
+                        const struct layout *lay,
+                        A2Methods_CursorT cursors, A2Methods_UArray2 array2,
+                        int vertical, int y0, int rows, int w)
+{
+        int lines = vertical ? w : rows;
+        int len = vertical ? rows : w;
+        int bytes = lay->bytes;
+        size_t pixbytes = lay->channels * bytes;
+        size_t step = vertical ? pitch : pixbytes;
+
+        for (int k = 0; k < len; ) {
+                int n = 0;
+                for (int l = 0; l < lines; l++) {
+                        int x = vertical ? l : k;
+                        int y = vertical ? k : l;
+                        A2Methods_Run run;
+                        n = cursors->run_at(array2, x, y0 + y, !vertical,
+                                            vertical, len - k, &run);
+                        unsigned char *dst = out + y * pitch + x * pixbytes;
+                        const char *p = run.elem;
+
+                        if (lay->packed) {
+                                if (!vertical
+                                    && run.stride == (long)pixbytes)
+                                        memcpy(dst, p, n * pixbytes);
+                                else
+                                        copy_pixels(dst, step, p,
+                                                    run.stride, n, pixbytes);
+                                continue;
+                        }
+                        if (!vertical && bytes == 1
+                            && run.stride == sizeof(struct Pnm_rgb)) {
+                                narrow((const unsigned *)p, dst,
+                                       3 * (size_t)n);
+                                continue;
+                        }
+                        for (int i = 0; i < n; i++, p += run.stride,
+                                                  dst += step)
+                                encode_pixel((const void *)p, bytes, dst);
+                }
+                k += n;
+        }
+}
+
+/********** band_rows ********
+ *
+ *      picks how many rows to read or write at a time
+ *
+ *      Notes:
+ *              a row of blocks for an array stored by rows in blocks,
+ *              so each block is done completely before the next is
+ *              touched; otherwise about BAND_BYTES of the file
+ *
+ ******************************/
+static int band_rows(A2Methods_CursorT cursors, A2Methods_UArray2 array2,
+                     int vertical, size_t pitch, int height)
+{
+        int bw, bh;
+        int band = BAND_BYTES / pitch > 0 ? BAND_BYTES / pitch : 1;
+
+        cursors->blockshape(array2, &bw, &bh);
+        if (!vertical && bw * bh > 1)
+                band = bh;
+        return band < height ? band : height;
+}
+
+/********** header_layout ********
+ *
+ *      how the pixels of a file with this header are kept in an array
+ *
+ ******************************/
+static struct layout header_layout(const P6_header *header, int packed)
+{
+        struct layout lay = { header->channels, header->bytes, packed };
+        return lay;
+}
+
+/********** pixmap_layout ********
+ *
+ *      how the pixels of a pixmap are written
+ *
+ *      Notes:
+ *              the element size says which format a packed array holds:
+ *              1 or 2 bytes a pgm, 3 or 6 a ppm; anything else is a CRE
+ *
+ ******************************/
+static struct layout pixmap_layout(Pnm_ppm pixmap)
+{
+        int size = pixmap->methods->size(pixmap->pixels);
+        struct layout lay = { 3, pixmap->denominator > 255 ? 2 : 1, 0 };
+
+        if (size == sizeof(struct Pnm_rgb))
+                return lay;
+        lay.packed = 1;
+        lay.channels = size % 3 == 0 ? 3 : 1;
+        assert(size == lay.channels * lay.bytes);
+        return lay;
+}
+
+/********** new_pixmap ********
+ *
+ *      makes a w x h pixmap with elements of size bytes, with blocks
+ *      blockw x blockh or the methods' default if they are 0
+ *
+ *      Notes:
+ *              the default for blocked methods fits a block in 64KB of
+ *              elements of the real size, so packed pixels get larger
+ *              blocks than Pnm_rgb
+ *              the storage is spread over NUMA nodes if a Numa_T is
+ *              attached
+ *
+ ******************************/
+static Pnm_ppm new_pixmap(int w, int h, unsigned maxval, int size,
+                          A2Methods_T methods, int blockw, int blockh)
+{
+        Pnm_ppm pixmap = malloc(sizeof(*pixmap));
+        assert(pixmap != NULL);
+        pixmap->width = w;
+        pixmap->height = h;
+        pixmap->denominator = maxval;
+        pixmap->methods = methods;
+        if (blockw > 0 && blockh > 0)
+                pixmap->pixels = A2Methods_cursor(methods)
+                        ->new_with_blockshape(w, h, size, blockw, blockh);
+        else
+                pixmap->pixels = methods->new(w, h, size);
+        Numa_Place(methods, pixmap->pixels);
+        return pixmap;
+}
+
+static unsigned read_sample(FILE *fp, unsigned maxval)
+{
+        unsigned s;
+
+        if (fscanf(fp, "%u", &s) != 1 || s > maxval)
+                RAISE(Pnm_Badformat);
+        return s;
+}
+
+/********** read_plain ********
+ *
+ *      reads the samples of a P3 ppm or P2 pgm into a pixmap, row by
+ *      row
+ *
+ ******************************/
+static void read_plain(FILE *fp, const struct layout *lay,
+                       A2Methods_CursorT cursors, Pnm_ppm pixmap)
+{
+        for (unsigned y = 0; y < pixmap->height; y++) {
+                for (unsigned x = 0; x < pixmap->width; ) {
+                        A2Methods_Run run;
+                        int n = cursors->run_at(pixmap->pixels, x, y, 1, 0,
+                                                pixmap->width - x, &run);
+                        char *p = run.elem;
+
+                        for (int i = 0; i < n; i++, p += run.stride) {
+                                unsigned char raw[6] = { 0 };
+                                unsigned char *r = raw;
+
+                                for (int c = 0; c < lay->channels; c++) {
+                                        unsigned s = read_sample(fp,
+                                                pixmap->denominator);
+                                        if (lay->bytes == 2)
+                                                *r++ = s >> 8;
+                                        *r++ = s;
+                                }
+                                if (lay->packed)
+                                        memcpy(p, raw, r - raw);
+                                else
+                                        decode_pixel(raw, lay, (Pnm_rgb)p);
+                        }
+                        x += n;
+                }
+        }
+}
+
+struct read_job {
+        int fd;
+        const P6_header *header;
+        struct layout lay;
+        A2Methods_CursorT cursors;
+        A2Methods_UArray2 array2;
+        int vertical;
+        size_t pitch;
+        int band;                       /* rows per band */
+        unsigned char **bufs;           /* one per thread */
+        int *failed;                    /* per thread: the file ended
+                                           early */
+};
+
+/********** can_pread ********
+ *
+ *      whether the pixels can be read by several threads at once: there
+ *      must be more than one thread, the file must be a raw one that
+ *      pread works on, and the array's cells must all be in memory, so
+ *      that threads filling different cells never touch the same bytes
+ *
+ ******************************/
+static int can_pread(FILE *fp, const P6_header *header,
+                     A2Methods_CursorT cursors, A2Methods_UArray2 array2,
+                     Parallel_T pool)
+{
+        size_t len;
+
+        return Parallel_threads(pool) > 1 && header->raw
+               && header->offset >= 0 && fileno(fp) >= 0
+               && cursors->storage(array2, &len) != NULL;
+}
+
+/********** read_band ********
+ *
+ *      Parallel_work function: reads band item of the image with pread
+ *      and decodes it into the array
+ *
+ *      Notes:
+ *              a read that comes up short is noted in failed[thread]
+ *              rather than raised, as only the calling thread of
+ *              Parallel_for may raise
+ *
+ ******************************/
+static void read_band(int item, int thread, void *cl)
+{
+        struct read_job *job = cl;
+        int y0 = item * job->band;
+        int height = job->header->height;
+        int rows = height - y0 < job->band ? height - y0 : job->band;
+        size_t want = rows * job->pitch;
+        off_t at = job->header->offset + (off_t)y0 * job->pitch;
+        unsigned char *buf = job->bufs[thread];
+
+        for (size_t got = 0; got < want; ) {
+                ssize_t n = pread(job->fd, buf + got, want - got,
+                                  at + got);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0) {
+                        job->failed[thread] = 1;
+                        return;
+                }
+                got += n;
+        }
+
+        decode_band(buf, job->pitch, &job->lay, job->cursors, job->array2,
+                    job->vertical, y0, rows, job->header->width);
+}
+
+/********** read_parallel ********
+ *
+ *      reads the pixels of a raw file into pixmap, a band per item of
+ *      Parallel_for
+ *
+ *      Parameters:
+ *              FILE *fp: the file, just past its header
+ *              const P6_header *header: its header
+ *              const struct layout *lay: how pixels are stored
+ *              Pnm_ppm pixmap: the pixmap to fill
+ *              int vertical: whether the array is stored by column
+ *              int band: rows per band, as band_rows gives
+ *              Parallel_T pool: the threads
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              bands are rounded up to a whole number of tile rows (block
+ *              rows for arrays blocked once), so each block is filled by
+ *              one thread; bands of an unblocked array write different
+ *              cells of each column or row
+ *              fp is left just past the pixels, as a read through it
+ *              would leave it, so the next frame of a stream can follow
+ *              raises Pnm_Badformat if the file ends early
+ *
+ ******************************/
+static void read_parallel(FILE *fp, const P6_header *header,
+                          const struct layout *lay, Pnm_ppm pixmap,
+                          int vertical, int band, Parallel_T pool)
+{
+        struct read_job job;
+        int threads = Parallel_threads(pool);
+        int failed = 0;
+        int tw, th;
+
+        job.fd = fileno(fp);
+        job.header = header;
+        job.lay = *lay;
+        job.cursors = A2Methods_cursor(pixmap->methods);
+        job.array2 = pixmap->pixels;
+        job.vertical = vertical;
+        job.pitch = (size_t)header->width * P6_packedsize(header);
+
+        job.cursors->tileshape(pixmap->pixels, &tw, &th);
+        if (band % th != 0)
+                band += th - band % th;
+        job.band = band;
+
+        job.bufs = malloc(threads * sizeof(*job.bufs));
+        job.failed = calloc(threads, sizeof(*job.failed));
+        assert(job.bufs != NULL && job.failed != NULL);
+        for (int t = 0; t < threads; t++) {
+                job.bufs[t] = malloc(band * job.pitch);
+                assert(job.bufs[t] != NULL);
+        }
+
+        int nbands = (header->height + band - 1) / band;
+        Parallel_for(pool, nbands, read_band, &job);
+
+        for (int t = 0; t < threads; t++) {
+                failed |= job.failed[t];
+                free(job.bufs[t]);
+        }
+        free(job.bufs);
+        free(job.failed);
+        if (failed)
+                RAISE(Pnm_Badformat);
+
+        int err = fseeko(fp, header->offset
+                             + (off_t)header->height * job.pitch, SEEK_SET);
+        assert(err == 0);
+}
+
+/********** P6_read ********
+ *
+ *      reads a whole ppm or pgm as a pixmap of Pnm_rgb
+ *
+ *      Parameters:
+ *              FILE *fp: the file, positioned at its start
+ *              A2Methods_T methods: methods for the pixmap's array,
+ *                                   which must have cursors
+ *              int blocksize: for the array, 0 for the default
+ *
+ *      Return:
+ *              the pixmap, to be freed with Pnm_ppmfree
+ *
+ *      Notes:
+ *              raises Pnm_Badformat if fp is not a ppm or pgm or ends
+ *              early
+ *
+ ******************************/
+Pnm_ppm P6_read(FILE *fp, A2Methods_T methods, int blocksize)
+{
+        P6_header header;
+
+        P6_readheader(fp, &header);
+        return P6_readimage(fp, &header, methods, blocksize, blocksize, 0,
+                            NULL);
+}
+
+/********** P6_readimage ********
+ *
+ *      reads the pixels of a ppm or pgm whose header has been read
+ *
+ *      Parameters:
+ *              FILE *fp: the file, just past its header
+ *              const P6_header *header: its header
+ *              A2Methods_T methods: methods for the pixmap's array,
+ *                                   which must have cursors
+ *              int blockw, blockh: block shape for the array, 0 for
+ *                                  the default
+ *              int packed: keep each pixel as the file's bytes, in an
+ *                          element of P6_packedsize(header) bytes,
+ *                          rather than as a Pnm_rgb
+ *              Parallel_T pool: threads to decode bands, or NULL
+ *
+ *      Return:
+ *              the pixmap, to be freed with Pnm_ppmfree
+ *
+ *      Notes:
+ *              raises Pnm_Badformat if the file ends early, having
+ *              freed the pixmap
+ *
+ ******************************/
+Pnm_ppm P6_readimage(FILE *fp, const P6_header *header, A2Methods_T methods,
+                     int blockw, int blockh, int packed,
+                     Parallel_T pool)
+{
+        assert(fp != NULL && header != NULL && methods != NULL);
+        assert(A2Methods_cursor(methods) != NULL);
+
+        int size = packed ? P6_packedsize(header)
+                          : (int)sizeof(struct Pnm_rgb);
+        Pnm_ppm pixmap = new_pixmap(header->width, header->height,
+                                    header->maxval, size, methods,
+                                    blockw, blockh);
+        TRY
+                P6_readpixels(fp, header, pixmap, packed, pool);
+        ELSE
+                Pnm_ppmfree(&pixmap);
+                RERAISE;
+        END_TRY;
+        return pixmap;
+}
+
+/********** P6_readpixels ********
+ *
+ *      reads the pixels of a ppm or pgm whose header has been read
+ *      into a pixmap that already has an array of the right size
+ *
+ *      Parameters:
+ *              FILE *fp: the file, just past its header
+ *              const P6_header *header: its header
+ *              Pnm_ppm pixmap: the pixmap to fill, whose methods must
+ *                              have cursors
+ *              int packed: as for P6_readimage
+ *              Parallel_T pool: threads to decode bands, or NULL
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              a pixmap whose size or element size does not match the
+ *              header is a CRE
+ *              the denominator is set from the header
+ *              raises Pnm_Badformat if the file ends early
+ *
+ ******************************/
+void P6_readpixels(FILE *fp, const P6_header *header, Pnm_ppm pixmap,
+                   int packed, Parallel_T pool)
+{
+        assert(fp != NULL && header != NULL && pixmap != NULL);
+        assert(sizeof(struct Pnm_rgb) == 3 * sizeof(unsigned));
+        assert(pixmap->width == header->width);
+        assert(pixmap->height == header->height);
+
+        A2Methods_CursorT cursors = A2Methods_cursor(pixmap->methods);
+        assert(cursors != NULL);
+
+        struct layout lay = header_layout(header, packed);
+        int size = packed ? P6_packedsize(header)
+                          : (int)sizeof(struct Pnm_rgb);
+        assert(pixmap->methods->size(pixmap->pixels) == size);
+        pixmap->denominator = header->maxval;
+        if (!header->raw) {
+                read_plain(fp, &lay, cursors, pixmap);
+                return;
+        }
+
+        int height = header->height;
+        int vertical = A2Methods_by_column(cursors, pixmap->pixels);
+        size_t pitch = (size_t)header->width * P6_packedsize(header);
+        int band = band_rows(cursors, pixmap->pixels, vertical, pitch,
+                             height);
+
+        if (can_pread(fp, header, cursors, pixmap->pixels, pool)) {
+                read_parallel(fp, header, &lay, pixmap, vertical, band,
+                              pool);
+                return;
+        }
+
+        unsigned char *buf = malloc(band * pitch);
+        assert(buf != NULL);
+
+        for (int y0 = 0; y0 < height; y0 += band) {
+                int rows = height - y0 < band ? height - y0 : band;
+                if (fread(buf, pitch, rows, fp) != (size_t)rows) {
+                        free(buf);
+                        RAISE(Pnm_Badformat);
+                }
+                decode_band(buf, pitch, &lay, cursors, pixmap->pixels,
+                            vertical, y0, rows, header->width);
+        }
+
+        free(buf);
+}
+
+/* bytes per pixel in the file, and so in a packed array */
+int P6_packedsize(const P6_header *header)
+{
+        assert(header != NULL);
+        return header->channels * header->bytes;
+}
+
+/********** P6_readwindow ********
+ *
+ *      reads part of a raw ppm or pgm
+ *
+ *      Parameters:
+ *              FILE *fp: the file, just past its header
+ *              const P6_header *header: its header
+ *              int x, y, w, h: the window to read
+ *              A2Methods_T methods: methods for the pixmap's array,
+ *                                   which must have cursors
+ *              int blockw, blockh: block shape for the array, 0 for
+ *                                  the default
+ *              int packed: as for P6_readimage
+ *
+ *      Return:
+ *              a pixmap of the window, to be freed with Pnm_ppmfree
+ *
+ *      Notes:
+ *              only the bytes of the window's rows are read when fp
+ *              can seek; otherwise everything up to its last row is
+ *              raises Pnm_Badformat if the file is not a P6 or P5 or
+ *              ends early, having freed what it made
+ *
+ ******************************/
+Pnm_ppm P6_readwindow(FILE *fp, const P6_header *header, int x, int y,
+                      int w, int h, A2Methods_T methods, int blockw,
+                      int blockh, int packed)
+{
+        assert(fp != NULL && header != NULL && methods != NULL);
+        assert(x >= 0 && y >= 0 && w > 0 && h > 0);
+        assert((unsigned)(x + w) <= header->width);
+        assert((unsigned)(y + h) <= header->height);
+
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        assert(cursors != NULL);
+        if (!header->raw)
+                RAISE(Pnm_Badformat);
+
+        struct layout lay = header_layout(header, packed);
+        size_t pixbytes = P6_packedsize(header);
+        Pnm_ppm pixmap = new_pixmap(w, h, header->maxval,
+                                    packed ? pixbytes
+                                           : sizeof(struct Pnm_rgb),
+                                    methods, blockw, blockh);
+
+        size_t rowbytes = w * pixbytes;
+        unsigned char *row = malloc(rowbytes);
+        assert(row != NULL);
+
+        /* positions are relative to the first pixel */
+        int seekable = header->offset >= 0;
+        off_t at = 0;
+        int r;
+
+        for (r = 0; r < h; r++) {
+                off_t want = ((off_t)(y + r) * header->width + x) * pixbytes;
+
+                if (want != at) {
+                        if (seekable)
+                                seekable = fseeko(fp, header->offset + want,
+                                                  SEEK_SET) == 0;
+                        if (!seekable && !skip(fp, want - at))
+                                break;
+                }
+                if (fread(row, 1, rowbytes, fp) != rowbytes)
+                        break;
+                at = want + rowbytes;
+
+                decode_band(row, rowbytes, &lay, cursors, pixmap->pixels,
+                            0, r, 1, w);
+        }
+
+        free(row);
+        if (r < h) {
+                Pnm_ppmfree(&pixmap);
+                RAISE(Pnm_Badformat);
+        }
+        return pixmap;
+}
+
+struct write_job {
+        Pnm_ppm pixmap;
+        A2Methods_CursorT cursors;
+        int vertical;
+        struct layout lay;
+        size_t pitch;
+        int band;                       /* rows per band */
+        int first;                      /* band number of bufs[0] */
+        unsigned char **bufs;           /* one per band of the group */
+        struct iovec *iov;
+};
+
+/********** format_band ********
+ *
+ *      Parallel_work function: formats band first + item of the image
+ *      into bufs[item]
+ *
+ ******************************/
+static void format_band(int item, int thread, void *cl)
+{
+        struct write_job *job = cl;
+        int y0 = (job->first + item) * job->band;
+        int height = job->pixmap->height;
+        int rows = height - y0 < job->band ? height - y0 : job->band;
+
+        (void)thread;
+        encode_band(job->bufs[item], job->pitch, &job->lay, job->cursors,
+                    job->pixmap->pixels, job->vertical, y0, rows,
+                    job->pixmap->width);
+        job->iov[item].iov_base = job->bufs[item];
+        job->iov[item].iov_len = rows * job->pitch;
+}
+
+/********** write_all ********
+ *
+ *      writes every byte of n buffers to fd, however many writev calls
+ *      that takes
+ *
+ *      Return:
+ *              1 if every byte was written, 0 if a write failed
+ *
+ ******************************/
+static int write_all(int fd, struct iovec *iov, int n)
+{
+        while (n > 0) {
+                ssize_t done = writev(fd, iov, n < IOV_MAX ? n : IOV_MAX);
+                if (done < 0 && errno == EINTR)
+                        continue;
+                if (done <= 0)
+                        return 0;
+                while (n > 0 && (size_t)done >= iov->iov_len) {
+                        done -= iov->iov_len;
+                        iov++;
+                        n--;
+                }
+                if (n > 0) {
+                        iov->iov_base = (char *)iov->iov_base + done;
+                        iov->iov_len -= done;
+                }
+        }
+        return 1;
+}
+
+/********** P6_write ********
+ *
+ *      writes a pixmap as a P6 ppm, or a P5 pgm if it holds packed
+ *      gray pixels
+ *
+ *      Parameters:
+ *              FILE *fp: where to write
+ *              Pnm_ppm pixmap: the image
+ *              Parallel_T pool: threads to format bands, or NULL
+ *
+ *      Return:
+ *              1 if the whole image was written, 0 if writing failed
+ *
+ *      Notes:
+ *              a failed write is returned rather than raised, so that
+ *              a thread other than the caller's may write (see
+ *              frames.c); nothing more is written after it
+ *              the header goes through fp, which is then flushed, and
+ *              the samples go straight to its file descriptor; a group
+ *              of one band per thread is formatted, then written with
+ *              one writev
+ *              samples take two bytes when the denominator is over 255
+ *              a packed pixmap must have been read from a file with the
+ *              same denominator (see pixmap_layout)
+ *
+ ******************************/
+int P6_write(FILE *fp, Pnm_ppm pixmap, Parallel_T pool)
+{
+        assert(fp != NULL && pixmap != NULL);
+        assert(pixmap->denominator > 0 && pixmap->denominator <= 65535);
+
+        struct write_job job;
+        job.pixmap = pixmap;
+        job.cursors = A2Methods_cursor(pixmap->methods);
+        assert(job.cursors != NULL);
+        job.vertical = A2Methods_by_column(job.cursors, pixmap->pixels);
+        job.lay = pixmap_layout(pixmap);
+        job.pitch = (size_t)pixmap->width * job.lay.channels * job.lay.bytes;
+        job.band = band_rows(job.cursors, pixmap->pixels, job.vertical,
+                             job.pitch, pixmap->height);
+
+        fprintf(fp, "P%c\n%u %u\n%u\n", job.lay.channels == 1 ? '5' : '6',
+                pixmap->width, pixmap->height, pixmap->denominator);
+        if (fflush(fp) != 0)
+                return 0;
+
+        int nbands = (pixmap->height + job.band - 1) / job.band;
+        int group = Parallel_threads(pool);
+        job.bufs = malloc(group * sizeof(*job.bufs));
+        job.iov = malloc(group * sizeof(*job.iov));
+        assert(job.bufs != NULL && job.iov != NULL);
+        for (int b = 0; b < group; b++) {
+                job.bufs[b] = malloc(job.band * job.pitch);
+                assert(job.bufs[b] != NULL);
+        }
+
+        int ok = 1;
+        for (job.first = 0; ok && job.first < nbands; job.first += group) {
+                int n = nbands - job.first < group ? nbands - job.first
+                                                   : group;
+                Parallel_for(pool, n, format_band, &job);
+                ok = write_all(fileno(fp), job.iov, n);
+        }
+
+        for (int b = 0; b < group; b++)
+                free(job.bufs[b]);
+        free(job.bufs);
+        free(job.iov);
+        return ok;
+}
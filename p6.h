@@ -0,0 +1,110 @@
+#ifndef P6_INCLUDED
+#define P6_INCLUDED
+/*
+ *      p6.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              reading and writing raw (P6) ppm files without going
+ *              through Pnm_ppmread and Pnm_ppmwrite, which visit the
+ *              array one methods->at call per pixel in raster order.
+ *              P6_read reads the file in large bands of rows and stores
+ *              each band along the array's own storage direction: whole
+ *              block rows for a UArray2b, pieces of columns for a
+ *              UArray2. P6_write does the reverse, formatting a band at a
+ *              time into a raster-order buffer and writing it in one
+ *              system call. Every row of a P6 image takes the same
+ *              number of bytes, so P6_readwindow can also read a window
+ *              of the image by seeking to just the bytes it covers, and
+ *              given a pool of threads P6_readimage reads the bands of
+ *              a regular file at once, each thread with its own pread.
+ *
+ *              Gray (P5 and P2) pgm files are read too. Besides the
+ *              usual Pnm_rgb, a pixmap can be read packed: each element
+ *              holds one pixel's bytes just as the file has them, 1 or 2
+ *              bytes for a pgm and 3 or 6 for a ppm, which is all a
+ *              transformation that only moves pixels needs. P6_write
+ *              writes a packed pixmap back in the format it came from.
+ *
+ *      Usage:
+ *
+ *              Pnm_ppm pixmap = P6_read(fp, methods, 0);
+ *
+ *      or
+ *
+ *              P6_header header;
+ *              P6_readheader(fp, &header);
+ *              Pnm_ppm pixmap = P6_readwindow(fp, &header, x, y, w, h,
+ *                                             methods, 0);
+ *
+ *      Malformed or truncated input raises Pnm_Badformat, as Pnm_ppmread
+ *      does.
+ *
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "a2methods.h"
+#include "pnm.h"
+#include "parallel.h"
+
+typedef struct P6_header {
+        unsigned width, height;
+        unsigned maxval;
+        int raw;                /* 1 for P6 or P5, 0 for plain (P3 or
+                                   P2) */
+        int channels;           /* 3 for a ppm, 1 for a pgm */
+        int bytes;              /* per sample: 1, or 2 if maxval > 255 */
+        off_t offset;           /* of the first pixel in the file, -1 if
+                                   the file cannot seek */
+} P6_header;
+
+/* reads the header of a P6, P5, P3 or P2 file, leaving fp at the first
+   pixel */
+extern void P6_readheader(FILE *fp, P6_header *header);
+
+/* bytes per pixel in the file, which is the element size of a packed
+   pixmap: 1 or 2 for a pgm, 3 or 6 for a ppm */
+extern int P6_packedsize(const P6_header *header);
+
+/* reads a whole ppm or pgm as a pixmap of Pnm_rgb (gray pixels have
+   red = green = blue), like Pnm_ppmread; methods must have cursors
+   (see a2cursor.h) and blocksize 0 means the methods' default */
+extern Pnm_ppm P6_read(FILE *fp, A2Methods_T methods, int blocksize);
+
+/* reads the pixels after a header read with P6_readheader, packed if
+   packed is nonzero, into an array with blockw x blockh blocks (0 x 0
+   for the methods' default); otherwise as P6_read.  With a pool, a raw
+   file that pread works on is read and decoded a band per thread; the
+   pool must not be in use by another thread. */
+extern Pnm_ppm P6_readimage(FILE *fp, const P6_header *header,
+                            A2Methods_T methods, int blockw, int blockh,
+                            int packed, Parallel_T pool);
+
+/* reads the pixels after a header read with P6_readheader into pixmap,
+   reusing its array, which must be header->width x header->height with
+   elements of P6_packedsize(header) bytes if packed is nonzero or of a
+   Pnm_rgb if not; the denominator is set from the header; pool is as
+   for P6_readimage */
+extern void P6_readpixels(FILE *fp, const P6_header *header, Pnm_ppm pixmap,
+                          int packed, Parallel_T pool);
+
+/* reads the window [x, x + w) x [y, y + h) of a P6 or P5 image as a
+   pixmap, packed if packed is nonzero; the window must lie inside the
+   image and fp must not have been read past the header.  Blocks are
+   blockw x blockh, with 0 x 0 meaning the methods' default.  fp is left
+   somewhere after the window's last row. */
+extern Pnm_ppm P6_readwindow(FILE *fp, const P6_header *header, int x, int y,
+                             int w, int h, A2Methods_T methods,
+                             int blockw, int blockh, int packed);
+
+/* writes pixmap, which must have cursors, as a P6 ppm, like
+   Pnm_ppmwrite, or as a P5 pgm if it holds packed gray pixels; with a
+   pool, several bands are formatted at once.  Returns 1, or 0 if
+   writing failed, which is not raised. */
+extern int P6_write(FILE *fp, Pnm_ppm pixmap, Parallel_T pool);
+
+#endif
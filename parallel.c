@@ -0,0 +1,280 @@
+/*
+ *      parallel.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the Parallel_T thread pool. The helper
+ *              threads sleep on a condition variable between jobs; a job
+ *              is published by bumping a generation number, and the
+ *              caller works on the job alongside the helpers before
+ *              waiting for them to finish.
+ *
+ *              An affine pool splits each job's items into one
+ *              contiguous share per thread. A thread works through its
+ *              own share first, then takes what is left of the others',
+ *              starting with its neighbours', so the balancing of the
+ *              shared counter is kept.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "parallel.h"
+
+struct helper {
+        Parallel_T pool;
+        int thread;
+};
+
+/* one thread's share of an affine job, on its own cache line */
+struct share {
+        int next, end;                  /* items left: [next, end) */
+        long home;                      /* items its thread ran */
+        long stolen;                    /* items its thread took from
+                                           other shares */
+} __attribute__((aligned(64)));
+
+struct Parallel_T {
+        int nthreads;
+        pthread_t *threads;             /* the nthreads - 1 helpers */
+        struct helper *helpers;
+
+        pthread_mutex_t lock;
+        pthread_cond_t start;           /* a new job or quit */
+        pthread_cond_t done;            /* the last helper finished */
+        unsigned long generation;       /* counts jobs published */
+        int busy;                       /* helpers still on this job */
+        int quit;
+        int affine;                     /* split jobs into shares */
+        struct share *shares;           /* one per thread */
+
+        /* the current job */
+        Parallel_work *work;
+        void *cl;
+        int nitems;
+        int next;                       /* next item to hand out */
+        int each;                       /* run once on every thread */
+};
+
+
+/********** run_items ********
+ *
+ *      takes items of the current job until there are none left
+ *
+ ******************************/
+static void run_items(Parallel_T pool, int thread)
+{
+        int item;
+
+        if (pool->each) {
+                pool->work(thread, thread, pool->cl);
+                return;
+        }
+        if (!pool->affine) {
+                while ((item = __atomic_fetch_add(&pool->next, 1,
+                                                  __ATOMIC_RELAXED))
+                       < pool->nitems)
+                        pool->work(item, thread, pool->cl);
+                return;
+        }
+
+        struct share *mine = &pool->shares[thread];
+        for (int k = 0; k < pool->nthreads; k++) {
+                struct share *s = &pool->shares[(thread + k)
+                                                % pool->nthreads];
+                while ((item = __atomic_fetch_add(&s->next, 1,
+                                                  __ATOMIC_RELAXED))
+                       < s->end) {
+                        pool->work(item, thread, pool->cl);
+                        if (k == 0)
+                                mine->home++;
+                        else
+                                mine->stolen++;
+                }
+        }
+}
+
+static void *helper_main(void *arg)
+{
+        struct helper *me = arg;
+        Parallel_T pool = me->pool;
+        unsigned long seen = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (pool->generation == seen && !pool->quit)
+                        pthread_cond_wait(&pool->start, &pool->lock);
+                if (pool->quit)
+                        break;
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                run_items(pool, me->thread);
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->busy == 0)
+                        pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+}
+
+/********** Parallel_new ********
+ *
+ *      creates a pool and starts its helper threads
+ *
+ *      Parameters:
+ *              int nthreads: threads to work on each job, counting the
+ *                            thread that calls Parallel_for
+ *
+ *      Return:
+ *              the new pool
+ *
+ *      Notes:
+ *              CRE if nthreads < 1 or a thread cannot be created
+ *
+ ******************************/
+Parallel_T Parallel_new(int nthreads)
+{
+        assert(nthreads >= 1);
+
+        Parallel_T pool = calloc(1, sizeof(*pool));
+        assert(pool != NULL);
+
+        pool->nthreads = nthreads;
+        pool->threads = calloc(nthreads, sizeof(*pool->threads));
+        pool->helpers = calloc(nthreads, sizeof(*pool->helpers));
+        void *shares = NULL;
+        int err = posix_memalign(&shares, sizeof(struct share),
+                                 nthreads * sizeof(struct share));
+        assert(pool->threads != NULL && pool->helpers != NULL);
+        assert(err == 0);
+        pool->shares = memset(shares, 0, nthreads * sizeof(struct share));
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+
+        for (int t = 1; t < nthreads; t++) {
+                pool->helpers[t].pool = pool;
+                pool->helpers[t].thread = t;
+                err = pthread_create(&pool->threads[t], NULL, helper_main,
+                                     &pool->helpers[t]);
+                assert(err == 0);
+        }
+        return pool;
+}
+
+void Parallel_free(Parallel_T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        Parallel_T p = *pool;
+
+        pthread_mutex_lock(&p->lock);
+        p->quit = 1;
+        pthread_cond_broadcast(&p->start);
+        pthread_mutex_unlock(&p->lock);
+
+        for (int t = 1; t < p->nthreads; t++)
+                pthread_join(p->threads[t], NULL);
+
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->start);
+        pthread_cond_destroy(&p->done);
+        free(p->threads);
+        free(p->helpers);
+        free(p->shares);
+        free(p);
+        *pool = NULL;
+}
+
+int Parallel_threads(Parallel_T pool)
+{
+        return pool == NULL ? 1 : pool->nthreads;
+}
+
+void Parallel_affine(Parallel_T pool, int affine)
+{
+        assert(pool != NULL);
+        pool->affine = affine;
+}
+
+void Parallel_stats(Parallel_T pool, long *home, long *stolen)
+{
+        assert(home != NULL && stolen != NULL);
+        *home = *stolen = 0;
+        for (int t = 0; pool != NULL && t < pool->nthreads; t++) {
+                *home += pool->shares[t].home;
+                *stolen += pool->shares[t].stolen;
+        }
+}
+
+/********** run_job ********
+ *
+ *      publishes a job to the helpers, works on it, and waits for them
+ *      to finish it
+ *
+ ******************************/
+static void run_job(Parallel_T pool, int nitems, Parallel_work *work,
+                    void *cl, int each)
+{
+        int n = pool->nthreads;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->work = work;
+        pool->cl = cl;
+        pool->nitems = nitems;
+        pool->next = 0;
+        pool->each = each;
+        for (int t = 0; t < n; t++) {
+                pool->shares[t].next = (long)nitems * t / n;
+                pool->shares[t].end = (long)nitems * (t + 1) / n;
+        }
+        pool->busy = n - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        run_items(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0)
+                pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/********** Parallel_for ********
+ *
+ *      runs work on every item, spread over the threads of the pool
+ *
+ *      Parameters:
+ *              Parallel_T pool: the pool, or NULL to run serially
+ *              int nitems: number of items
+ *              Parallel_work *work: called as work(item, thread, cl)
+ *              void *cl: closure passed to work
+ *
+ *      Return:
+ *              nothing, once every item is done
+ *
+ ******************************/
+void Parallel_for(Parallel_T pool, int nitems, Parallel_work *work, void *cl)
+{
+        if (pool == NULL || pool->nthreads == 1 || nitems <= 1) {
+                for (int item = 0; item < nitems; item++)
+                        work(item, 0, cl);
+                return;
+        }
+        run_job(pool, nitems, work, cl, 0);
+}
+
+void Parallel_each(Parallel_T pool, Parallel_work *work, void *cl)
+{
+        if (pool == NULL || pool->nthreads == 1)
+                work(0, 0, cl);
+        else
+                run_job(pool, pool->nthreads, work, cl, 1);
+}
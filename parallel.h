@@ -0,0 +1,67 @@
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+/*
+ *      parallel.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              interface to a pool of worker threads, type Parallel_T,
+ *              for splitting a transformation into independent items
+ *              (tiles, strips, bands) that run in parallel. The threads
+ *              are created once and reused by every Parallel_for on the
+ *              pool. Items are handed out one at a time from a shared
+ *              counter, so uneven items balance themselves.
+ *
+ *      Usage:
+ *
+ *              Parallel_T pool = Parallel_new(4);
+ *              Parallel_for(pool, ntiles, do_tile, &job);
+ *              Parallel_free(&pool);
+ *
+ *      where do_tile(item, thread, cl) is called once for each item
+ *      in 0..ntiles-1; thread, in 0..nthreads-1, identifies the
+ *      calling thread so it can use per-thread scratch space.
+ *
+ *      An affine pool (see Parallel_affine) gives thread t the items
+ *      in [t * nitems / nthreads, (t + 1) * nitems / nthreads) before
+ *      any others, for jobs whose items should stay near the thread.
+ *
+ */
+
+typedef struct Parallel_T *Parallel_T;
+
+typedef void Parallel_work(int item, int thread, void *cl);
+
+/* a pool of nthreads threads, counting the caller of Parallel_for;
+   nthreads < 1 is a checked runtime error */
+extern Parallel_T Parallel_new(int nthreads);
+
+extern void Parallel_free(Parallel_T *pool);
+
+/* number of threads in pool, 1 for a NULL pool */
+extern int Parallel_threads(Parallel_T pool);
+
+/* calls work once for each item and returns when all are done;
+   a NULL pool runs every item on the calling thread.  Not to be
+   called from inside work on the same pool. */
+extern void Parallel_for(Parallel_T pool, int nitems, Parallel_work *work,
+                         void *cl);
+
+/* calls work(thread, thread, cl) once on each thread of pool, or once
+   on the caller for a NULL pool, as for setting up per-thread state */
+extern void Parallel_each(Parallel_T pool, Parallel_work *work, void *cl);
+
+/* nonzero affine makes each thread start on its own contiguous share
+   of a job's items; they are still spread over threads that finish
+   early */
+extern void Parallel_affine(Parallel_T pool, int affine);
+
+/* items that affine jobs have run so far on the thread whose share
+   they were in (home) and on another thread (stolen); zeros for a
+   NULL pool */
+extern void Parallel_stats(Parallel_T pool, long *home, long *stolen);
+
+#endif
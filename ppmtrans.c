@@ -15,38 +15,240 @@
  */
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <math.h>
+#include <limits.h>
+#include <malloc.h>
+#include <unistd.h>
 
 #include "assert.h"
+#include "except.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2hier.h"
+#include "a2compressed.h"
+#include "uarray2c.h"
+#include "a2cursor.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "cachesim.h"
+#include "elemsize.h"
+#include "parallel.h"
+#include "resample.h"
+#include "p6.h"
+#include "pyramid.h"
+#include "convolve.h"
+#include "fused.h"
+#include "numa.h"
+#include "serve.h"
+#include "incremental.h"
+#include "frames.h"
+#include "libppmtrans.h"
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
-        methods = (METHODS);                                    \
-        assert(methods);                                \
-        map = methods->MAP;                                     \
-        if (map == NULL) {                                      \
+        opts.methods = (METHODS);                               \
+        assert(opts.methods);                                   \
+        opts.map = opts.methods->MAP;                           \
+        opts.order = WHAT;                                      \
+        if (opts.map == NULL) {                                 \
                 fprintf(stderr, "%s does not support "          \
-                                WHAT "mapping\n",               \
+                                WHAT " mapping\n",              \
                                 argv[0]);                       \
-                exit(1);                                        \
+                quit();                                         \
         }                                                       \
 } while (false)
 
+/* rotation when the angle is not a multiple of 90 degrees */
+#define ROTATE_ANY -2
+
+
+/* what the command line asked for */
+struct options {
+        A2Methods_T methods;
+        A2Methods_mapfun *map;
+        const char *order;      /* name of the mapping order */
+        int rotation;           /* -1 if flipping or transposing */
+        double angle;           /* degrees, when rotation is ROTATE_ANY */
+        Resample_filter filter; /* interpolation, when rotation is 
+                                   ROTATE_ANY */
+        char *direction;        /* which way to flip, NULL if not */
+        bool scale;             /* resize after the transformation */
+        double factor;          /* of the resize, 0 if given as WxH */
+        int scale_width;        /* of the resize, 0 to keep the aspect */
+        int scale_height;       /*      ratio from the other one */
+        Resample_kernel kernel; /* filter for the resize */
+        bool crop;              /* read only a window of the image */
+        int crop_x, crop_y;     /* the window's top left corner */
+        int crop_w, crop_h;
+        char *pyramid_dir;      /* write tiles here, not the image to
+                                   stdout; NULL if not */
+        int tile;               /* of the pyramid */
+        Convolve_T convolve;    /* filter first with this, NULL if not */
+        bool fused;             /* go straight from input to output */
+        bool incremental;       /* a stream of frames, each redone only
+                                   where it changed */
+        bool frames;            /* a stream of frames, read, transformed
+                                   and written on three threads */
+        char *time_file_name;   /* NULL if not timing */
+        int block_w, block_h;   /* 0 for the methods' default */
+        int threads;
+        Ppmtrans_hints hints;   /* all off by default, so timings
+                                   compare with runs from before */
+        int numa;               /* NUMA nodes to simulate, 0 for the
+                                   machine's, -1 to not place memory */
+        CacheSim_T sim;         /* NULL if not simulating */
+};
+
+/* set while running a request for --serve, so that a bad request
+   fails rather than stopping the server */
+static bool serving = false;
+
+static Except_T Request_Failed = { "ppmtrans request failed" };
+
+/********** quit ********
+ *
+ *      gives up on the command: exits, or when serving raises
+ *      Request_Failed for the server to catch
+ *
+ ******************************/
+static void quit(void)
+{
+        if (serving)
+                RAISE(Request_Failed);
+        exit(1);
+}
+
+
+/* what the request being served holds, newest last, so that one that
+   stops part way can be freed: each is a handle and its free function */
+#define MAX_HELD 16
+static struct held {
+        void *thing;
+        void (*release)(void *thing);
+} held[MAX_HELD];
+static int nheld = 0;
+
+/********** hold, let_go ********
+ *
+ *      hold notes that the request being served owns thing, which
+ *      release frees; let_go forgets it, just before it is freed
+ *      the usual way
+ *
+ *      Notes:
+ *              both do nothing unless serving, or for a NULL thing
+ *              CRE if a request holds more than MAX_HELD things
+ *
+ ******************************/
+static void hold(void *thing, void (*release)(void *thing))
+{
+        if (!serving || thing == NULL)
+                return;
+        assert(nheld < MAX_HELD);
+        held[nheld].thing = thing;
+        held[nheld].release = release;
+        nheld++;
+}
+
+static void let_go(void *thing)
+{
+        for (int k = nheld - 1; k >= 0; k--)
+                if (held[k].thing == thing) {
+                        memmove(&held[k], &held[k + 1],
+                                (nheld - k - 1) * sizeof(held[0]));
+                        nheld--;
+                        return;
+                }
+}
+
+/********** release_held ********
+ *
+ *      frees everything a failed request still holds, newest first
+ *
+ ******************************/
+static void release_held(void)
+{
+        while (nheld > 0) {
+                nheld--;
+                held[nheld].release(held[nheld].thing);
+        }
+}
+
+static void release_pixmap(void *thing)
+{
+        Pnm_ppm pixmap = thing;
+        Pnm_ppmfree(&pixmap);
+}
+
+static void release_pool(void *thing)
+{
+        Parallel_T pool = thing;
+        Parallel_free(&pool);
+}
+
+static void release_timer(void *thing)
+{
+        CPUTime_T timer = thing;
+        CPUTime_Free(&timer);
+}
+
+static void release_file(void *thing)
+{
+        fclose(thing);
+}
+
+static void release_kernel(void *thing)
+{
+        Convolve_T kernel = thing;
+        Convolve_free(&kernel);
+}
+
+#ifdef CACHESIM
+static void release_sim(void *thing)
+{
+        CacheSim_T sim = thing;
+        CacheSim_Free(&sim);
+}
+#endif
+
+static void release_incremental(void *thing)
+{
+        Incremental_T inc = thing;
+        Incremental_free(&inc);
+}
+
+static void release_frames(void *thing)
+{
+        Frames_T frames = thing;
+        Frames_free(&frames);
+}
+
 static void
 usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] "
+                        "[-{row,col,block,hier}-major] [-compressed] "
+                        "[-interp {nearest,bilinear,bicubic}] "
+                        "[-scale {WxH,factor}] "
+                        "[-scale-filter {box,triangle,lanczos}] "
+                        "[-crop x,y,w,h] "
+                        "[-pyramid dir] [-tile n] "
+                        "[-filter kernel_file] [-fused] [-incremental] "
+                        "[-frames] "
                         "[-time time_file] "
-                        "[filename]\n",
-                        progname);
-        exit(1);
+                        "[-blocksize n] [-block WxH] [-threads n] "
+                        "[-numa {auto,nodes}] "
+                        "[-prefetch n] [-stream] "
+                        "[-cachesim l1=S:W:L,l2=S:W:L,tlb=N:W:P] "
+                        "[filename]\n"
+                        "       %s --serve socket [-threads n]\n"
+                        "       %s --client socket {options,--stats,--stop}"
+                        "\n",
+                        progname, progname, progname);
+        quit();
 }
 
 
@@ -80,8 +282,10 @@ static FILE *open_or_abort(char *fname, char *mode)
 
 /********** apply functions ********
  *
- *      The following seven functions are all apply functions used to 
- *      transform an image based on the desired transformation method.
+ *      The apply functions used to transform an image based on the 
+ *      desired transformation method are generated by DEFINE_TRANSFORM
+ *      below: one for each element size in elemsize.h, one for any
+ *      other size, and NAME_for_size to pick between them.
  *
  *      Parameters:
  *              int i: the current column index
@@ -103,80 +307,136 @@ static FILE *open_or_abort(char *fname, char *mode)
  *              there is one transpose function
  *              The only difference between these functions is the index of
  *                      the given image pixel that is set to the current index
+ *              Each reports the pixel it writes to the cache simulator
+ *                      (the read is reported by the at function)
  *      
  ******************************/
-void r270(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
-{
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, 
-                                                (pixmap->width - j - 1), 
-                                                 i);
+#define DEFINE_APPLY(NAME, SIZE, COL, ROW)                              \
+static void NAME(int i, int j, A2Methods_UArray2 new_a2,                \
+                 A2Methods_Object *elem, void *cl)                      \
+{                                                                       \
+        (void) new_a2;                                                  \
+        Pnm_ppm pixmap = (Pnm_ppm) cl;                                  \
+        ELEMSIZE_COPY(elem,                                             \
+                      pixmap->methods->at(pixmap->pixels, (COL), (ROW)),\
+                      (SIZE));                                          \
+        CACHESIM_TRACE(elem, (SIZE));                                   \
 }
 
-void r180(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
-{
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, 
-                                                (pixmap->width - i - 1), 
-                                                (pixmap->height - j - 1));
-}
+#define DEFINE_APPLY_SIZED(N, NAME, COL, ROW)                           \
+        DEFINE_APPLY(NAME##_##N, N, COL, ROW)
 
-void r90(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
-{
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, 
-                                                j, 
-                                                (pixmap->height - i - 1));
-}
+#define APPLY_CASE(N, NAME) case N: return NAME##_##N;
 
-void r0(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
-{
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, i, j);
+#define DEFINE_TRANSFORM(NAME, COL, ROW)                                \
+ELEMSIZE_FOREACH(DEFINE_APPLY_SIZED, NAME, COL, ROW)                    \
+DEFINE_APPLY(NAME##_any, pixmap->methods->size(pixmap->pixels), COL, ROW) \
+static A2Methods_applyfun *NAME##_for_size(int size)                    \
+{                                                                       \
+        switch (size) {                                                 \
+        ELEMSIZE_FOREACH(APPLY_CASE, NAME)                              \
+        default: return NAME##_any;                                     \
+        }                                                               \
 }
 
+/*               name       source column           source row */
+DEFINE_TRANSFORM(r0,        i,                      j)
+DEFINE_TRANSFORM(r90,       j,                      pixmap->height - i - 1)
+DEFINE_TRANSFORM(r180,      pixmap->width - i - 1,  pixmap->height - j - 1)
+DEFINE_TRANSFORM(r270,      pixmap->width - j - 1,  i)
+DEFINE_TRANSFORM(flip_vert, pixmap->width - i - 1,  j)
+DEFINE_TRANSFORM(flip_hori, i,                      pixmap->height - j - 1)
+DEFINE_TRANSFORM(transpose, j,                      i)
 
-void flip_vert(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
-{
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, 
-                                                (pixmap->width - i - 1),
-                                                j);
-}
 
-void flip_hori(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
+/********** run_transform ********
+ *
+ *      fills the new array with a transformation of the image
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the pixmap holding the original image
+ *              A2Methods_UArray2 new_a2: the array to fill
+ *              A2Methods_mapfun *map: the map function asked for
+ *              A2Methods_applyfun *apply: the transformation's apply
+ *                                         function
+ *              Ppmtrans_op op: the same transformation, for libppmtrans
+ *              const Ppmtrans_hints *hints: prefetching and stores
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              when map visits cells in storage order and the methods
+ *              have cursors, Ppmtrans_pixmap is used instead of map,
+ *              which gives the same result without a call per element;
+ *              only that path is spread over the pool and uses the hints
+ *      
+ ******************************/
+static void run_transform(Pnm_ppm pixmap, A2Methods_UArray2 new_a2,
+                          A2Methods_mapfun *map, A2Methods_applyfun *apply,
+                          Ppmtrans_op op, const Ppmtrans_hints *hints,
+                          Parallel_T pool)
 {
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, 
-                                                i,
-                                                (pixmap->height - j - 1));
+        A2Methods_T methods = pixmap->methods;
+
+        if (A2Methods_cursor(methods) == NULL || map != methods->map_default) {
+                map(new_a2, apply, pixmap);
+                return;
+        }
+
+        struct Pnm_ppm result = {
+                .width = methods->width(new_a2),
+                .height = methods->height(new_a2),
+                .denominator = pixmap->denominator,
+                .pixels = new_a2,
+                .methods = methods
+        };
+        int err = Ppmtrans_pixmap(op, pixmap, &result, hints, pool);
+        assert(err == PPMTRANS_OK);
 }
 
-void transpose(int i, int j, A2Methods_UArray2 new_a2, 
-                                        A2Methods_Object *elem, void *cl)
+
+/********** new_like ********
+ *
+ *      creates an empty 2D array for the result of a transformation,
+ *      using the same methods, element size and block shape as the
+ *      image being transformed
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the pixmap holding the original image
+ *              int width: width of the new array
+ *              int height: height of the new array
+ *
+ *      Return: 
+ *              the new 2D array
+ *
+ *      Notes:
+ *              the plain methods ignore the block shape
+ *              the shape is kept as is, not turned with the image, so
+ *              that -block WxH describes every array of the run
+ *              spread over NUMA nodes when a Numa_T is attached
+ *      
+ ******************************/
+static A2Methods_UArray2 new_like(Pnm_ppm pixmap, int width, int height)
 {
-        (void) new_a2;
-        Pnm_ppm pixmap = (Pnm_ppm) cl;
-        Pnm_rgb pix    = (Pnm_rgb) elem;
-        *pix           = *(Pnm_rgb) pixmap->methods->at(pixmap->pixels, j, i);
+        A2Methods_T methods = pixmap->methods;
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        int size = methods->size(pixmap->pixels);
+        A2Methods_UArray2 new_a2;
+
+        if (cursors != NULL) {
+                int bw, bh;
+                cursors->blockshape(pixmap->pixels, &bw, &bh);
+                new_a2 = cursors->new_with_blockshape(width, height, size,
+                                                      bw, bh);
+        } else {
+                new_a2 = methods->new_with_blocksize(width, height, size,
+                                        methods->blocksize(pixmap->pixels));
+        }
+
+        Numa_Place(methods, new_a2);
+        return new_a2;
 }
 
 
@@ -188,6 +448,8 @@ void transpose(int i, int j, A2Methods_UArray2 new_a2,
  *              char *direction: a string containing direction to flip
  *                              note: NULL for transpose
  *              Pnm_ppm pixmap: the pixmap holding the original image
+ *              const Ppmtrans_hints *hints: prefetching and stores
+ *              Parallel_T pool: threads to share the work, or NULL
  *
  *      Return: 
  *              nothing
@@ -199,7 +461,8 @@ void transpose(int i, int j, A2Methods_UArray2 new_a2,
  *              frees the 2D array holding the old image in pixmap
  *      
  ******************************/
-void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map)
+void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map,
+               const Ppmtrans_hints *hints, Parallel_T pool)
 {
         /* convience: variable to use throughout */
         int w = pixmap->methods->width(pixmap->pixels);
@@ -208,9 +471,10 @@ void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map)
 
         /* code for transposing */
         if (direction == NULL) {
-                A2Methods_UArray2 new_a2 = pixmap->methods->new(h, w, s);
+                A2Methods_UArray2 new_a2 = new_like(pixmap, h, w);
 
-                map(new_a2, transpose, pixmap);
+                run_transform(pixmap, new_a2, map, transpose_for_size(s),
+                              PPMTRANS_TRANSPOSE, hints, pool);
 
                 pixmap->methods->free(&(pixmap->pixels));
                 pixmap->pixels = new_a2;
@@ -220,13 +484,15 @@ void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map)
         }
 
         /* the following is code to flip */
-        A2Methods_UArray2 new_a2 = pixmap->methods->new(w, h, s);
+        A2Methods_UArray2 new_a2 = new_like(pixmap, w, h);
 
         /* check which direction to flip */
         if (strcmp(direction, "vertical"))
-                map(new_a2, flip_vert, pixmap);
+                run_transform(pixmap, new_a2, map, flip_vert_for_size(s),
+                              PPMTRANS_FLIP_HORIZONTAL, hints, pool);
         else
-                map(new_a2, flip_hori, pixmap);
+                run_transform(pixmap, new_a2, map, flip_hori_for_size(s),
+                              PPMTRANS_FLIP_VERTICAL, hints, pool);
 
         pixmap->methods->free(&(pixmap->pixels));
         pixmap->pixels = new_a2;
@@ -240,6 +506,8 @@ void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map)
  *      Parameters:
  *              int rotation: degree of rotation being done
  *              Pnm_ppm pixmap: the pixmap holding the original image
+ *              const Ppmtrans_hints *hints: prefetching and stores
+ *              Parallel_T pool: threads to share the work, or NULL
  *
  *      Return: 
  *              nothing
@@ -251,7 +519,8 @@ void transform(char *direction, Pnm_ppm pixmap, A2Methods_mapfun *map)
  *              frees the 2D array holding the old image in pixmap
  *      
  ******************************/
-void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map)
+void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map,
+            const Ppmtrans_hints *hints, Parallel_T pool)
 {
         /* convience: variable to use throughout */
         int w = pixmap->methods->width(pixmap->pixels);
@@ -260,25 +529,29 @@ void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map)
 
         /* code to rotate where the dimensions of the array don't change */
         if (rotation == 0 || rotation == 180) {
-                A2Methods_UArray2 new_a2 = pixmap->methods->new(w, h, s);
+                A2Methods_UArray2 new_a2 = new_like(pixmap, w, h);
 
                 /* determines if rotating 0 or 180 */
                 if (rotation == 0)
-                        map(new_a2, r0, pixmap);
+                        run_transform(pixmap, new_a2, map, r0_for_size(s),
+                                      PPMTRANS_ROTATE_0, hints, pool);
                 else
-                        map(new_a2, r180, pixmap);
+                        run_transform(pixmap, new_a2, map, r180_for_size(s),
+                                      PPMTRANS_ROTATE_180, hints, pool);
 
                 pixmap->methods->free(&(pixmap->pixels));
                 pixmap->pixels = new_a2;
         } else {
                 /* code to rotate where the dimensions of the array flop */
-                A2Methods_UArray2 new_a2 = pixmap->methods->new(h, w, s);
+                A2Methods_UArray2 new_a2 = new_like(pixmap, h, w);
 
                 /* determines if rotating 0 or 180 */
                 if (rotation == 90)
-                        map(new_a2, r90, pixmap);
+                        run_transform(pixmap, new_a2, map, r90_for_size(s),
+                                      PPMTRANS_ROTATE_90, hints, pool);
                 else
-                        map(new_a2, r270, pixmap);
+                        run_transform(pixmap, new_a2, map, r270_for_size(s),
+                                      PPMTRANS_ROTATE_270, hints, pool);
                 
                 pixmap->methods->free(&(pixmap->pixels));
                 pixmap->pixels = new_a2;
@@ -288,6 +561,112 @@ void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map)
 } 
 
 
+/********** append ********
+ *
+ *      adds printf-style text to the end of the string in buf, cutting
+ *      it short rather than running past the end of buf
+ *
+ *      Parameters:
+ *              char *buf: the string to add to
+ *              size_t size: the size of buf, at least 1
+ *              size_t *len: the length of the string in buf, updated
+ *              const char *fmt, ...: the text to add, as for printf
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              *len never passes size - 1, so it is always safe to
+ *              append again
+ *      
+ ******************************/
+static void append(char *buf, size_t size, size_t *len, const char *fmt, ...)
+{
+        va_list ap;
+
+        va_start(ap, fmt);
+        int n = vsnprintf(buf + *len, size - *len, fmt, ap);
+        va_end(ap);
+
+        if (n > 0)
+                *len = *len + n < size ? *len + n : size - 1;
+}
+
+
+/********** describe ********
+ *
+ *      names the transformation asked for, as in "rotate 90" or 
+ *      "flip horizontally", for the timing and cache reports
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options
+ *              char *buf: where to write the name
+ *              size_t size: the size of buf
+ *
+ *      Return: 
+ *              nothing
+ *      
+ ******************************/
+static void describe(struct options *opts, char *buf, size_t size)
+{
+        static const char *filters[] = { "nearest", "bilinear", "bicubic" };
+        static const char *kernels[] = { "box", "triangle", "lanczos" };
+        size_t len = 0;
+
+        buf[0] = '\0';
+
+        if (opts->convolve != NULL)
+                append(buf, size, &len, "filter %dx%d%s, ",
+                       Convolve_width(opts->convolve),
+                       Convolve_height(opts->convolve),
+                       Convolve_separable(opts->convolve)
+                               ? " (separable)" : "");
+
+        if (opts->rotation == ROTATE_ANY)
+                append(buf, size, &len, "rotate %g (%s), ",
+                       opts->angle, filters[opts->filter]);
+        else if (opts->rotation > 0 || (opts->rotation == 0 && !opts->scale
+                                         && opts->pyramid_dir == NULL
+                                         && opts->convolve == NULL))
+                append(buf, size, &len, "rotate %d, ",
+                       opts->rotation);
+        else if (opts->direction != NULL)
+                append(buf, size, &len, "flip %sly, ",
+                       opts->direction);
+        else if (opts->rotation == -1)
+                append(buf, size, &len, "transpose, ");
+
+        if (opts->scale && opts->factor > 0)
+                append(buf, size, &len, "scale %g (%s), ",
+                       opts->factor, kernels[opts->kernel]);
+        else if (opts->scale)
+                append(buf, size, &len, "scale %dx%d (%s), ",
+                       opts->scale_width, opts->scale_height,
+                       kernels[opts->kernel]);
+        if (opts->pyramid_dir != NULL)
+                append(buf, size, &len, "pyramid (tile %d), ",
+                       opts->tile);
+        if (opts->fused)
+                append(buf, size, &len, "fused, ");
+        if (opts->incremental)
+                append(buf, size, &len, "incremental, ");
+        if (opts->frames)
+                append(buf, size, &len, "frames, ");
+
+        /* the hints only change right-angle transformations */
+        bool exact = opts->rotation != ROTATE_ANY && !opts->fused;
+        if (exact && opts->hints.prefetch > 0)
+                append(buf, size, &len, "prefetch %d, ",
+                       opts->hints.prefetch);
+        if (exact && opts->hints.stream)
+                append(buf, size, &len, "stream, ");
+
+        /* drop the last ", " */
+        if (len >= 2 && strcmp(buf + len - 2, ", ") == 0)
+                buf[len - 2] = '\0';
+}
+
+
 /********** time_output ********
  *
  *      handles outputting timing data to our output file by writing the 
@@ -295,12 +674,9 @@ void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map)
  *
  *      Parameters:
  *              double time: time in nanoseconds for transformation
- *              char *time_file_name: name of file to write to
- *              int rotation: type of rotation done
- *                              note: -1 if image not rotated
- *              Pnm_ppm pixmap: the pixmap holding the original image
- *              char *direction: direction of flip
- *                              note: NULL if transposed or rotated
+ *              struct options *opts: the command line options, which
+ *                      name the transformation and the time file
+ *              double pixels: the number of pixels in the image
  *
  *      Return: 
  *              nothing
@@ -310,44 +686,257 @@ void rotate(int rotation, Pnm_ppm pixmap, A2Methods_mapfun *map)
  *
  *      Notes:
  *              exit with a checked runtime error if failed to open file
+ *              the time is CPU time, which counts every thread
  *      
  ******************************/
-void time_output(double time, char *time_file_name, int rotation, 
-                                Pnm_ppm pixmap, char *direction)
+void time_output(double time, struct options *opts, double pixels)
 {
+        char what[128];
+        describe(opts, what, sizeof(what));
+
         /* opens or creates the time output file */
-        FILE *time_file = fopen(time_file_name, "a");
+        FILE *time_file = fopen(opts->time_file_name, "a");
         assert(time_file);
-        
-        /* check what type of transformation needs to occur */
-        if (rotation == -1) {
-                if (direction == NULL) {
-                        fprintf(time_file, 
-                        "Time taken to do transpose: %.0f ns.\n", time);
-                        double time_per_pix = time / (pixmap->height * 
-                                                                pixmap->width);
-                        fprintf(time_file, 
-                        "Time taken to do transpose per pixel: %.0f ns.\n",
-                        time_per_pix);
-                } else {
-                        fprintf(time_file, 
-                        "Time taken to do flip %sly: %.0f ns.\n", 
-                                direction, time);
-                        double time_per_pix = time / (pixmap->height * 
-                                                                pixmap->width);
-                        fprintf(time_file, 
-                        "Time taken to do flip %sly per pixel: %.0f ns.\n",
-                        direction, time_per_pix);
-                }
-        } else { 
-                fprintf(time_file, 
-                        "Time taken to do rotate %d: %.0f ns.\n",
-                        rotation, time);
-                double time_per_pix = time / (pixmap->height * pixmap->width);
-                fprintf(time_file, 
-                        "Time taken to do rotate %d per pixel: %.0f ns.\n",
-                        rotation, time_per_pix);
+
+        fprintf(time_file, "Time taken to do %s: %.0f ns.\n", what, time);
+        double time_per_pix = time / pixels;
+        fprintf(time_file, "Time taken to do %s per pixel: %.0f ns.\n",
+                what, time_per_pix);
+        fclose(time_file);
+}
+
+
+/********** compressed_output ********
+ *
+ *      adds the memory taken by a compressed result to the time file
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options
+ *              Pnm_ppm pixmap: the pixmap holding the transformed image,
+ *                              in a UArray2c
+ *
+ *      Return: 
+ *              nothing
+ *      
+ ******************************/
+static void compressed_output(struct options *opts, Pnm_ppm pixmap)
+{
+        size_t raw;
+        size_t bytes = UArray2c_resident(pixmap->pixels, &raw);
+
+        FILE *time_file = fopen(opts->time_file_name, "a");
+        assert(time_file);
+        fprintf(time_file, "Compressed result: %zu bytes, %.1f%% of the "
+                           "%zu bytes of its blocks.\n", bytes,
+                raw > 0 ? 100.0 * bytes / raw : 100.0, raw);
+        fclose(time_file);
+}
+
+
+/********** cachesim_output ********
+ *
+ *      prints the cache simulator's predictions for a transformation
+ *      to stderr, labelled with the operation and mapping order
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options, which
+ *                      hold the simulator and name the transformation
+ *              Pnm_ppm pixmap: the pixmap holding the transformed image
+ *
+ *      Return: 
+ *              nothing
+ *      
+ ******************************/
+static void cachesim_output(struct options *opts, Pnm_ppm pixmap)
+{
+        char label[160];
+        int bw, bh, tw, th;
+        A2Methods_CursorT cursors = A2Methods_cursor(pixmap->methods);
+
+        cursors->blockshape(pixmap->pixels, &bw, &bh);
+        cursors->tileshape(pixmap->pixels, &tw, &th);
+        describe(opts, label, sizeof(label));
+
+        size_t len = strlen(label);
+        if (bw != bh)
+                append(label, sizeof(label), &len, 
+                       ", %s (block %dx%d", opts->order, bw, bh);
+        else if (bw > 1)
+                append(label, sizeof(label), &len, 
+                       ", %s (blocksize %d", opts->order, bw);
+        else
+                append(label, sizeof(label), &len, ", %s", 
+                       opts->order);
+        if (tw != bw || th != bh)
+                append(label, sizeof(label), &len, ", tiles %dx%d", tw, th);
+        if (bw * bh > 1)
+                append(label, sizeof(label), &len, ")");
+
+        CacheSim_Report(opts->sim, stderr, label, 
+                        (double)pixmap->width * pixmap->height);
+}
+
+
+/********** scale ********
+ *
+ *      resizes the transformed image as asked for by -scale
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options, which
+ *                      give the new size or factor and the filter
+ *              Pnm_ppm pixmap: the pixmap holding the image
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return: 
+ *              false, after saying why, if the new size has more than
+ *              INT_MAX pixels; the image is then left as it was
+ *
+ *      Notes:
+ *              a size of 0 in WxH follows the other, keeping the aspect
+ *              ratio; sizes never round down to 0
+ *              returns rather than quitting, as it may run on the work
+ *              thread of -frames
+ *      
+ ******************************/
+static bool scale(struct options *opts, Pnm_ppm pixmap, Parallel_T pool)
+{
+        double w = pixmap->width;
+        double h = pixmap->height;
+        double width, height;
+
+        if (opts->factor > 0) {
+                width = w * opts->factor;
+                height = h * opts->factor;
+        } else {
+                width = opts->scale_width;
+                height = opts->scale_height;
+                if (width == 0)
+                        width = w * height / h;
+                if (height == 0)
+                        height = h * width / w;
+        }
+
+        width = width < 1 ? 1 : floor(width + 0.5);
+        height = height < 1 ? 1 : floor(height + 0.5);
+        if (width * height > INT_MAX) {
+                fprintf(stderr, "Scaled image of %.0fx%.0f pixels is too "
+                                "large\n", width, height);
+                return false;
+        }
+        Resample_scale(pixmap, width, height, opts->kernel, pool);
+        return true;
+}
+
+
+/********** packable ********
+ *
+ *      whether a pgm or 16-bit ppm can be read packed (see read_input):
+ *      true when the only work is to move pixels
+ *
+ ******************************/
+static bool packable(struct options *opts)
+{
+        return opts->rotation != ROTATE_ANY && !opts->scale
+               && opts->pyramid_dir == NULL && opts->convolve == NULL;
+}
+
+/********** read_input ********
+ *
+ *      reads the image, or just the window of it asked for by -crop
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options, which
+ *                      give the window, methods and blocksize
+ *              FILE *fp: file pointer to the image file provided
+ *              Parallel_T pool: threads to decode a whole image, or
+ *                      NULL
+ *
+ *      Return: 
+ *              a pixmap holding the image or window
+ *
+ *      Expects:
+ *              a ppm or pgm file; a raw one if cropping
+ *
+ *      Notes:
+ *              a pgm or 16-bit ppm is kept packed, in 1, 2 or 6 byte
+ *                      elements rather than 12, when the only work is a
+ *                      rotation by a multiple of 90 degrees, a flip or
+ *                      a transpose, which just move pixels; 8-bit ppms
+ *                      stay Pnm_rgb, so their timings still compare
+ *                      with earlier runs
+ *              a window hanging off the image is cut down to fit; one
+ *                      entirely outside it is an error and exits
+ *      
+ ******************************/
+static Pnm_ppm read_input(struct options *opts, FILE *fp, Parallel_T pool)
+{
+        P6_header header;
+        P6_readheader(fp, &header);
+
+        int packed = packable(opts) && (header.channels == 1
+                                        || header.bytes == 2);
+        if (!opts->crop)
+                return P6_readimage(fp, &header, opts->methods,
+                                    opts->block_w, opts->block_h, packed,
+                                    pool);
+
+        long x0 = opts->crop_x;
+        long y0 = opts->crop_y;
+        long x1 = x0 + opts->crop_w;
+        long y1 = y0 + opts->crop_h;
+        if (x1 > (long)header.width)
+                x1 = header.width;
+        if (y1 > (long)header.height)
+                y1 = header.height;
+
+        if (x0 >= x1 || y0 >= y1) {
+                fprintf(stderr, "Crop window is outside the %ux%u image\n",
+                        header.width, header.height);
+                quit();
         }
+
+        return P6_readwindow(fp, &header, x0, y0, x1 - x0, y1 - y0,
+                             opts->methods, opts->block_w, opts->block_h,
+                             packed);
+}
+
+
+/********** run_steps ********
+ *
+ *      filters, rotates, flips or transposes, and resizes the image, as
+ *      the command line asked
+ *
+ *      Parameters:
+ *              struct options *opts: the command line options
+ *              Pnm_ppm pixmap: the image, whose array is replaced by
+ *                              the result
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return: 
+ *              false, after saying why, if the rotated or resized image
+ *              would be too large (see scale); the image is then left
+ *              as it was after the steps before
+ *      
+ ******************************/
+static bool run_steps(struct options *opts, Pnm_ppm pixmap, Parallel_T pool)
+{
+        if (opts->convolve != NULL)
+                Convolve_apply(pixmap, opts->convolve, pool);
+        if (opts->rotation == ROTATE_ANY) {
+                if (!Resample_rotate(pixmap, opts->angle, opts->filter,
+                                     pool)) {
+                        fprintf(stderr, "Image rotated by %g degrees would "
+                                        "have more than %d pixels\n",
+                                opts->angle, INT_MAX);
+                        return false;
+                }
+        } else if (opts->rotation == -1)
+                transform(opts->direction, pixmap, opts->map,
+                          &opts->hints, pool);
+        else
+                rotate(opts->rotation, pixmap, opts->map, &opts->hints,
+                       pool);
+        return !opts->scale || scale(opts, pixmap, pool);
 }
 
 
@@ -355,138 +944,864 @@ void time_output(double time, char *time_file_name, int rotation,
  *
  *      stores the provided image as a Pnm_ppm pixmap
  *      runs the provided transformation while timing it
- *      prints the transformed image to stdout
+ *      prints the transformed image to out
  *      writes time data to file if applicable
  *
  *      Parameters:
- *              A2Methods_T methods: a method suite to be given to the pixmap
- *              int rotation: degree to rotate the image
- *                              note: -1 if flipping or transposing
- *              char *time_file_name: name of desired file to output time data
+ *              struct options *opts: the transformation, method suite,
+ *                      map and reporting asked for on the command line
  *              FILE *fp: file pointer to the image file provided
- *              char *direction: direction to flip the image
- *                              note: NULL if rotating or transposing
+ *              FILE *out: where the image goes (stdout, or a client's)
+ *              Parallel_T shared: threads to use instead of starting
+ *                      new ones, or NULL
  *
  *      Return: 
  *              nothing
  *
  *      Expects:
- *              a valid ppm file to be provided
- *              the desired methods suite based on command line arguments
+ *              a valid ppm or pgm file to be provided
  *
  *      Notes:
  *              frees the pixmap and timer at the end of the function
+ *              reading (or cropping) the image and starting threads
+ *                      are not part of the timed work; writing a
+ *                      pyramid is timed
+ *              with -numa the threads are pinned before the image is
+ *                      read, and every array made until the
+ *                      transformation is done, the image's included, is
+ *                      spread over the nodes
+ *              with shared threads, -threads only says whether to use
+ *                      them
  *      
  ******************************/
-void ppmtrans(A2Methods_T methods, int rotation, char *time_file_name, 
-                        FILE *fp, char *direction, A2Methods_mapfun *map)
+void ppmtrans(struct options *opts, FILE *fp, FILE *out, Parallel_T shared)
 {
-        Pnm_ppm pixmap = Pnm_ppmread(fp, methods);
+        Parallel_T pool = NULL;
+        Numa_T numa = NULL;
+
+        if (opts->threads > 1)
+                pool = shared != NULL ? shared
+                                      : Parallel_new(opts->threads);
+        if (pool != shared)
+                hold(pool, release_pool);
+        if (opts->numa >= 0) {
+                numa = Numa_new(opts->numa);
+                Numa_pin(numa, pool);
+                Numa_Attach(numa);
+        }
+
+        Pnm_ppm pixmap = read_input(opts, fp, pool);
+        hold(pixmap, release_pixmap);
         CPUTime_T timer = CPUTime_New();
+        hold(timer, release_timer);
 
         /* times and runs the desired transformation */
+        if (opts->sim != NULL)
+                CacheSim_Attach(opts->sim);
         CPUTime_Start(timer);
-        if (rotation == -1)
-                transform(direction, pixmap, map);
-        else
-                rotate(rotation, pixmap, map);
+        if (!run_steps(opts, pixmap, pool))
+                quit();
+        if (opts->pyramid_dir != NULL)
+                Pyramid_write(pixmap, opts->pyramid_dir, opts->tile, pool);
         double time = CPUTime_Stop(timer);
+        CacheSim_Detach();
+        Numa_Detach();
         
-        /* output transformed image */
-        Pnm_ppmwrite(stdout, pixmap);
+        /* output transformed image, unless it went into a pyramid */
+        if (opts->pyramid_dir == NULL) {
+                int written = P6_write(out, pixmap, pool);
+                assert(written);
+        }
 
         /* write to the timing file */
-        if (time_file_name != NULL)
-                time_output(time, time_file_name, rotation, pixmap, direction);
+        if (opts->time_file_name != NULL)
+                time_output(time, opts,
+                            (double)pixmap->width * pixmap->height);
+        if (opts->time_file_name != NULL
+            && pixmap->methods == uarray2_methods_compressed)
+                compressed_output(opts, pixmap);
+
+        if (opts->sim != NULL)
+                cachesim_output(opts, pixmap);
+        if (numa != NULL) {
+                Numa_report(numa, pool, stderr);
+                Numa_free(&numa);
+        }
         
+        let_go(timer);
+        let_go(pixmap);
+        let_go(pool);
+        if (pool != NULL && pool != shared)
+                Parallel_free(&pool);
         Pnm_ppmfree(&pixmap);
         CPUTime_Free(&timer);
 }
 
 
-/********** main ********
+/********** ppmtrans_fused ********
  *
- *      handles command line arguments 
+ *      does a right-angle transformation straight from the input file
+ *      to the output, timing all of it
  *
  *      Parameters:
- *              int argc: the number of arguments given to the command line
- *              char *argv[]: an array of the arguments given to the command
- *                            line
+ *              struct options *opts: the transformation and reporting
+ *                      asked for on the command line
+ *              FILE *fp: file pointer to the image file provided
+ *              FILE *out, Parallel_T shared: as for ppmtrans
  *
  *      Return: 
- *              exit code
+ *              nothing
  *
  *      Expects:
- *              nothing
+ *              a rotation, flip or transpose (main checks)
  *
  *      Notes:
- *              added command line handing for transpose, flip and rotating 270
- *              functions
+ *              a plain (P3 or P2) file cannot be copied byte for byte,
+ *              so it is refused with a message and the command quits
+ *              reading the pixels and writing are part of the timed
+ *              work, as they cannot be told apart from the
+ *              transformation
  *      
  ******************************/
-int main(int argc, char *argv[])
+static void ppmtrans_fused(struct options *opts, FILE *fp, FILE *out,
+                           Parallel_T shared)
 {
-        char *time_file_name = NULL;
-        int   rotation       = 0;
-        char *direction      = NULL; /* to know which way to flip image */
-        int   i;
+        CPUTime_T timer;
+        Parallel_T pool = NULL;
+        P6_header header;
+        Fused_op op;
 
-        /* default to UArray2 methods */
-        A2Methods_T methods = uarray2_methods_plain; 
-        assert(methods != NULL);
+        P6_readheader(fp, &header);
+        if (!header.raw) {
+                fprintf(stderr, "-fused needs P6 or P5 input, not plain "
+                                "P3 or P2\n");
+                quit();
+        }
 
-        /* default to best map */
-        A2Methods_mapfun *map = methods->map_default; 
-        assert(map != NULL);
+        if (opts->rotation >= 0)
+                op = FUSED_ROTATE_0 + opts->rotation / 90;
+        else if (opts->direction == NULL)
+                op = FUSED_TRANSPOSE;
+        else if (strcmp(opts->direction, "horizontal") == 0)
+                op = FUSED_FLIP_HORIZONTAL;
+        else
+                op = FUSED_FLIP_VERTICAL;
 
-        for (i = 1; i < argc; i++) {
-                if (strcmp(argv[i], "-row-major") == 0) {
-                        SET_METHODS(uarray2_methods_plain, map_row_major, 
-                                    "row-major");
-                } else if (strcmp(argv[i], "-col-major") == 0) {
-                        SET_METHODS(uarray2_methods_plain, map_col_major, 
-                                    "column-major");
-                } else if (strcmp(argv[i], "-block-major") == 0) {
+        if (opts->threads > 1)
+                pool = shared != NULL ? shared
+                                      : Parallel_new(opts->threads);
+        if (pool != shared)
+                hold(pool, release_pool);
+
+        timer = CPUTime_New();
+        hold(timer, release_timer);
+        CPUTime_Start(timer);
+        double pixels = Fused_transform(fp, &header, out, op, pool);
+        double time = CPUTime_Stop(timer);
+
+        if (opts->time_file_name != NULL)
+                time_output(time, opts, pixels);
+
+        let_go(timer);
+        let_go(pool);
+        if (pool != NULL && pool != shared)
+                Parallel_free(&pool);
+        CPUTime_Free(&timer);
+}
+
+
+/********** right_angle_op ********
+ *
+ *      the libppmtrans operation for a rotation by a multiple of 90
+ *      degrees, a flip or a transpose
+ *
+ ******************************/
+static Ppmtrans_op right_angle_op(struct options *opts)
+{
+        if (opts->rotation >= 0)
+                return PPMTRANS_ROTATE_0 + opts->rotation / 90;
+        if (opts->direction == NULL)
+                return PPMTRANS_TRANSPOSE;
+        if (strcmp(opts->direction, "horizontal") == 0)
+                return PPMTRANS_FLIP_HORIZONTAL;
+        return PPMTRANS_FLIP_VERTICAL;
+}
+
+/********** ppmtrans_incremental ********
+ *
+ *      transforms every frame of the input, redoing only the tiles of
+ *      the result whose source changed since the frame before
+ *
+ *      Parameters:
+ *              struct options *opts: the transformation and reporting
+ *                      asked for on the command line
+ *              FILE *fp: file pointer to the frames
+ *              FILE *out, Parallel_T shared: as for ppmtrans
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Expects:
+ *              a rotation, flip or transpose (parse_options checks)
+ *
+ *      Notes:
+ *              with -time, the time file gets a line per frame with its
+ *              time and the tiles redone; the tiles redone over all the
+ *              frames are reported on stderr
+ *              only the transformation is timed
+ *      
+ ******************************/
+static void ppmtrans_incremental(struct options *opts, FILE *fp, FILE *out,
+                                 Parallel_T shared)
+{
+        Incremental_T inc = Incremental_new(right_angle_op(opts),
+                                            &opts->hints);
+        CPUTime_T timer = CPUTime_New();
+        FILE *time_file = NULL;
+        Parallel_T pool = NULL;
+        long touched = 0, tiles = 0;
+        int frames = 0;
+
+        hold(inc, release_incremental);
+        hold(timer, release_timer);
+        if (opts->threads > 1)
+                pool = shared != NULL ? shared
+                                      : Parallel_new(opts->threads);
+        if (pool != shared)
+                hold(pool, release_pool);
+        if (opts->time_file_name != NULL) {
+                time_file = fopen(opts->time_file_name, "a");
+                assert(time_file);
+                hold(time_file, release_file);
+        }
+
+        while (Frames_more(fp)) {
+                Pnm_ppm frame = read_input(opts, fp, pool);
+                int n, t;
+
+                CPUTime_Start(timer);
+                Pnm_ppm result = Incremental_next(inc, frame, pool);
+                double time = CPUTime_Stop(timer);
+                int written = P6_write(out, result, pool);
+                assert(written);
+
+                n = Incremental_touched(inc, &t);
+                touched += n;
+                tiles += t;
+                frames++;
+                if (time_file != NULL)
+                        fprintf(time_file, "Frame %d: %d of %d tiles redone "
+                                           "(%.1f%%) in %.0f ns.\n", frames,
+                                n, t, t > 0 ? 100.0 * n / t : 0.0, time);
+        }
+
+        fprintf(stderr, "%d frames: %ld of %ld tiles redone (%.1f%%)\n",
+                frames, touched, tiles,
+                tiles > 0 ? 100.0 * touched / tiles : 0.0);
+
+        let_go(time_file);
+        let_go(pool);
+        let_go(timer);
+        let_go(inc);
+        if (time_file != NULL)
+                fclose(time_file);
+        if (pool != NULL && pool != shared)
+                Parallel_free(&pool);
+        Incremental_free(&inc);
+        CPUTime_Free(&timer);
+}
+
+
+/* what transform_frame needs besides the frame */
+struct frame_job {
+        struct options *opts;
+        Parallel_T pool;
+};
+
+/********** transform_frame ********
+ *
+ *      Frames_work: transforms one frame of -frames
+ *
+ *      Return: 
+ *              the result, or NULL if libppmtrans or scale refused the
+ *              frame
+ *
+ *      Notes:
+ *              a right-angle transformation visiting cells in storage
+ *              order goes into a recycled pixmap and recycles the
+ *              frame; anything else makes its result as ppmtrans does
+ *              runs on the work thread of Frames_run, so a failure is
+ *              returned, not asserted
+ *      
+ ******************************/
+static Pnm_ppm transform_frame(Frames_T frames, Pnm_ppm frame, void *cl)
+{
+        struct frame_job *job = cl;
+        struct options *opts = job->opts;
+        int w, h;
+
+        if (opts->rotation == ROTATE_ANY || opts->scale
+            || opts->convolve != NULL
+            || opts->map != frame->methods->map_default) {
+                if (run_steps(opts, frame, job->pool))
+                        return frame;
+                Frames_recycle(frames, frame);
+                return NULL;
+        }
+
+        Ppmtrans_op op = right_angle_op(opts);
+        Ppmtrans_size(op, frame->width, frame->height, &w, &h);
+        Pnm_ppm result = Frames_result(frames, frame, w, h);
+        int err = Ppmtrans_pixmap(op, frame, result, &opts->hints,
+                                  job->pool);
+        Frames_recycle(frames, frame);
+        if (err != PPMTRANS_OK) {
+                Frames_recycle(frames, result);
+                return NULL;
+        }
+        return result;
+}
+
+/********** ppmtrans_frames ********
+ *
+ *      transforms every frame of the input, reading the next frame and
+ *      writing the one before while each is transformed
+ *
+ *      Parameters:
+ *              struct options *opts: the transformation and reporting
+ *                      asked for on the command line
+ *              FILE *fp: file pointer to the frames
+ *              FILE *out, Parallel_T shared: as for ppmtrans
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              the pool is only used to transform; reading and writing
+ *              are a thread each (see frames.h)
+ *              a frame that cannot be transformed (its reason already
+ *              said) or written quits, once the frames before it are
+ *              out
+ *              reading and writing are part of the timed work, as they
+ *              overlap the transformation, and the time per pixel is
+ *              over the pixels of every frame
+ *      
+ ******************************/
+static void ppmtrans_frames(struct options *opts, FILE *fp, FILE *out,
+                            Parallel_T shared)
+{
+        CPUTime_T timer = CPUTime_New();
+        Parallel_T pool = NULL;
+        double pixels;
+
+        hold(timer, release_timer);
+        if (opts->threads > 1)
+                pool = shared != NULL ? shared
+                                      : Parallel_new(opts->threads);
+        if (pool != shared)
+                hold(pool, release_pool);
+
+        Frames_T frames = Frames_new(opts->methods, opts->block_w,
+                                     opts->block_h, packable(opts));
+        hold(frames, release_frames);
+        struct frame_job job = { opts, pool };
+
+        volatile int n = 0;
+        CPUTime_Start(timer);
+        TRY
+                n = Frames_run(frames, fp, out, transform_frame, &job,
+                               &pixels);
+        EXCEPT(Frames_Failed)
+                fprintf(stderr, "%s\n", Frames_Failed.reason);
+                quit();
+        END_TRY;
+        double time = CPUTime_Stop(timer);
+
+        if (opts->time_file_name != NULL && n > 0)
+                time_output(time, opts, pixels);
+
+        let_go(frames);
+        let_go(pool);
+        let_go(timer);
+        Frames_free(&frames);
+        if (pool != NULL && pool != shared)
+                Parallel_free(&pool);
+        CPUTime_Free(&timer);
+}
+
+
+/********** parse_rotation ********
+ *
+ *      reads the angle given to -rotate, in degrees clockwise
+ *
+ *      Parameters:
+ *              char *arg: the angle as given on the command line
+ *              struct options *opts: where to record the rotation
+ *
+ *      Return: 
+ *              true if arg is a number
+ *
+ *      Notes:
+ *              multiples of 90 degrees (including negative ones) become
+ *              the exact rotations 0, 90, 180 and 270; anything else is
+ *              rotated by resampling
+ *      
+ ******************************/
+static bool parse_rotation(char *arg, struct options *opts)
+{
+        char *endptr;
+        double angle = strtod(arg, &endptr);
+
+        if (endptr == arg || *endptr != '\0' || !isfinite(angle))
+                return false;
+
+        angle = fmod(angle, 360.0);
+        if (angle < 0)
+                angle += 360.0;
+
+        if (angle == 0 || angle == 90 || angle == 180 || angle == 270) {
+                opts->rotation = angle;
+        } else {
+                opts->rotation = ROTATE_ANY;
+                opts->angle = angle;
+        }
+        return true;
+}
+
+
+/********** parse_scale ********
+ *
+ *      reads the size given to -scale, either WxH or a factor
+ *
+ *      Parameters:
+ *              char *arg: the size as given on the command line
+ *              struct options *opts: where to record the size
+ *
+ *      Return: 
+ *              true if arg is two sizes, not both 0, or a positive factor
+ *
+ *      Notes:
+ *              WxH must have at most INT_MAX pixels, as arrays count
+ *              their elements in an int; a size that follows the other
+ *              (a 0) or comes from a factor is checked by scale
+ *      
+ ******************************/
+static bool parse_scale(char *arg, struct options *opts)
+{
+        char *endptr;
+
+        opts->scale = true;
+        opts->factor = 0;
+        if (strchr(arg, 'x') != NULL) {
+                long width = strtol(arg, &endptr, 10);
+                if (endptr == arg || *endptr != 'x')
+                        return false;
+                arg = endptr + 1;
+                long height = strtol(arg, &endptr, 10);
+                if (endptr == arg || *endptr != '\0')
+                        return false;
+                if (width < 0 || height < 0 || width + height == 0
+                    || width > 1 << 20 || height > 1 << 20
+                    || width * height > INT_MAX)
+                        return false;
+                opts->scale_width = width;
+                opts->scale_height = height;
+                return true;
+        }
+
+        opts->factor = strtod(arg, &endptr);
+        return endptr != arg && *endptr == '\0' && isfinite(opts->factor)
+               && opts->factor > 0;
+}
+
+
+/********** parse_crop ********
+ *
+ *      reads the window given to -crop
+ *
+ *      Parameters:
+ *              char *arg: the window as x,y,w,h
+ *              struct options *opts: where to record the window
+ *
+ *      Return: 
+ *              true if arg is four numbers, with x and y not negative
+ *              and w and h positive
+ *      
+ ******************************/
+static bool parse_crop(char *arg, struct options *opts)
+{
+        long v[4];
+
+        for (int k = 0; k < 4; k++) {
+                char *endptr;
+                v[k] = strtol(arg, &endptr, 10);
+                if (endptr == arg || *endptr != (k < 3 ? ',' : '\0'))
+                        return false;
+                if (v[k] < (k < 2 ? 0 : 1) || v[k] > INT_MAX / 2)
+                        return false;
+                arg = endptr + 1;
+        }
+
+        opts->crop = true;
+        opts->crop_x = v[0];
+        opts->crop_y = v[1];
+        opts->crop_w = v[2];
+        opts->crop_h = v[3];
+        return true;
+}
+
+
+/********** parse_block ********
+ *
+ *      reads the block shape given to -block
+ *
+ *      Parameters:
+ *              char *arg: the shape as WxH, columns by rows
+ *              struct options *opts: where to record the shape
+ *
+ *      Return: 
+ *              true if arg is two positive sizes whose block holds at
+ *              most 1 << 24 cells
+ *      
+ ******************************/
+static bool parse_block(char *arg, struct options *opts)
+{
+        char *endptr;
+        long width = strtol(arg, &endptr, 10);
+
+        if (endptr == arg || *endptr != 'x')
+                return false;
+        arg = endptr + 1;
+        long height = strtol(arg, &endptr, 10);
+        if (endptr == arg || *endptr != '\0')
+                return false;
+        if (width < 1 || height < 1 || width > 1 << 24 || height > 1 << 24
+            || width * height > 1 << 24)
+                return false;
+
+        opts->block_w = width;
+        opts->block_h = height;
+        return true;
+}
+
+
+/********** parse_options ********
+ *
+ *      handles command line arguments 
+ *
+ *      Parameters:
+ *              int argc: the number of arguments given to the command line
+ *              char *argv[]: an array of the arguments given to the command
+ *                            line
+ *              struct options *result: filled in with what they ask for
+ *
+ *      Return: 
+ *              the index of the file name, or argc if there is none
+ *
+ *      Expects:
+ *              nothing
+ *
+ *      Notes:
+ *              a bad command line prints the usage and quits
+ *              added command line handing for transpose, flip and rotating 270
+ *              functions
+ *              -blocksize, -block and -cachesim are for studying
+ *              locality; -block WxH gives blocks of W columns by H rows,
+ *              and -cachesim only works in the ppmtrans_sim build
+ *              -hier-major keeps the image in blocks inside tiles (see
+ *              uarray2h.h); -blocksize and -block then set the blocks
+ *              -compressed keeps the image in compressed blocks (see
+ *              uarray2c.h), and with -time reports the memory they take
+ *              -rotate takes any angle; -interp picks how angles other
+ *              than multiples of 90 are resampled
+ *              -scale resizes the result of the other transformation,
+ *              filtered as -scale-filter says
+ *              -crop reads only a window of the image, which the other
+ *              transformations then work on
+ *              -pyramid writes deep-zoom tiles of the result instead of
+ *              the image; -tile sets their size
+ *              -filter convolves the image with a kernel read from a
+ *              file (see convolve.h) before the other transformations
+ *              -fused does a rotation, flip or transpose of a P6 file
+ *              without building an A2Methods array (see fused.h)
+ *              -incremental reads frames until the input ends, and
+ *              redoes each only where it differs from the one before
+ *              (see incremental.h)
+ *              -frames reads frames until the input ends, and reads,
+ *              transforms and writes them on three threads at once
+ *              (see frames.h)
+ *              -prefetch n prefetches the source n elements ahead in
+ *              right-angle transformations, and -stream writes their
+ *              result with non-temporal stores
+ *              -numa pins threads and spreads arrays over NUMA nodes,
+ *              the machine's or a simulated number (see numa.h), and
+ *              reports where they went
+ *      
+ ******************************/
+static int parse_options(int argc, char *argv[], struct options *result)
+{
+        struct options opts = {
+                .methods        = uarray2_methods_plain,  /* UArray2 */
+                .order          = "column-major",
+                .rotation       = 0,
+                .filter         = RESAMPLE_BILINEAR,
+                .direction      = NULL,
+                .scale          = false,
+                .kernel         = RESAMPLE_TRIANGLE,
+                .crop           = false,
+                .pyramid_dir    = NULL,
+                .tile           = 256,
+                .convolve       = NULL,
+                .fused          = false,
+                .incremental    = false,
+                .frames         = false,
+                .time_file_name = NULL,
+                .block_w        = 0,
+                .block_h        = 0,
+                .threads        = 1,
+                .hints          = { 0, false },
+                .numa           = -1,
+                .sim            = NULL,
+        };
+        int i;
+
+        assert(opts.methods != NULL);
+
+        /* default to best map */
+        opts.map = opts.methods->map_default; 
+        assert(opts.map != NULL);
+
+        for (i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-row-major") == 0) {
+                        SET_METHODS(uarray2_methods_plain, map_row_major, 
+                                    "row-major");
+                } else if (strcmp(argv[i], "-col-major") == 0) {
+                        SET_METHODS(uarray2_methods_plain, map_col_major, 
+                                    "column-major");
+                } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-hier-major") == 0) {
+                        SET_METHODS(uarray2_methods_hier, map_block_major,
+                                    "hier-major");
+                } else if (strcmp(argv[i], "-compressed") == 0) {
+                        SET_METHODS(uarray2_methods_compressed,
+                                    map_block_major, "compressed");
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
-                        char *endptr;
-                        rotation = strtol(argv[++i], &endptr, 10);
-                        if (!(rotation == 0 || rotation == 90 ||
-                            rotation == 180 || rotation == 270)) {
-                                fprintf(stderr, 
-                                        "Rotation must be 0, 90 180 or 270\n");
+                        if (!parse_rotation(argv[++i], &opts)) {
+                                fprintf(stderr, "Rotation must be a number "
+                                                "of degrees\n");
                                 usage(argv[0]);
                         }
-                        if (!(*endptr == '\0')) {    /* Not a number */
+                } else if (strcmp(argv[i], "-interp") == 0) {
+                        if (!(i + 1 < argc)) {      /* no filter */
+                                usage(argv[0]);
+                        }
+                        char *name = argv[++i];
+                        if (strcmp(name, "nearest") == 0) {
+                                opts.filter = RESAMPLE_NEAREST;
+                        } else if (strcmp(name, "bilinear") == 0) {
+                                opts.filter = RESAMPLE_BILINEAR;
+                        } else if (strcmp(name, "bicubic") == 0) {
+                                opts.filter = RESAMPLE_BICUBIC;
+                        } else {
+                                fprintf(stderr, "Interpolation must be "
+                                        "nearest, bilinear or bicubic\n");
                                 usage(argv[0]);
                         }
                         
+                } else if (strcmp(argv[i], "-scale") == 0) {
+                        if (!(i + 1 < argc)) {      /* no size */
+                                usage(argv[0]);
+                        }
+                        if (!parse_scale(argv[++i], &opts)) {
+                                fprintf(stderr, "Scale must be WxH, at most "
+                                                "%d pixels, or a positive "
+                                                "factor\n", INT_MAX);
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-scale-filter") == 0) {
+                        if (!(i + 1 < argc)) {      /* no filter */
+                                usage(argv[0]);
+                        }
+                        char *name = argv[++i];
+                        if (strcmp(name, "box") == 0) {
+                                opts.kernel = RESAMPLE_BOX;
+                        } else if (strcmp(name, "triangle") == 0) {
+                                opts.kernel = RESAMPLE_TRIANGLE;
+                        } else if (strcmp(name, "lanczos") == 0) {
+                                opts.kernel = RESAMPLE_LANCZOS;
+                        } else {
+                                fprintf(stderr, "Scale filter must be "
+                                        "box, triangle or lanczos\n");
+                                usage(argv[0]);
+                        }
+
+                } else if (strcmp(argv[i], "-crop") == 0) {
+                        if (!(i + 1 < argc)) {      /* no window */
+                                usage(argv[0]);
+                        }
+                        if (!parse_crop(argv[++i], &opts)) {
+                                fprintf(stderr, "Crop must be x,y,w,h\n");
+                                usage(argv[0]);
+                        }
+
+                } else if (strcmp(argv[i], "-pyramid") == 0) {
+                        if (!(i + 1 < argc)) {      /* no directory */
+                                usage(argv[0]);
+                        }
+                        opts.pyramid_dir = argv[++i];
+                } else if (strcmp(argv[i], "-tile") == 0) {
+                        if (!(i + 1 < argc)) {      /* no tile size */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        opts.tile = strtol(argv[++i], &endptr, 10);
+                        if (opts.tile < 2 || opts.tile % 2 != 0
+                            || opts.tile > 1 << 15 || *endptr != '\0') {
+                                fprintf(stderr, "Tile must be even and "
+                                                "at least 2\n");
+                                usage(argv[0]);
+                        }
+
+                } else if (strcmp(argv[i], "-fused") == 0) {
+                        opts.fused = true;
+                } else if (strcmp(argv[i], "-incremental") == 0) {
+                        opts.incremental = true;
+                } else if (strcmp(argv[i], "-frames") == 0) {
+                        opts.frames = true;
+                } else if (strcmp(argv[i], "-filter") == 0) {
+                        if (!(i + 1 < argc)) {      /* no kernel file */
+                                usage(argv[0]);
+                        }
+                        FILE *kfp = open_or_abort(argv[++i], "r");
+                        if (opts.convolve != NULL) {
+                                let_go(opts.convolve);
+                                Convolve_free(&opts.convolve);
+                        }
+                        hold(kfp, release_file);
+                        opts.convolve = Convolve_read(kfp);
+                        let_go(kfp);
+                        fclose(kfp);
+                        hold(opts.convolve, release_kernel);
+                        if (opts.convolve == NULL) {
+                                fprintf(stderr, "Bad kernel file '%s'\n",
+                                        argv[i]);
+                                usage(argv[0]);
+                        }
+
                 /* check for flip command line and horizontal or vertical */
                 } else if (strcmp(argv[i], "-flip") == 0) {
                         if (!(i + 1 < argc)) {      /* no flip value */
                                 usage(argv[0]);
                         }
-                        direction = argv[++i];
-                        if (!(strcmp(direction, "horizontal") == 0 || 
-                                        strcmp(direction, "vertical") == 0)) {
+                        opts.direction = argv[++i];
+                        if (!(strcmp(opts.direction, "horizontal") == 0 || 
+                                strcmp(opts.direction, "vertical") == 0)) {
                                 fprintf(stderr, 
                                 "Flip must be 'horizontal' or 'vertical'\n");
                                 usage(argv[0]);
                         }
-                        rotation = -1;
+                        opts.rotation = -1;
                         
                 /* check for transpose command line */
                 } else if (strcmp(argv[i], "-transpose") == 0) {
-                        rotation = -1;
+                        opts.rotation = -1;
                 } else if (strcmp(argv[i], "-time") == 0) {
                         if (!(i + 1 < argc)) {      /* no time file */
                                 usage(argv[0]);
                         }
-                        time_file_name = argv[++i];
+                        opts.time_file_name = argv[++i];
+                } else if (strcmp(argv[i], "-blocksize") == 0) {
+                        if (!(i + 1 < argc)) {      /* no blocksize */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        opts.block_w = strtol(argv[++i], &endptr, 10);
+                        if (opts.block_w < 1 || *endptr != '\0') {
+                                fprintf(stderr, 
+                                        "Blocksize must be positive\n");
+                                usage(argv[0]);
+                        }
+                        opts.block_h = opts.block_w;
+                } else if (strcmp(argv[i], "-block") == 0) {
+                        if (!(i + 1 < argc)) {      /* no block shape */
+                                usage(argv[0]);
+                        }
+                        if (!parse_block(argv[++i], &opts)) {
+                                fprintf(stderr, "Block must be WxH, "
+                                        "both positive\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no thread count */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        opts.threads = strtol(argv[++i], &endptr, 10);
+                        if (opts.threads < 1 || *endptr != '\0') {
+                                fprintf(stderr, 
+                                        "Threads must be positive\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-prefetch") == 0) {
+                        if (!(i + 1 < argc)) {      /* no distance */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        long ahead = strtol(argv[++i], &endptr, 10);
+                        if (ahead < 0 || ahead > PPMTRANS_PREFETCH_MAX
+                            || *endptr != '\0') {
+                                fprintf(stderr, "Prefetch distance must be "
+                                                "0 to %d\n",
+                                        PPMTRANS_PREFETCH_MAX);
+                                usage(argv[0]);
+                        }
+                        opts.hints.prefetch = ahead;
+                } else if (strcmp(argv[i], "-stream") == 0) {
+                        opts.hints.stream = true;
+                } else if (strcmp(argv[i], "-numa") == 0) {
+                        if (!(i + 1 < argc)) {      /* no node count */
+                                usage(argv[0]);
+                        }
+                        i++;
+                        if (strcmp(argv[i], "auto") == 0) {
+                                opts.numa = 0;
+                        } else {
+                                char *endptr;
+                                opts.numa = strtol(argv[i], &endptr, 10);
+                                if (opts.numa < 1 || opts.numa > 64
+                                    || *endptr != '\0') {
+                                        fprintf(stderr, "-numa takes auto "
+                                                "or 1 to 64 nodes\n");
+                                        usage(argv[0]);
+                                }
+                        }
+                } else if (strcmp(argv[i], "-cachesim") == 0) {
+                        if (!(i + 1 < argc)) {      /* no cache geometry */
+                                usage(argv[0]);
+                        }
+                        i++;
+#ifdef CACHESIM
+                        if (opts.sim != NULL) {
+                                let_go(opts.sim);
+                                CacheSim_Free(&opts.sim);
+                        }
+                        opts.sim = CacheSim_New(argv[i]);
+                        hold(opts.sim, release_sim);
+                        if (opts.sim == NULL) {
+                                fprintf(stderr, "Bad cache geometry '%s'\n",
+                                        argv[i]);
+                                usage(argv[0]);
+                        }
+#else
+                        fprintf(stderr, "%s: built without cache simulation,"
+                                        " use ppmtrans_sim\n", argv[0]);
+                        quit();
+#endif
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
                                 argv[i]);
@@ -499,15 +1814,221 @@ int main(int argc, char *argv[])
                 }
         }
 
+        /* the simulator follows one address stream */
+        if (opts.sim != NULL && opts.threads > 1) {
+                fprintf(stderr, "-cachesim needs a single thread\n");
+                usage(argv[0]);
+        }
+
+        /* even reading a compressed array changes its cache */
+        if (opts.methods == uarray2_methods_compressed && opts.threads > 1) {
+                fprintf(stderr, "-compressed needs a single thread\n");
+                usage(argv[0]);
+        }
+
+        /* the fused mode only moves pixels */
+        if (opts.fused && (opts.rotation == ROTATE_ANY || opts.scale
+                           || opts.crop || opts.pyramid_dir != NULL
+                           || opts.convolve != NULL || opts.sim != NULL
+                           || opts.numa >= 0)) {
+                fprintf(stderr, "-fused only does -rotate 0, 90, 180 or "
+                                "270, -flip and -transpose\n");
+                usage(argv[0]);
+        }
+
+        /* as must incremental mode, which also needs an array */
+        if (opts.incremental && (opts.rotation == ROTATE_ANY || opts.scale
+                                 || opts.crop || opts.pyramid_dir != NULL
+                                 || opts.convolve != NULL || opts.fused
+                                 || opts.sim != NULL || opts.numa >= 0)) {
+                fprintf(stderr, "-incremental only does -rotate 0, 90, 180 "
+                                "or 270, -flip and -transpose\n");
+                usage(argv[0]);
+        }
+
+        /* frame streams write every result, from threads of their own */
+        if (opts.frames && (opts.crop || opts.pyramid_dir != NULL
+                            || opts.fused || opts.incremental
+                            || opts.sim != NULL || opts.numa >= 0)) {
+                fprintf(stderr, "-frames does not go with -crop, -pyramid, "
+                                "-fused, -incremental, -cachesim or "
+                                "-numa\n");
+                usage(argv[0]);
+        }
+
+        *result = opts;
+        return i;
+}
+
+
+/********** run_command ********
+ *
+ *      runs a whole ppmtrans command line
+ *
+ *      Parameters:
+ *              int argc, char *argv[]: the command line
+ *              FILE *in: the image when the command line names none
+ *              FILE *out: where the image goes
+ *              Parallel_T shared: threads to use instead of starting
+ *                      new ones, or NULL
+ *
+ *      Return: 
+ *              nothing
+ *      
+ ******************************/
+static void run_command(int argc, char *argv[], FILE *in, FILE *out,
+                        Parallel_T shared)
+{
+        struct options opts;
+        int i = parse_options(argc, argv, &opts);
+
+        void (*run)(struct options *, FILE *, FILE *, Parallel_T) =
+                opts.fused ? ppmtrans_fused
+                           : opts.incremental ? ppmtrans_incremental
+                           : opts.frames ? ppmtrans_frames
+                                         : ppmtrans;
         if (argc == i) {
-                ppmtrans(methods, rotation, time_file_name, stdin, 
-                                                        direction, map);
+                run(&opts, in, out, shared);
         } else {
                 FILE *fp = open_or_abort(argv[i], "rb");
-                ppmtrans(methods, rotation, time_file_name, fp, 
-                                                        direction, map);
+                hold(fp, release_file);
+                run(&opts, fp, out, shared);
+                let_go(fp);
                 fclose(fp);
         }
 
+        let_go(opts.sim);
+        let_go(opts.convolve);
+        if (opts.sim != NULL)
+                CacheSim_Free(&opts.sim);
+        if (opts.convolve != NULL)
+                Convolve_free(&opts.convolve);
+}
+
+
+/********** serve_request ********
+ *
+ *      Serve_handler: runs a command line sent by a --client, on the
+ *      server's threads
+ *
+ *      Return: 
+ *              the exit status for the client: 0, or 1 if the command
+ *              line was bad or a checked runtime error stopped it
+ *
+ *      Notes:
+ *              -numa is refused, as it would pin the shared threads for
+ *                      every request after it
+ *              a request stopped part way has what it still held (see
+ *                      hold) freed, and the cache simulator detached
+ *              only this thread raises: the work handed to the pool's
+ *                      threads notes failures for the thread that
+ *                      started it to raise once they are done
+ *      
+ ******************************/
+static int serve_request(int argc, char *argv[], FILE *in, FILE *out,
+                         void *cl)
+{
+        volatile int status = 0;
+
+        serving = true;
+        TRY
+                for (int k = 1; k < argc; k++)
+                        if (strcmp(argv[k], "-numa") == 0) {
+                                fprintf(stderr, "%s: -numa is not available "
+                                                "when serving\n", argv[0]);
+                                RAISE(Request_Failed);
+                        }
+                run_command(argc, argv, in, out, cl);
+                if (fflush(out) != 0)
+                        status = 1;
+        ELSE
+                if (Except_frame.exception != &Request_Failed)
+                        fprintf(stderr, "%s: %s\n", argv[0],
+                                Except_frame.exception->reason);
+                CacheSim_Detach();
+                release_held();
+                status = 1;
+        END_TRY;
+        serving = false;
+        return status;
+}
+
+
+/********** serve ********
+ *
+ *      runs ppmtrans --serve socket [-threads n]
+ *
+ *      Return: 
+ *              exit code
+ *
+ *      Notes:
+ *              one pool of threads, n of them or one per processor,
+ *              is started up front and lent to every request that asks
+ *              for more than one thread
+ *              freed memory is kept in the heap rather than handed back
+ *              to the system, so the large arrays of one request are
+ *              reused, already mapped, by the next
+ *      
+ ******************************/
+static int serve(int argc, char *argv[])
+{
+        long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (argc == 5 && strcmp(argv[3], "-threads") == 0) {
+                char *endptr;
+                threads = strtol(argv[4], &endptr, 10);
+                if (threads < 1 || *endptr != '\0')
+                        usage(argv[0]);
+        } else if (argc != 3) {
+                usage(argv[0]);
+        }
+
+#ifdef M_MMAP_THRESHOLD
+        mallopt(M_MMAP_THRESHOLD, INT_MAX);
+        mallopt(M_TRIM_THRESHOLD, INT_MAX);
+#endif
+        Parallel_T pool = threads > 1 ? Parallel_new(threads) : NULL;
+        int status = Serve_run(argv[2], serve_request, pool);
+        if (pool != NULL)
+                Parallel_free(&pool);
+        return status;
+}
+
+
+/********** main ********
+ *
+ *      runs one command line, or serves them, or sends one to a server
+ *
+ *      Parameters:
+ *              int argc: the number of arguments given to the command line
+ *              char *argv[]: an array of the arguments given to the command
+ *                            line
+ *
+ *      Return: 
+ *              exit code
+ *
+ *      Notes:
+ *              --serve socket starts a server (see serve.h) that runs
+ *              command lines sent with --client socket, which takes the
+ *              same options as ppmtrans and behaves like it, or
+ *              --stats for the server's latency histogram, or --stop
+ *      
+ ******************************/
+int main(int argc, char *argv[])
+{
+        if (argc >= 2 && strcmp(argv[1], "--serve") == 0)
+                return serve(argc, argv);
+
+        if (argc >= 2 && strcmp(argv[1], "--client") == 0) {
+                if (argc < 3)
+                        usage(argv[0]);
+
+                /* the request is the command line without the socket */
+                char *path = argv[2];
+                argv[2] = argv[0];
+                return Serve_client(path, argc - 2, argv + 2);
+        }
+
+        run_command(argc, argv, stdin, stdout, NULL);
         return 0;
 }
@@ -0,0 +1,409 @@
+/*
+ *      pyramid.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the tile pyramid in pyramid.h. Tiles are
+ *              held as rows of 16-bit red, green, blue samples, tile
+ *              pixels apart. The tiles of one level (the split) are
+ *              shared out over the threads; each is built depth first
+ *              from the image, written, and then averaged down into its
+ *              quarter of its parent, so every parent is whole once the
+ *              threads are done. The few levels above the split are then
+ *              built on one thread from those parents.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "pyramid.h"
+
+typedef unsigned short sample;
+
+struct pyramid_job {
+        Pnm_ppm src;
+        A2Methods_CursorT cursors;
+        int vertical;                   /* src stored a column at a time */
+        const char *dir;
+        int tile;
+        int top;                        /* level of the full image */
+        int *width, *height;            /* of each level */
+        int split;                      /* level built in parallel */
+        sample **parents;               /* tiles of level split - 1,
+                                           column by column */
+        int parents_down;
+        int assembled;                  /* the parents are whole */
+        sample ***scratch;              /* per thread, per level */
+        unsigned maxval;
+        int failed;                     /* a tile could not be written */
+};
+
+
+static int tiles_across(struct pyramid_job *job, int level)
+{
+        return (job->width[level] + job->tile - 1) / job->tile;
+}
+
+static int tiles_down(struct pyramid_job *job, int level)
+{
+        return (job->height[level] + job->tile - 1) / job->tile;
+}
+
+static sample *new_tile(struct pyramid_job *job)
+{
+        sample *t = malloc((size_t)job->tile * job->tile * 3 * sizeof(*t));
+        assert(t != NULL);
+        return t;
+}
+
+/* a thread's buffer for a tile at level; those the pool's threads use
+   are made before they start, so only the calling thread allocates */
+static sample *scratch(struct pyramid_job *job, int thread, int level)
+{
+        sample **s = &job->scratch[thread][level];
+
+        if (*s == NULL)
+                *s = new_tile(job);
+        return *s;
+}
+
+/********** load_tile ********
+ *
+ *      copies the tw x th pixels of the image at (x0, y0) into out
+ *
+ *      Notes:
+ *              the image is read in runs along its storage direction,
+ *              so a tile that is a block of a blocked image is read as
+ *              one stretch of memory
+ *
+ ******************************/
+static void load_tile(struct pyramid_job *job, int x0, int y0, int tw,
+                      int th, sample *out)
+{
+        int vertical = job->vertical;
+        int lines = vertical ? tw : th;
+        int len = vertical ? th : tw;
+        long step = vertical ? 3L * job->tile : 3;
+
+        for (int k = 0; k < len; ) {
+                int n = 0;
+                for (int l = 0; l < lines; l++) {
+                        int x = vertical ? l : k;
+                        int y = vertical ? k : l;
+                        A2Methods_Run run;
+                        n = job->cursors->run_at(job->src->pixels, x0 + x,
+                                                 y0 + y, !vertical, vertical,
+                                                 len - k, &run);
+                        const char *p = run.elem;
+                        sample *o = out + 3 * ((long)y * job->tile + x);
+
+                        for (int i = 0; i < n; i++, p += run.stride,
+                                                  o += step) {
+                                const struct Pnm_rgb *px = (const void *)p;
+                                o[0] = px->red;
+                                o[1] = px->green;
+                                o[2] = px->blue;
+                        }
+                }
+                k += n;
+        }
+}
+
+/********** shrink ********
+ *
+ *      averages each 2x2 square of a cw x ch tile into one pixel of
+ *      out, which is a quarter of another tile
+ *
+ *      Notes:
+ *              a square cut off by the tile's right or bottom edge
+ *              averages the pixels it has, by repeating the last
+ *              column or row
+ *
+ ******************************/
+static void shrink(int tile, const sample *in, int cw, int ch, sample *out)
+{
+        int pitch = 3 * tile;
+
+        for (int oy = 0; oy < (ch + 1) / 2; oy++) {
+                const sample *r0 = in + (long)(2 * oy) * pitch;
+                const sample *r1 = 2 * oy + 1 < ch ? r0 + pitch : r0;
+                sample *o = out + (long)oy * pitch;
+
+                for (int ox = 0; ox < (cw + 1) / 2; ox++) {
+                        int a = 6 * ox;
+                        int b = 2 * ox + 1 < cw ? a + 3 : a;
+                        for (int c = 0; c < 3; c++)
+                                o[3 * ox + c] = (r0[a + c] + r0[b + c]
+                                                 + r1[a + c] + r1[b + c]
+                                                 + 2) >> 2;
+                }
+        }
+}
+
+/********** write_tile ********
+ *
+ *      writes the tw x th tile in t as dir/level/tx_ty.ppm
+ *
+ *      Notes:
+ *              runs on the pool's threads, so a file that cannot be
+ *              made or written only sets job->failed, for Pyramid_write
+ *              to report once the threads are done
+ *
+ ******************************/
+static void write_tile(struct pyramid_job *job, int level, int tx, int ty,
+                       const sample *t, int tw, int th)
+{
+        char name[4096];
+        snprintf(name, sizeof(name), "%s/%d/%d_%d.ppm", job->dir, level, tx,
+                 ty);
+        int bytes = job->maxval > 255 ? 2 : 1;
+        size_t rowbytes = (size_t)tw * 3 * bytes;
+        unsigned char *buf = malloc(rowbytes * th);
+        unsigned char *b = buf;
+        FILE *fp = buf != NULL ? fopen(name, "wb") : NULL;
+
+        if (fp == NULL) {
+                free(buf);
+                __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+                return;
+        }
+
+        for (int y = 0; y < th; y++) {
+                const sample *s = t + 3L * y * job->tile;
+                if (bytes == 1) {
+                        for (int k = 0; k < 3 * tw; k++)
+                                *b++ = s[k];
+                } else {
+                        for (int k = 0; k < 3 * tw; k++) {
+                                *b++ = s[k] >> 8;
+                                *b++ = s[k];
+                        }
+                }
+        }
+
+        fprintf(fp, "P6\n%d %d\n%u\n", tw, th, job->maxval);
+        size_t n = fwrite(buf, 1, rowbytes * th, fp);
+        int err = fclose(fp);
+        if (n != rowbytes * th || err != 0)
+                __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        free(buf);
+}
+
+/********** build ********
+ *
+ *      makes and writes tile (tx, ty) of a level, building its
+ *      children first
+ *
+ *      Return:
+ *              the tile, in a buffer that stays good until the next
+ *              build of a tile at the same level on this thread
+ *
+ ******************************/
+static const sample *build(struct pyramid_job *job, int thread, int level,
+                           int tx, int ty)
+{
+        int T = job->tile;
+        int tw = job->width[level] - tx * T < T ? job->width[level] - tx * T
+                                                 : T;
+        int th = job->height[level] - ty * T < T ? job->height[level] - ty * T
+                                                  : T;
+        sample *out;
+
+        if (level == job->top) {
+                out = scratch(job, thread, level);
+                load_tile(job, tx * T, ty * T, tw, th, out);
+        } else if (level == job->split - 1 && job->assembled) {
+                out = job->parents[tx * job->parents_down + ty];
+        } else {
+                out = scratch(job, thread, level);
+                for (int q = 0; q < 4; q++) {
+                        int cx = 2 * tx + (q & 1);
+                        int cy = 2 * ty + (q >> 1);
+                        if (cx * T >= job->width[level + 1]
+                            || cy * T >= job->height[level + 1])
+                                continue;
+
+                        const sample *child = build(job, thread, level + 1,
+                                                    cx, cy);
+                        int cw = job->width[level + 1] - cx * T;
+                        int ch = job->height[level + 1] - cy * T;
+                        shrink(T, child, cw < T ? cw : T, ch < T ? ch : T,
+                               out + 3 * ((q >> 1) * (T / 2) * T
+                                          + (q & 1) * (T / 2)));
+                }
+        }
+
+        write_tile(job, level, tx, ty, out, tw, th);
+        return out;
+}
+
+/********** build_split ********
+ *
+ *      Parallel_work function: builds tile number item of the split
+ *      level, numbered column by column, and its quarter of its parent
+ *
+ ******************************/
+static void build_split(int item, int thread, void *cl)
+{
+        struct pyramid_job *job = cl;
+        int down = tiles_down(job, job->split);
+        int tx = item / down;
+        int ty = item % down;
+        int T = job->tile;
+        const sample *t = build(job, thread, job->split, tx, ty);
+
+        if (job->split == 0)
+                return;
+
+        int cw = job->width[job->split] - tx * T;
+        int ch = job->height[job->split] - ty * T;
+        sample *parent = job->parents[(tx / 2) * job->parents_down + ty / 2];
+        shrink(T, t, cw < T ? cw : T, ch < T ? ch : T,
+               parent + 3 * ((ty & 1) * (T / 2) * T + (tx & 1) * (T / 2)));
+}
+
+static void make_dir(const char *name)
+{
+        int made = mkdir(name, 0777) == 0 || errno == EEXIST;
+        assert(made);
+}
+
+static void write_descriptor(struct pyramid_job *job)
+{
+        char name[4096];
+        snprintf(name, sizeof(name), "%s/pyramid.dzi", job->dir);
+        FILE *fp = fopen(name, "w");
+        if (fp == NULL) {
+                job->failed = 1;
+                return;
+        }
+
+        fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/"
+                    "2008\"\n       TileSize=\"%d\" Overlap=\"0\" "
+                    "Format=\"ppm\">\n"
+                    "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                    "</Image>\n",
+                job->tile, job->width[job->top], job->height[job->top]);
+        if (fclose(fp) != 0)
+                job->failed = 1;
+}
+
+/********** Pyramid_write ********
+ *
+ *      writes the tile pyramid of an image
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the image
+ *              const char *dir: where to put the pyramid
+ *              int tile: the tile edge, even
+ *              Parallel_T pool: threads to share the tiles, or NULL
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              the split is the first level with at least four tiles
+ *              per thread, or the top level if none has that many
+ *
+ ******************************/
+void Pyramid_write(Pnm_ppm pixmap, const char *dir, int tile,
+                   Parallel_T pool)
+{
+        assert(pixmap != NULL && dir != NULL);
+        assert(tile >= 2 && tile % 2 == 0);
+        assert(pixmap->methods->size(pixmap->pixels)
+               == sizeof(struct Pnm_rgb));
+
+        struct pyramid_job job;
+        job.src = pixmap;
+        job.cursors = A2Methods_cursor(pixmap->methods);
+        assert(job.cursors != NULL);
+        job.dir = dir;
+        job.tile = tile;
+        job.maxval = pixmap->denominator;
+        job.failed = 0;
+
+        job.vertical = A2Methods_by_column(job.cursors, pixmap->pixels);
+
+        /* level sizes, from the full image down to 1x1 */
+        int w = pixmap->width;
+        int h = pixmap->height;
+        job.top = 0;
+        while ((1L << job.top) < w || (1L << job.top) < h)
+                job.top++;
+        job.width = malloc((job.top + 1) * sizeof(int));
+        job.height = malloc((job.top + 1) * sizeof(int));
+        assert(job.width != NULL && job.height != NULL);
+        for (int level = job.top; level >= 0; level--) {
+                job.width[level] = w;
+                job.height[level] = h;
+                w = (w + 1) / 2;
+                h = (h + 1) / 2;
+        }
+
+        make_dir(dir);
+        for (int level = 0; level <= job.top; level++) {
+                char name[4096];
+                snprintf(name, sizeof(name), "%s/%d", dir, level);
+                make_dir(name);
+        }
+
+        int nthreads = Parallel_threads(pool);
+        job.split = 0;
+        while (job.split < job.top && tiles_across(&job, job.split)
+                                      * tiles_down(&job, job.split)
+                                      < 4 * nthreads)
+                job.split++;
+
+        int nparents = 0;
+        job.parents = NULL;
+        job.parents_down = 0;
+        job.assembled = 0;
+        if (job.split > 0) {
+                job.parents_down = tiles_down(&job, job.split - 1);
+                nparents = tiles_across(&job, job.split - 1)
+                           * job.parents_down;
+                job.parents = malloc(nparents * sizeof(*job.parents));
+                assert(job.parents != NULL);
+                for (int i = 0; i < nparents; i++)
+                        job.parents[i] = new_tile(&job);
+        }
+
+        job.scratch = malloc(nthreads * sizeof(*job.scratch));
+        assert(job.scratch != NULL);
+        for (int t = 0; t < nthreads; t++) {
+                job.scratch[t] = calloc(job.top + 1, sizeof(sample *));
+                assert(job.scratch[t] != NULL);
+                for (int level = job.split; level <= job.top; level++)
+                        job.scratch[t][level] = new_tile(&job);
+        }
+
+        Parallel_for(pool, tiles_across(&job, job.split)
+                           * tiles_down(&job, job.split), build_split, &job);
+        if (job.split > 0) {
+                job.assembled = 1;
+                build(&job, 0, 0, 0, 0);
+        }
+        write_descriptor(&job);
+
+        for (int t = 0; t < nthreads; t++) {
+                for (int level = 0; level <= job.top; level++)
+                        free(job.scratch[t][level]);
+                free(job.scratch[t]);
+        }
+        free(job.scratch);
+        for (int i = 0; i < nparents; i++)
+                free(job.parents[i]);
+        free(job.parents);
+        free(job.width);
+        free(job.height);
+        assert(!job.failed);
+}
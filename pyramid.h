@@ -0,0 +1,37 @@
+#ifndef PYRAMID_INCLUDED
+#define PYRAMID_INCLUDED
+/*
+ *      pyramid.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              writes a deep-zoom tile pyramid of an image: level top is
+ *              the image itself, each level below it is half the size
+ *              (rounding up) of the one above, down to level 0 at 1x1,
+ *              and every level is cut into tile x tile pieces. The
+ *              pyramid is built as a quadtree in one pass over the image:
+ *              a tile is made by 2x2 averaging of its four children as
+ *              soon as they are done, while they are still in cache.
+ *
+ *              The files are laid out as Deep Zoom expects, with ppm
+ *              tiles:
+ *
+ *                      dir/pyramid.dzi                 the descriptor
+ *                      dir/<level>/<col>_<row>.ppm     the tiles
+ *
+ */
+
+#include "pnm.h"
+#include "parallel.h"
+
+/* writes the pyramid of pixmap, which must hold Pnm_rgb pixels and
+   have cursors (see a2cursor.h), under dir, creating directories as
+   needed; tile must be even.  Failing to create a file is a checked
+   runtime error. */
+extern void Pyramid_write(Pnm_ppm pixmap, const char *dir, int tile,
+                          Parallel_T pool);
+
+#endif
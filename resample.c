@@ -0,0 +1,643 @@
+/*
+ *      resample.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the interpolating transformations in
+ *              resample.h. Pixels are interpolated as 4-lane float
+ *              vectors (red, green, blue, unused), so every tap of a
+ *              filter is one vector multiply-add. Each tile gathers its
+ *              source window into per-thread scratch as such vectors,
+ *              black outside the image, so the filters never need to
+ *              check bounds. Scaling is separable: a horizontal pass over
+ *              strips of rows writes a float image that the vertical pass
+ *              reads one column at a time.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "cachesim.h"
+#include "numa.h"
+#include "vec4.h"
+#include "resample.h"
+
+/* for the per-filter copies of the tile loops */
+#define FILTER_INLINE static inline __attribute__((always_inline))
+
+#define DEFAULT_TILE 64 /* tile edge when the destination is not blocked */
+#define MARGIN 3        /* window border: bicubic reaches 2 pixels past a
+                           sample, plus 1 for rounding as samples step */
+#define STRIP 16        /* source rows per item of the horizontal scale pass */
+
+struct rotate_job {
+        Pnm_ppm src;
+        A2Methods_CursorT cursors;
+        A2Methods_UArray2 dst;
+        int width, height;              /* of the destination */
+        int tile_w, tile_h, tiles_down;
+        double cos, sin;
+        double cx, cy;                  /* source position of dst (0, 0) */
+        Resample_filter filter;
+        float maxval;
+        struct scratch *scratch;        /* one per thread */
+};
+
+struct kernel {
+        double (*weight)(double x);
+        double support;                 /* weight is 0 outside +-support */
+};
+
+/* the source pixels, and their weights, behind each output pixel */
+struct taps {
+        int *first;                     /* first source pixel */
+        int *count;                     /* number of source pixels */
+        float *weights;                 /* max per output pixel */
+        int max;
+};
+
+struct scale_job {
+        Pnm_ppm src;
+        A2Methods_CursorT cursors;
+        A2Methods_UArray2 dst;
+        int width, height;              /* of the destination */
+        struct taps across, down;
+        v4f *mid;                       /* horizontal pass output, width x
+                                           source height, column by column */
+        int src_vertical, dst_vertical; /* stored a column at a time */
+        int tile_w, tile_h, tiles_down; /* of the vertical pass */
+        float maxval;
+        struct scratch *scratch;        /* one per thread */
+};
+
+
+/********** gather ********
+ *
+ *      loads a window of the source, [x0, x0 + ww) x [y0, y0 + wh),
+ *      into win as one float vector per pixel, row by row
+ *
+ *      Notes:
+ *              the window may hang off the image; those pixels are black
+ *
+ ******************************/
+static void gather(Pnm_ppm src, A2Methods_CursorT cursors, int x0, int y0,
+                   int ww, int wh, v4f *win)
+{
+        int lo = x0 < 0 ? 0 : x0;
+        int hi = x0 + ww > (int)src->width ? (int)src->width : x0 + ww;
+
+        for (int r = 0; r < wh; r++) {
+                v4f *out = win + (size_t)r * ww;
+                int y = y0 + r;
+
+                if (y < 0 || y >= (int)src->height || lo >= hi) {
+                        memset(out, 0, ww * sizeof(*out));
+                        continue;
+                }
+                memset(out, 0, (lo - x0) * sizeof(*out));
+                memset(out + (hi - x0), 0, (x0 + ww - hi) * sizeof(*out));
+
+                for (int x = lo; x < hi; ) {
+                        A2Methods_Run run;
+                        int n = cursors->run_at(src->pixels, x, y, 1, 0,
+                                                hi - x, &run);
+                        const char *p = run.elem;
+                        v4f *o = out + (x - x0);
+
+                        for (int k = 0; k < n; k++, p += run.stride) {
+                                const struct Pnm_rgb *px = (const void *)p;
+                                CACHESIM_TRACE(px, sizeof(*px));
+                                o[k] = (v4f){ px->red, px->green, px->blue,
+                                              0 };
+                        }
+                        x += n;
+                }
+        }
+}
+
+/********** filters ********
+ *
+ *      interpolate the window at (u, v), in pixels from the window's
+ *      first pixel
+ *
+ *      Notes:
+ *              (u, v) is always at least MARGIN - 1 from the window's
+ *              edge, so truncating to int is floor without a libm call
+ *              bicubic is Catmull-Rom (a = -0.5), which passes through
+ *              the source pixels and overshoots a little at edges, hence
+ *              the clamp in store
+ *
+ ******************************/
+FILTER_INLINE v4f sample_nearest(const v4f *win, int ww, double u,
+                                 double v)
+{
+        int x = u + 0.5;
+        int y = v + 0.5;
+
+        return win[(size_t)y * ww + x];
+}
+
+FILTER_INLINE v4f sample_bilinear(const v4f *win, int ww, double u,
+                                  double v)
+{
+        int x = u;
+        int y = v;
+        float tx = u - x;
+        float ty = v - y;
+        const v4f *p = win + (size_t)y * ww + x;
+
+        v4f top = p[0] + (p[1] - p[0]) * tx;
+        v4f bottom = p[ww] + (p[ww + 1] - p[ww]) * tx;
+        return top + (bottom - top) * ty;
+}
+
+FILTER_INLINE void cubic_weights(float t, float w[4])
+{
+        w[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+        w[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+        w[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+        w[3] = (0.5f * t - 0.5f) * t * t;
+}
+
+FILTER_INLINE v4f sample_bicubic(const v4f *win, int ww, double u,
+                                 double v)
+{
+        int x = u;
+        int y = v;
+        float wx[4], wy[4];
+        const v4f *p = win + (size_t)(y - 1) * ww + (x - 1);
+        v4f sum = { 0, 0, 0, 0 };
+
+        cubic_weights(u - x, wx);
+        cubic_weights(v - y, wy);
+        for (int r = 0; r < 4; r++, p += ww)
+                sum += (p[0] * wx[0] + p[1] * wx[1] + p[2] * wx[2]
+                        + p[3] * wx[3]) * wy[r];
+        return sum;
+}
+
+/********** rotate_tile_with ********
+ *
+ *      fills one destination tile, [x0, x0 + tw) x [y0, y0 + th), by
+ *      sampling the gathered window with the given filter
+ *
+ *      Notes:
+ *              inlined once per filter, so the filter is not re-chosen
+ *              for every pixel
+ *              each pixel's source position is worked out from its own
+ *              (x, y) in double, never stepped along a run, and only
+ *              then made relative to the window, so the result does not
+ *              depend on the layout, tile size or thread count
+ *
+ ******************************/
+FILTER_INLINE void rotate_tile_with(struct rotate_job *job, const v4f *win,
+                                    int ww, double wx0, double wy0, int x0,
+                                    int y0, int tw, int th,
+                                    Resample_filter filter)
+{
+        for (int y = y0; y < y0 + th; y++) {
+                for (int x = x0; x < x0 + tw; ) {
+                        A2Methods_Run run;
+                        int n = job->cursors->run_at(job->dst, x, y, 1, 0,
+                                                     x0 + tw - x, &run);
+                        char *p = run.elem;
+
+                        for (int k = 0; k < n; k++, p += run.stride) {
+                                double sx = job->cx + (x + k) * job->cos
+                                            + y * job->sin;
+                                double sy = job->cy - (x + k) * job->sin
+                                            + y * job->cos;
+                                double u = sx - wx0;
+                                double v = sy - wy0;
+                                v4f out;
+                                if (filter == RESAMPLE_NEAREST)
+                                        out = sample_nearest(win, ww, u, v);
+                                else if (filter == RESAMPLE_BILINEAR)
+                                        out = sample_bilinear(win, ww, u, v);
+                                else
+                                        out = sample_bicubic(win, ww, u, v);
+                                store(p, out, job->maxval);
+                        }
+                        x += n;
+                }
+        }
+}
+
+/********** rotate_tile ********
+ *
+ *      Parallel_work function: rotates tile number item
+ *
+ *      Notes:
+ *              tiles are numbered column by column, the order a blocked
+ *              destination stores its blocks
+ *
+ ******************************/
+static void rotate_tile(int item, int thread, void *cl)
+{
+        struct rotate_job *job = cl;
+        int x0 = (item / job->tiles_down) * job->tile_w;
+        int y0 = (item % job->tiles_down) * job->tile_h;
+        int tw = job->width - x0 < job->tile_w ? job->width - x0
+                                             : job->tile_w;
+        int th = job->height - y0 < job->tile_h ? job->height - y0
+                                               : job->tile_h;
+
+        /* the source positions of the tile's corners bound the window */
+        double minx = INFINITY, maxx = -INFINITY;
+        double miny = INFINITY, maxy = -INFINITY;
+        for (int c = 0; c < 4; c++) {
+                double x = x0 + (c & 1 ? tw - 1 : 0);
+                double y = y0 + (c & 2 ? th - 1 : 0);
+                double sx = job->cx + x * job->cos + y * job->sin;
+                double sy = job->cy - x * job->sin + y * job->cos;
+                minx = fmin(minx, sx);
+                maxx = fmax(maxx, sx);
+                miny = fmin(miny, sy);
+                maxy = fmax(maxy, sy);
+        }
+
+        int wx0 = (int)floor(minx) - MARGIN;
+        int wy0 = (int)floor(miny) - MARGIN;
+        int ww = (int)floor(maxx) + MARGIN + 1 - wx0;
+        int wh = (int)floor(maxy) + MARGIN + 1 - wy0;
+        v4f *win = window_for(&job->scratch[thread], (size_t)ww * wh);
+        if (win == NULL)
+                return;
+
+        gather(job->src, job->cursors, wx0, wy0, ww, wh, win);
+
+        switch (job->filter) {
+        case RESAMPLE_NEAREST:
+                rotate_tile_with(job, win, ww, wx0, wy0, x0, y0, tw, th,
+                                 RESAMPLE_NEAREST);
+                break;
+        case RESAMPLE_BILINEAR:
+                rotate_tile_with(job, win, ww, wx0, wy0, x0, y0, tw, th,
+                                 RESAMPLE_BILINEAR);
+                break;
+        default:
+                rotate_tile_with(job, win, ww, wx0, wy0, x0, y0, tw, th,
+                                 RESAMPLE_BICUBIC);
+        }
+}
+
+/********** Resample_rotate ********
+ *
+ *      rotates the image clockwise by any angle
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the pixmap holding the image
+ *              double degrees: the angle to rotate by
+ *              Resample_filter filter: how to interpolate
+ *              Parallel_T pool: threads to share the tiles, or NULL
+ *
+ *      Return:
+ *              1, or 0 if the rotated image would have more than
+ *              INT_MAX pixels, in which case pixmap is left as it was
+ *
+ *      Notes:
+ *              frees the 2D array holding the old image in pixmap
+ *              destination pixel (x, y) samples the source at the point
+ *              that rotates onto its center, about the center of each
+ *              image; at multiples of 90 degrees with the nearest filter
+ *              this reproduces the exact rotations
+ *
+ ******************************/
+int Resample_rotate(Pnm_ppm pixmap, double degrees, Resample_filter filter,
+                    Parallel_T pool)
+{
+        A2Methods_T methods = pixmap->methods;
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        int size = methods->size(pixmap->pixels);
+        int bw, bh;
+
+        assert(cursors != NULL);
+        assert(size == sizeof(struct Pnm_rgb));
+
+        double rad = degrees * M_PI / 180.0;
+        double c = cos(rad);
+        double s = sin(rad);
+        double w = pixmap->width;
+        double h = pixmap->height;
+
+        /* the bounding box of the rotated image, less rounding noise */
+        double wide = ceil(w * fabs(c) + h * fabs(s) - 1e-6);
+        double high = ceil(w * fabs(s) + h * fabs(c) - 1e-6);
+        if (wide * high > INT_MAX)
+                return 0;
+        int width = wide;
+        int height = high;
+
+        struct rotate_job job;
+        job.src = pixmap;
+        job.cursors = cursors;
+        cursors->blockshape(pixmap->pixels, &bw, &bh);
+        job.dst = cursors->new_with_blockshape(width, height, size, bw, bh);
+        Numa_Place(methods, job.dst);
+        job.width = width;
+        job.height = height;
+        job.tile_w = bw * bh > 1 ? bw : DEFAULT_TILE;
+        job.tile_h = bw * bh > 1 ? bh : DEFAULT_TILE;
+        job.tiles_down = (height + job.tile_h - 1) / job.tile_h;
+        job.cos = c;
+        job.sin = s;
+        job.filter = filter;
+        job.maxval = pixmap->denominator;
+
+        /* (x, y) samples the source at (cx + x cos + y sin,
+           cy - x sin + y cos), about the two centers */
+        double dx = 0.5 - width / 2.0;
+        double dy = 0.5 - height / 2.0;
+        job.cx = w / 2.0 - 0.5 + dx * c + dy * s;
+        job.cy = h / 2.0 - 0.5 - dx * s + dy * c;
+
+        int nthreads = Parallel_threads(pool);
+        job.scratch = calloc(nthreads, sizeof(*job.scratch));
+        assert(job.scratch != NULL);
+
+        int tiles_across = (width + job.tile_w - 1) / job.tile_w;
+        Parallel_for(pool, tiles_across * job.tiles_down, rotate_tile, &job);
+
+        int failed = scratch_free(job.scratch, nthreads);
+        if (failed)
+                methods->free(&job.dst);
+        assert(!failed);
+
+        methods->free(&(pixmap->pixels));
+        pixmap->pixels = job.dst;
+        pixmap->width = width;
+        pixmap->height = height;
+        return 1;
+}
+
+
+static double box(double x)
+{
+        return x >= -0.5 && x < 0.5;
+}
+
+static double triangle(double x)
+{
+        x = fabs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double sinc(double x)
+{
+        if (x == 0.0)
+                return 1.0;
+        x *= M_PI;
+        return sin(x) / x;
+}
+
+static double lanczos(double x)
+{
+        return fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+static const struct kernel kernels[] = {
+        [RESAMPLE_BOX]      = { box, 0.5 },
+        [RESAMPLE_TRIANGLE] = { triangle, 1.0 },
+        [RESAMPLE_LANCZOS]  = { lanczos, 3.0 },
+};
+
+/********** make_taps ********
+ *
+ *      works out the weights for resizing one dimension from in pixels
+ *      to out pixels
+ *
+ *      Notes:
+ *              output pixel o is centered on source position
+ *              (o + 0.5) * in / out; when shrinking, the kernel is
+ *              stretched by in / out so that every source pixel counts
+ *              taps that would fall off the image are dropped and the
+ *              rest renormalized, so edges do not darken
+ *
+ ******************************/
+static struct taps make_taps(int in, int out, Resample_kernel kernel)
+{
+        const struct kernel *k = &kernels[kernel];
+        double scale = (double)in / out;
+        double stretch = scale > 1.0 ? scale : 1.0;
+        double support = k->support * stretch;
+        struct taps taps;
+
+        taps.max = 2 * (int)ceil(support) + 1;
+        taps.first = malloc(out * sizeof(*taps.first));
+        taps.count = malloc(out * sizeof(*taps.count));
+        taps.weights = malloc((size_t)out * taps.max
+                              * sizeof(*taps.weights));
+        assert(taps.first != NULL && taps.count != NULL
+               && taps.weights != NULL);
+
+        for (int o = 0; o < out; o++) {
+                double center = (o + 0.5) * scale;
+                int lo = (int)floor(center - support + 0.5);
+                int hi = (int)floor(center + support + 0.5);
+                float *w = taps.weights + (size_t)o * taps.max;
+                double total = 0.0;
+
+                if (lo < 0)
+                        lo = 0;
+                if (hi > in)
+                        hi = in;
+                if (hi - lo > taps.max)
+                        hi = lo + taps.max;
+                for (int x = lo; x < hi; x++) {
+                        w[x - lo] = k->weight((x + 0.5 - center) / stretch);
+                        total += w[x - lo];
+                }
+
+                if (total == 0.0) {
+                        /* nothing in reach: take the nearest pixel */
+                        lo = (int)center < in ? (int)center : in - 1;
+                        hi = lo + 1;
+                        w[0] = 1.0f;
+                } else {
+                        for (int x = lo; x < hi; x++)
+                                w[x - lo] /= total;
+                }
+                taps.first[o] = lo;
+                taps.count[o] = hi - lo;
+        }
+        return taps;
+}
+
+static void free_taps(struct taps *taps)
+{
+        free(taps->first);
+        free(taps->count);
+        free(taps->weights);
+}
+
+/********** scale_across ********
+ *
+ *      Parallel_work function: the horizontal pass over source rows
+ *      [item * STRIP, item * STRIP + STRIP)
+ *
+ *      Notes:
+ *              the strip is loaded column by column (a column's STRIP
+ *              pixels adjacent), so each tap is a multiply-add over
+ *              STRIP consecutive vectors and the result for an output
+ *              column is a contiguous piece of the column-major mid
+ *
+ ******************************/
+static void scale_across(int item, int thread, void *cl)
+{
+        struct scale_job *job = cl;
+        int sw = job->src->width;
+        int sh = job->src->height;
+        int y0 = item * STRIP;
+        int rows = sh - y0 < STRIP ? sh - y0 : STRIP;
+        v4f *strip = window_for(&job->scratch[thread], (size_t)sw * STRIP);
+        const struct taps *taps = &job->across;
+
+        if (strip == NULL)
+                return;
+
+        load_rect(job->src->pixels, job->cursors, job->src_vertical, 0, y0,
+                  sw, rows, strip, STRIP, 1);
+
+        for (int x = 0; x < job->width; x++) {
+                const float *w = taps->weights + (size_t)x * taps->max;
+                const v4f *in = strip + (size_t)taps->first[x] * STRIP;
+                v4f acc[STRIP];
+
+                for (int r = 0; r < rows; r++)
+                        acc[r] = in[r] * w[0];
+                for (int t = 1; t < taps->count[x]; t++) {
+                        in += STRIP;
+                        for (int r = 0; r < rows; r++)
+                                acc[r] += in[r] * w[t];
+                }
+                memcpy(job->mid + (size_t)x * sh + y0, acc,
+                       rows * sizeof(*acc));
+        }
+}
+
+/********** scale_down ********
+ *
+ *      Parallel_work function: the vertical pass for destination tile
+ *      number item, numbered column by column
+ *
+ *      Notes:
+ *              each output pixel is a dot product over a contiguous
+ *              piece of a mid column; the tile is built in scratch and
+ *              then stored in the destination's own order
+ *
+ ******************************/
+static void scale_down(int item, int thread, void *cl)
+{
+        struct scale_job *job = cl;
+        int x0 = (item / job->tiles_down) * job->tile_w;
+        int y0 = (item % job->tiles_down) * job->tile_h;
+        int tw = job->width - x0 < job->tile_w ? job->width - x0
+                                             : job->tile_w;
+        int th = job->height - y0 < job->tile_h ? job->height - y0
+                                               : job->tile_h;
+        v4f *tile = window_for(&job->scratch[thread], (size_t)tw * th);
+        const struct taps *taps = &job->down;
+
+        if (tile == NULL)
+                return;
+
+        for (int c = 0; c < tw; c++) {
+                const v4f *col = job->mid + (size_t)(x0 + c) * job->src->height;
+                v4f *out = tile + (size_t)c * th;
+
+                for (int r = 0; r < th; r++) {
+                        int y = y0 + r;
+                        const float *w = taps->weights + (size_t)y * taps->max;
+                        const v4f *in = col + taps->first[y];
+                        v4f acc = in[0] * w[0];
+
+                        for (int t = 1; t < taps->count[y]; t++)
+                                acc += in[t] * w[t];
+                        out[r] = acc;
+                }
+        }
+
+        store_rect(job->dst, job->cursors, job->dst_vertical, x0, y0, tw, th,
+                   tile, th, 1, job->maxval);
+}
+
+/********** Resample_scale ********
+ *
+ *      resizes the image with a separable filter
+ *
+ *      Parameters:
+ *              Pnm_ppm pixmap: the pixmap holding the image
+ *              int width, height: the new size, both positive
+ *              Resample_kernel kernel: the filter
+ *              Parallel_T pool: threads to share the work, or NULL
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              frees the 2D array holding the old image in pixmap
+ *              the intermediate image is width x source height floats,
+ *              so shrinking is cheapest and growing costs the most
+ *
+ ******************************/
+void Resample_scale(Pnm_ppm pixmap, int width, int height,
+                    Resample_kernel kernel, Parallel_T pool)
+{
+        A2Methods_T methods = pixmap->methods;
+        A2Methods_CursorT cursors = A2Methods_cursor(methods);
+        int size = methods->size(pixmap->pixels);
+        int bw, bh;
+
+        assert(cursors != NULL);
+        assert(size == sizeof(struct Pnm_rgb));
+        assert(width > 0 && height > 0);
+
+        struct scale_job job;
+        job.src = pixmap;
+        job.cursors = cursors;
+        cursors->blockshape(pixmap->pixels, &bw, &bh);
+        job.dst = cursors->new_with_blockshape(width, height, size, bw, bh);
+        Numa_Place(methods, job.dst);
+        job.width = width;
+        job.height = height;
+        job.across = make_taps(pixmap->width, width, kernel);
+        job.down = make_taps(pixmap->height, height, kernel);
+        job.mid = malloc((size_t)width * pixmap->height * sizeof(*job.mid));
+        assert(job.mid != NULL);
+        job.src_vertical = A2Methods_by_column(cursors, pixmap->pixels);
+        job.dst_vertical = A2Methods_by_column(cursors, job.dst);
+        job.tile_w = bw * bh > 1 ? bw : DEFAULT_TILE;
+        job.tile_h = bw * bh > 1 ? bh : DEFAULT_TILE;
+        job.tiles_down = (height + job.tile_h - 1) / job.tile_h;
+        job.maxval = pixmap->denominator;
+
+        int nthreads = Parallel_threads(pool);
+        job.scratch = calloc(nthreads, sizeof(*job.scratch));
+        assert(job.scratch != NULL);
+
+        int strips = (pixmap->height + STRIP - 1) / STRIP;
+        Parallel_for(pool, strips, scale_across, &job);
+
+        int tiles_across = (width + job.tile_w - 1) / job.tile_w;
+        Parallel_for(pool, tiles_across * job.tiles_down, scale_down, &job);
+
+        int failed = scratch_free(job.scratch, nthreads);
+        free(job.mid);
+        free_taps(&job.across);
+        free_taps(&job.down);
+        if (failed)
+                methods->free(&job.dst);
+        assert(!failed);
+
+        methods->free(&(pixmap->pixels));
+        pixmap->pixels = job.dst;
+        pixmap->width = width;
+        pixmap->height = height;
+}
@@ -0,0 +1,52 @@
+#ifndef RESAMPLE_INCLUDED
+#define RESAMPLE_INCLUDED
+/*
+ *      resample.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              transformations that have to interpolate between source
+ *              pixels rather than copy them. The destination is produced
+ *              one tile at a time (a block of a blocked array), and each
+ *              tile first gathers the small window of the source it
+ *              depends on, so the interpolation itself runs out of cache.
+ *              Tiles are independent and are spread over a Parallel_T.
+ *
+ */
+
+#include "pnm.h"
+#include "parallel.h"
+
+typedef enum {
+        RESAMPLE_NEAREST = 0,
+        RESAMPLE_BILINEAR,
+        RESAMPLE_BICUBIC
+} Resample_filter;
+
+typedef enum {
+        RESAMPLE_BOX = 0,
+        RESAMPLE_TRIANGLE,
+        RESAMPLE_LANCZOS                /* Lanczos-3 */
+} Resample_kernel;
+
+/* rotates the image clockwise by any number of degrees, onto a canvas
+   just large enough to hold it; uncovered pixels are black.  Replaces
+   pixmap->pixels (same methods and blocksize) and updates the width
+   and height.  The image must hold Pnm_rgb pixels and its methods must
+   have cursors (see a2cursor.h).  Returns 0, leaving pixmap alone, if
+   the canvas would have more than INT_MAX pixels, and 1 otherwise. */
+extern int Resample_rotate(Pnm_ppm pixmap, double degrees,
+                           Resample_filter filter, Parallel_T pool);
+
+/* resizes the image to width x height (both at least 1) with a
+   separable filter: a horizontal pass into an intermediate image, then
+   a vertical pass.  When shrinking, the kernel is widened to cover
+   every source pixel.  Same requirements and effect on pixmap as
+   Resample_rotate. */
+extern void Resample_scale(Pnm_ppm pixmap, int width, int height,
+                           Resample_kernel kernel, Parallel_T pool);
+
+#endif
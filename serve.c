@@ -0,0 +1,505 @@
+/*
+ *      serve.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the server and client in serve.h.
+ *
+ *              A request is a header, two 32-bit counts (argc and the
+ *              bytes that follow), sent with the client's descriptors 0,
+ *              1 and 2 attached (SCM_RIGHTS), and then the working
+ *              directory and each argument, every one ended by a NUL.
+ *              The reply is the exit status as a 32-bit int. A request
+ *              the server cannot read, or that is not all sent within
+ *              REQUEST_TIMEOUT seconds, is dropped without a reply,
+ *              which the client reports as a failure. Requests are
+ *              served one at a time, so without the limit a client that
+ *              connected and sent nothing would hold up every other.
+ *
+ *              Latencies go in power-of-two buckets of microseconds.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "assert.h"
+#include "serve.h"
+
+#define MAX_REQUEST (64 * 1024)         /* bytes of directory and argv */
+#define BUCKETS 40                      /* 1us up to about 6 days */
+#define REQUEST_TIMEOUT 5               /* seconds to send a request */
+
+struct header {
+        uint32_t argc;
+        uint32_t len;
+};
+
+struct histogram {
+        long counts[BUCKETS];
+        long requests;
+        double total, max;              /* microseconds */
+};
+
+
+/********** socket_address ********
+ *
+ *      fills in the address of the socket at path
+ *
+ *      Return:
+ *              0 if path is too long for a UNIX socket
+ *
+ ******************************/
+static int socket_address(const char *path, struct sockaddr_un *addr)
+{
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr->sun_path))
+                return 0;
+        strcpy(addr->sun_path, path);
+        return 1;
+}
+
+/* a connection to the server at path, or -1 */
+static int connect_to(const char *path)
+{
+        struct sockaddr_un addr;
+        if (!socket_address(path, &addr))
+                return -1;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+                return -1;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+/* reads exactly n bytes; 0 on end of file or error */
+static int read_all(int fd, void *buf, size_t n)
+{
+        char *p = buf;
+        while (n > 0) {
+                ssize_t got = read(fd, p, n);
+                if (got < 0 && errno == EINTR)
+                        continue;
+                if (got <= 0)
+                        return 0;
+                p += got;
+                n -= got;
+        }
+        return 1;
+}
+
+static int write_all(int fd, const void *buf, size_t n)
+{
+        const char *p = buf;
+        while (n > 0) {
+                ssize_t done = write(fd, p, n);
+                if (done < 0 && errno == EINTR)
+                        continue;
+                if (done <= 0)
+                        return 0;
+                p += done;
+                n -= done;
+        }
+        return 1;
+}
+
+static double now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+/********** record ********
+ *
+ *      adds a latency of us microseconds to the histogram
+ *
+ ******************************/
+static void record(struct histogram *h, double us)
+{
+        int b = 0;
+        while (b < BUCKETS - 1 && us >= (double)(2L << b))
+                b++;
+        h->counts[b]++;
+        h->requests++;
+        h->total += us;
+        if (us > h->max)
+                h->max = us;
+}
+
+/* the upper edge of the bucket that holds the q quantile */
+static double quantile(const struct histogram *h, double q)
+{
+        long want = (long)(q * h->requests + 0.999999);
+        long seen = 0;
+
+        for (int b = 0; b < BUCKETS; b++) {
+                seen += h->counts[b];
+                if (seen >= want)
+                        return (double)(2L << b);
+        }
+        return h->max;
+}
+
+/********** print_histogram ********
+ *
+ *      writes the latency histogram, with a bar for each bucket used
+ *
+ ******************************/
+static void print_histogram(const struct histogram *h, FILE *fp)
+{
+        fprintf(fp, "%ld request%s served\n", h->requests,
+                h->requests == 1 ? "" : "s");
+        if (h->requests == 0)
+                return;
+
+        fprintf(fp, "latency: mean %.1f us, p50 < %.0f us, p90 < %.0f us, "
+                    "p99 < %.0f us, max %.1f us\n",
+                h->total / h->requests, quantile(h, 0.5), quantile(h, 0.9),
+                quantile(h, 0.99), h->max);
+
+        long most = 0;
+        for (int b = 0; b < BUCKETS; b++)
+                if (h->counts[b] > most)
+                        most = h->counts[b];
+        for (int b = 0; b < BUCKETS; b++) {
+                if (h->counts[b] == 0)
+                        continue;
+                int bar = (int)(50 * h->counts[b] / most);
+                fprintf(fp, "  %10ld - %10ld us %8ld  %.*s\n",
+                        b == 0 ? 0L : 1L << b, 2L << b, h->counts[b],
+                        bar > 0 ? bar : 1,
+                        "##################################################");
+        }
+}
+
+
+/********** receive ********
+ *
+ *      reads a request from a connection
+ *
+ *      Parameters:
+ *              int conn: the connection
+ *              int fds[3]: filled with the client's descriptors
+ *              int *argc: filled with the number of arguments
+ *
+ *      Return:
+ *              the request, directory first: argc + 1 strings, with a
+ *              NULL after the last, all in one malloc'd block; NULL if
+ *              the request is malformed or comes without descriptors
+ *
+ ******************************/
+static char **receive(int conn, int fds[3], int *argc)
+{
+        struct header head;
+        struct iovec iov = { &head, sizeof(head) };
+        union {
+                char buf[CMSG_SPACE(3 * sizeof(int))];
+                struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t got = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+        struct cmsghdr *c = got > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+        if (c == NULL || c->cmsg_level != SOL_SOCKET
+            || c->cmsg_type != SCM_RIGHTS
+            || c->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+                return NULL;
+        memcpy(fds, CMSG_DATA(c), 3 * sizeof(int));
+
+        /* the rest of the header may come after the descriptors */
+        if ((size_t)got < sizeof(head)
+            && !read_all(conn, (char *)&head + got, sizeof(head) - got))
+                goto bad;
+        if (head.argc < 1 || head.argc > MAX_REQUEST / 2
+            || head.len < 1 || head.len > MAX_REQUEST)
+                goto bad;
+
+        size_t nptrs = head.argc + 2;
+        char **strs = malloc(nptrs * sizeof(char *) + head.len);
+        assert(strs != NULL);
+        char *text = (char *)(strs + nptrs);
+        if (!read_all(conn, text, head.len) || text[head.len - 1] != '\0') {
+                free(strs);
+                goto bad;
+        }
+
+        /* exactly argc + 1 strings */
+        size_t n = 0;
+        for (char *p = text; p < text + head.len; p += strlen(p) + 1) {
+                if (n == head.argc + 1) {
+                        free(strs);
+                        goto bad;
+                }
+                strs[n++] = p;
+        }
+        if (n != head.argc + 1) {
+                free(strs);
+                goto bad;
+        }
+        strs[n] = NULL;
+        *argc = head.argc;
+        return strs;
+
+bad:
+        for (int k = 0; k < 3; k++)
+                close(fds[k]);
+        return NULL;
+}
+
+
+/********** run_request ********
+ *
+ *      runs one request with the client's directory, error stream and
+ *      input and output, then puts the server's back
+ *
+ *      Return:
+ *              the exit status
+ *
+ ******************************/
+static int run_request(char **strs, int argc, int fds[3], int home,
+                       int saved_err, Serve_handler *handle, void *cl)
+{
+        int status = 1;
+        FILE *in = fdopen(fds[0], "rb");
+        FILE *out = fdopen(fds[1], "wb");
+
+        if (in == NULL || out == NULL || chdir(strs[0]) != 0) {
+                if (in == NULL)
+                        close(fds[0]);
+                if (out == NULL)
+                        close(fds[1]);
+                dprintf(fds[2], "%s: cannot take over the client's "
+                                "files and directory\n", strs[1]);
+        } else {
+                fflush(stderr);
+                dup2(fds[2], STDERR_FILENO);
+                status = handle(argc, strs + 1, in, out, cl);
+                fflush(stderr);
+                dup2(saved_err, STDERR_FILENO);
+        }
+
+        if (in != NULL)
+                fclose(in);
+        if (out != NULL && fclose(out) != 0 && status == 0)
+                status = 1;
+        close(fds[2]);
+        if (fchdir(home) != 0)
+                perror("fchdir");
+        return status;
+}
+
+/********** Serve_run ********
+ *
+ *      runs a server until a client asks it to stop
+ *
+ *      Parameters:
+ *              const char *path: where to put the socket
+ *              Serve_handler *handle: runs each request
+ *              void *cl: passed to handle
+ *
+ *      Return:
+ *              0 once stopped, 1 if the socket cannot be made
+ *
+ *      Notes:
+ *              a socket left behind by a server that has gone is
+ *              replaced; one that answers is not
+ *              SIGPIPE is ignored, so that a client that goes away
+ *              makes its request fail rather than the server
+ *
+ ******************************/
+int Serve_run(const char *path, Serve_handler *handle, void *cl)
+{
+        struct sockaddr_un addr;
+        struct histogram hist;
+
+        assert(path != NULL && handle != NULL);
+        memset(&hist, 0, sizeof(hist));
+
+        int other = connect_to(path);
+        if (other >= 0) {
+                close(other);
+                fprintf(stderr, "A server is already running at %s\n", path);
+                return 1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        mode_t mask = umask(077);
+        int ok = fd >= 0 && socket_address(path, &addr)
+                 && (unlink(path) == 0 || errno == ENOENT)
+                 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+                 && listen(fd, 64) == 0;
+        umask(mask);
+        if (!ok) {
+                perror(path);
+                if (fd >= 0)
+                        close(fd);
+                return 1;
+        }
+
+        int home = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        int saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+        assert(home >= 0 && saved_err >= 0);
+        signal(SIGPIPE, SIG_IGN);
+
+        for (int stop = 0; !stop; ) {
+                int conn = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+                if (conn < 0) {
+                        if (errno != EINTR && errno != ECONNABORTED)
+                                perror("accept");
+                        continue;
+                }
+
+                struct timeval limit = { REQUEST_TIMEOUT, 0 };
+                setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &limit,
+                           sizeof(limit));
+                setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &limit,
+                           sizeof(limit));
+
+                double start = now_us();
+                int fds[3], argc;
+                char **strs = receive(conn, fds, &argc);
+                if (strs == NULL) {
+                        close(conn);
+                        continue;
+                }
+
+                int32_t status = 0;
+                int served = 0;
+                if (argc == 2 && strcmp(strs[2], "--stats") == 0) {
+                        FILE *out = fdopen(fds[1], "w");
+                        if (out != NULL) {
+                                print_histogram(&hist, out);
+                                fclose(out);
+                        } else {
+                                close(fds[1]);
+                        }
+                        close(fds[0]);
+                        close(fds[2]);
+                } else if (argc == 2 && strcmp(strs[2], "--stop") == 0) {
+                        for (int k = 0; k < 3; k++)
+                                close(fds[k]);
+                        stop = 1;
+                } else {
+                        status = run_request(strs, argc, fds, home,
+                                             saved_err, handle, cl);
+                        served = 1;
+                }
+                write_all(conn, &status, sizeof(status));
+                if (served)
+                        record(&hist, now_us() - start);
+                free(strs);
+                close(conn);
+        }
+
+        close(fd);
+        if (fchdir(home) == 0)
+                unlink(path);
+        close(home);
+        close(saved_err);
+        return 0;
+}
+
+
+/********** Serve_client ********
+ *
+ *      sends a command line to a server and waits for its status
+ *
+ *      Parameters:
+ *              const char *path: the server's socket
+ *              int argc, char *argv[]: the command line, argv[0] first
+ *
+ *      Return:
+ *              the command's exit status, or 1 if the server cannot be
+ *              reached or goes away
+ *
+ ******************************/
+int Serve_client(const char *path, int argc, char *argv[])
+{
+        assert(path != NULL && argc >= 1 && argv != NULL);
+
+        char *cwd = getcwd(NULL, 0);
+        assert(cwd != NULL);
+        size_t len = strlen(cwd) + 1;
+        for (int k = 0; k < argc; k++)
+                len += strlen(argv[k]) + 1;
+        if (len > MAX_REQUEST) {
+                fprintf(stderr, "%s: command line too long to send\n",
+                        argv[0]);
+                free(cwd);
+                return 1;
+        }
+
+        char *text = malloc(len);
+        assert(text != NULL);
+        char *p = stpcpy(text, cwd) + 1;
+        for (int k = 0; k < argc; k++)
+                p = stpcpy(p, argv[k]) + 1;
+        free(cwd);
+
+        int conn = connect_to(path);
+        if (conn < 0) {
+                fprintf(stderr, "%s: no server at %s\n", argv[0], path);
+                free(text);
+                return 1;
+        }
+
+        struct header head = { argc, len };
+        struct iovec iov = { &head, sizeof(head) };
+        int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+        union {
+                char buf[CMSG_SPACE(sizeof(fds))];
+                struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        memset(&control, 0, sizeof(control));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+        int32_t status = 1;
+        if (sendmsg(conn, &msg, 0) != (ssize_t)sizeof(head)
+            || !write_all(conn, text, len)
+            || !read_all(conn, &status, sizeof(status))) {
+                fprintf(stderr, "%s: the server at %s went away\n",
+                        argv[0], path);
+                status = 1;
+        }
+
+        free(text);
+        close(conn);
+        return status;
+}
@@ -0,0 +1,56 @@
+#ifndef SERVE_INCLUDED
+#define SERVE_INCLUDED
+/*
+ *      serve.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              a long-lived local server that runs command lines sent
+ *              over a UNIX socket, and the client that sends them. A
+ *              request is an argv, the client's working directory, and
+ *              the client's standard input, output and error, passed as
+ *              file descriptors; the reply is an exit status. So a
+ *              client behaves exactly like the command it stands for,
+ *              paths and redirections included, while the work runs in
+ *              a process whose threads, heap and caches are warm.
+ *
+ *              Requests are run one at a time, in the order they come;
+ *              a client that connects but does not send its request
+ *              within a few seconds is dropped, so it cannot hold up
+ *              the others. The server times each request, from
+ *              receiving it to replying, and keeps a histogram of these
+ *              latencies. Two requests are handled by the server
+ *              itself rather than passed on: "--stats" writes the
+ *              histogram to the client's output and "--stop" shuts the
+ *              server down.
+ *
+ *      Usage:
+ *
+ *              server:  Serve_run("/tmp/ppmtrans.sock", handle, cl);
+ *              client:  exit(Serve_client("/tmp/ppmtrans.sock",
+ *                                         argc, argv));
+ *
+ */
+
+#include <stdio.h>
+
+/* runs one request; in and out are the client's standard input and
+   output, and stderr and the working directory are the client's until
+   it returns.  Returns the exit status for the client. */
+typedef int Serve_handler(int argc, char *argv[], FILE *in, FILE *out,
+                          void *cl);
+
+/* listens on the socket at path, which must not belong to a running
+   server, and runs each request with handle until one asks to stop;
+   the socket can only be used by the same user.  Returns 0 once
+   stopped, or 1 if the socket cannot be made. */
+extern int Serve_run(const char *path, Serve_handler *handle, void *cl);
+
+/* sends argv to the server at path and waits for it; returns the exit
+   status, or 1 if there is no server */
+extern int Serve_client(const char *path, int argc, char *argv[]);
+
+#endif
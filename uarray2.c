@@ -11,9 +11,14 @@
 
 #include "uarray2.h"
 #include <except.h>
+#include "cachesim.h"
+#include "elemsize.h"
 
 Except_T Malloc_Fail = { "Malloc Failed" };
 Except_T Invalid_P = { "NULL Pointer to Array" };
+Except_T Out_Of_Bounds = { "Provided Index is Out of Range" };
+
+typedef void applyfun(int i, int j, UArray2_T a, void *elem, void *cl);
 
 
 /********** UArray2_new ********
@@ -45,6 +50,7 @@ UArray2_T UArray2_new(int columns, int rows, int elemSize)
         }
 
         uarray2->theArray = arr;
+        uarray2->cells = rows * columns > 0 ? UArray_at(arr, 0) : NULL;
         uarray2->numRows = rows;
         uarray2->numCols = columns;
         uarray2->size = elemSize;
@@ -143,6 +149,12 @@ int UArray2_size(UArray2_T arr)
  *
  *      Notes:
  *              if pointer to array is null, exit with checked runtime error
+ *
+ *              if an index is out of range, exit with checked runtime error
+ *
+ *              the address is computed straight from the cached storage
+ *              pointer rather than through UArray_at, so an access costs
+ *              one bounds check and one multiply-add
  *      
  ******************************/
 void *UArray2_at(UArray2_T arr, int colIdx, int rowIdx)
@@ -150,9 +162,84 @@ void *UArray2_at(UArray2_T arr, int colIdx, int rowIdx)
         if (arr == NULL) {
                 RAISE(Invalid_P);
         }
-        return UArray_at(arr->theArray, ((colIdx * arr->numRows) + rowIdx));
+        if (colIdx < 0 || colIdx >= arr->numCols ||
+            rowIdx < 0 || rowIdx >= arr->numRows) {
+                RAISE(Out_Of_Bounds);
+        }
+        void *elem = arr->cells + ((size_t)colIdx * arr->numRows + rowIdx)
+                                  * arr->size;
+        CACHESIM_TRACE(elem, arr->size);
+        return elem;
+}
+
+/********** map_col_major_sized, map_row_major_sized ********
+ *
+ *      the loops behind UArray2_map_col_major and UArray2_map_row_major,
+ *      written against the raw element storage with the element size
+ *      as a parameter
+ *
+ *      Parameters:
+ *              UArray2_T a: the 2D array to be mapped
+ *              applyfun apply: the function to be applied to each element
+ *              void *cl: closure argument
+ *              int size: the element size of a
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              the element pointer is stepped by a fixed stride rather
+ *              than recomputed from (i, j): the storage is column major,
+ *              so a column-major walk moves one element at a time and a
+ *              row-major walk moves one column (numRows elements)
+ *              these are always inlined, so a call with a constant size
+ *              gets a copy of the loop with a constant stride
+ *              not UArray2_at, so that a cache simulation sees only the
+ *              accesses made by apply
+ *      
+ ******************************/
+ELEMSIZE_INLINE void map_col_major_sized(UArray2_T a, applyfun apply, 
+                                         void *cl, int size)
+{
+        int cols = a->numCols;
+        int rows = a->numRows;
+
+        if (cols == 0 || rows == 0)
+                return;
+
+        char *p = a->cells;
+
+        for (int i = 0; i < cols; i++) {
+                for (int j = 0; j < rows; j++) {
+                        apply(i, j, a, p, cl);
+                        p += size;
+                }
+        }
 }
 
+ELEMSIZE_INLINE void map_row_major_sized(UArray2_T a, applyfun apply, 
+                                         void *cl, int size)
+{
+        int cols = a->numCols;
+        int rows = a->numRows;
+
+        if (cols == 0 || rows == 0)
+                return;
+
+        char *elems = a->cells;
+        size_t stride = (size_t)rows * size;
+
+        for (int j = 0; j < rows; j++) {
+                char *p = elems + (size_t)j * size;
+                for (int i = 0; i < cols; i++) {
+                        apply(i, j, a, p, cl);
+                        p += stride;
+                }
+        }
+}
+
+#define MAP_CASE(N, MAP) case N: MAP(a, apply, cl, N); break;
+
 /********** UArray2_map_col_major ********
  *
  *      maps over the array with columns getting priority, applying the 
@@ -178,6 +265,7 @@ void *UArray2_at(UArray2_T arr, int colIdx, int rowIdx)
  *              
  *      Notes:
  *              if pointer to array is null, exit with checked runtime error
+ *              runs a copy of the loop specialized to the element size
  *      
  ******************************/
 void UArray2_map_col_major(UArray2_T a, 
@@ -188,10 +276,10 @@ void UArray2_map_col_major(UArray2_T a,
                 RAISE(Invalid_P);
         }
 
-        for (int i = 0; i < a->numCols; i++) {
-                for (int j = 0; j <  a->numRows; j++) {
-                        apply(i, j, a, UArray2_at(a, i, j), cl);
-                }
+        switch (a->size) {
+        ELEMSIZE_FOREACH(MAP_CASE, map_col_major_sized)
+        default:
+                map_col_major_sized(a, apply, cl, a->size);
         }
 }
 
@@ -220,6 +308,7 @@ void UArray2_map_col_major(UArray2_T a,
  *              
  *      Notes:
  *              if pointer to array is null, exit with checked runtime error
+ *              runs a copy of the loop specialized to the element size
  *      
  ******************************/
 void UArray2_map_row_major(UArray2_T a, 
@@ -230,10 +319,10 @@ void UArray2_map_row_major(UArray2_T a,
                 RAISE(Invalid_P);
         }
 
-        for (int j = 0; j < a->numRows; j++) {
-                for (int i = 0; i <  a->numCols; i++) {
-                        apply(i, j, a, UArray2_at(a, i, j), cl);
-                }
+        switch (a->size) {
+        ELEMSIZE_FOREACH(MAP_CASE, map_row_major_sized)
+        default:
+                map_row_major_sized(a, apply, cl, a->size);
         }
 }
 
@@ -17,6 +17,7 @@ typedef struct UArray2_T *UArray2_T;
 
 struct UArray2_T {
         UArray_T theArray;
+        char *cells;            /* theArray's storage, NULL if empty */
         int numRows;
         int numCols;
         int size;
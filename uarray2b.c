@@ -14,11 +14,14 @@
  */
 
 #include "uarray2b.h"
+#include "uarray2brect.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include "uarray.h"
 #include "except.h"
 #include <math.h>
+#include "cachesim.h"
+#include "elemsize.h"
 
 Except_T Malloc_Failb = { "Malloc Failed" };
 Except_T Invalid_Pb = { "NULL Pointer to Array" };
@@ -30,11 +33,80 @@ struct UArray2b_T {
         int height;
         int width;
         int size;
-        int blocksize;
+        int blockwidth;         /* columns per block */
+        int blockheight;        /* rows per block */
+        char *cells;            /* theArray's storage, NULL if empty */
+        size_t *col_offset;     /* bytes from cells to (column, 0) */
+        size_t *row_offset;     /* bytes from (column, 0) to (column,
+                                   row); see make_offsets */
 };
 
 typedef struct UArray2b_T *T;
 
+/********** make_offsets ********
+ *
+ *      fills in the offset tables UArray2b_at uses in place of dividing
+ *      by the block shape
+ *
+ *      Parameters:
+ *              T array2b: a new array, all but its tables filled in
+ *
+ *      Return:
+ *              nothing
+ *
+ *      Notes:
+ *              blocks are laid out in column-major order (the order
+ *              UArray2b_map visits them) and the cells of a block in
+ *              row-major order, so the index of (column, row) is the
+ *              sum of a part that depends only on the column,
+ *
+ *                      (column / bw) * blocks_down * bw * bh
+ *                      + column % bw,
+ *
+ *              and a part that depends only on the row,
+ *
+ *                      (row / bh) * bw * bh + (row % bh) * bw;
+ *
+ *              each table holds its part in bytes, one entry per column
+ *              or row, and is built by counting rather than dividing
+ *
+ *              exit with a checked runtime error if malloc fails
+ *
+ ******************************/
+static void make_offsets(T array2b)
+{
+        int bw = array2b->blockwidth;
+        int bh = array2b->blockheight;
+        size_t size = array2b->size;
+        size_t block = (size_t)bw * bh * size;
+        size_t block_column = block * ((array2b->height + bh - 1) / bh);
+        size_t *offsets = malloc((array2b->width + array2b->height + 1)
+                                 * sizeof(size_t));
+
+        if (offsets == NULL)
+                RAISE(Malloc_Failb);
+        array2b->col_offset = offsets;
+        array2b->row_offset = offsets + array2b->width;
+
+        size_t base = 0;
+        for (int column = 0, j = 0; column < array2b->width; column++) {
+                array2b->col_offset[column] = base + j * size;
+                if (++j == bw) {
+                        j = 0;
+                        base += block_column;
+                }
+        }
+
+        base = 0;
+        for (int row = 0, i = 0; row < array2b->height; row++) {
+                array2b->row_offset[row] = base + (size_t)i * bw * size;
+                if (++i == bh) {
+                        i = 0;
+                        base += block;
+                }
+        }
+}
+
 /********** UArray2b_new ********
  *
  *      creates a new blocked array based on the width, height, size, and
@@ -60,12 +132,40 @@ typedef struct UArray2b_T *T;
  ******************************/
 T UArray2b_new (int width, int height, int size, int blocksize)
 {
-        if (blocksize < 1)
+        return UArray2b_new_rect(width, height, size, blocksize, blocksize);
+}
+
+/********** UArray2b_new_rect ********
+ *
+ *      creates a new blocked array whose blocks are blockwidth columns
+ *      by blockheight rows
+ *
+ *      Parameters:
+ *              int width: the width of the image array
+ *              int height: the height of the image array
+ *              int size: the size of the elements in the array
+ *              int blockwidth: columns per block
+ *              int blockheight: rows per block
+ *
+ *      Return: 
+ *              a pointer to the blocked array struct
+ *
+ *      Notes:
+ *              exit with a checked runtime error if either block edge is
+ *              less than 1
+ *              exit with a checked runtime error if the array struct is NULL
+ *              blocks are still stored column major, each row major
+ *      
+ ******************************/
+T UArray2b_new_rect(int width, int height, int size, int blockwidth,
+                    int blockheight)
+{
+        if (blockwidth < 1 || blockheight < 1)
                 RAISE(Invalid_BS);
         
-        int numElems = blocksize * blocksize * 
-                        ((width + blocksize - 1) / blocksize) * 
-                        ((height + blocksize - 1) / blocksize);
+        int numElems = blockwidth * blockheight * 
+                        ((width + blockwidth - 1) / blockwidth) * 
+                        ((height + blockheight - 1) / blockheight);
                         
         UArray_T arr = UArray_new(numElems, size);
         T uarray2b = malloc(sizeof(*uarray2b));
@@ -77,7 +177,10 @@ T UArray2b_new (int width, int height, int size, int blocksize)
         uarray2b->height = height;
         uarray2b->width = width;
         uarray2b->size = size;
-        uarray2b->blocksize = blocksize;
+        uarray2b->blockwidth = blockwidth;
+        uarray2b->blockheight = blockheight;
+        uarray2b->cells = numElems > 0 ? UArray_at(arr, 0) : NULL;
+        make_offsets(uarray2b);
         return uarray2b;
 }
 
@@ -139,6 +242,7 @@ void UArray2b_free (T *array2b)
         }
 
         UArray_free(&((*array2b)->theArray));
+        free((*array2b)->col_offset);
         free(*array2b);
 }
 
@@ -232,6 +336,7 @@ int UArray2b_size (T array2b)
  *
  *      Notes:
  *              exit with a checked runtime error if array2b is NULL
+ *              for rectangular blocks, the shorter edge
  *      
  ******************************/
 int UArray2b_blocksize(T array2b)
@@ -239,7 +344,58 @@ int UArray2b_blocksize(T array2b)
         if (array2b == NULL)
                 RAISE(Invalid_Pb);
         
-        return array2b->blocksize;
+        return array2b->blockwidth < array2b->blockheight 
+               ? array2b->blockwidth : array2b->blockheight;
+}
+
+/********** UArray2b_blockwidth ********
+ *
+ *      returns the width of each block of the blocked array
+ *
+ *      Parameters:
+ *              T array2b: a pointer to the array
+ *
+ *      Return: 
+ *              int value of the block width, in cells
+ *
+ *      Expects:
+ *              array2b to not be NULL
+ *
+ *      Notes:
+ *              exit with a checked runtime error if array2b is NULL
+ *      
+ ******************************/
+int UArray2b_blockwidth(T array2b)
+{
+        if (array2b == NULL)
+                RAISE(Invalid_Pb);
+        
+        return array2b->blockwidth;
+}
+
+/********** UArray2b_blockheight ********
+ *
+ *      returns the height of each block of the blocked array
+ *
+ *      Parameters:
+ *              T array2b: a pointer to the array
+ *
+ *      Return: 
+ *              int value of the block height, in cells
+ *
+ *      Expects:
+ *              array2b to not be NULL
+ *
+ *      Notes:
+ *              exit with a checked runtime error if array2b is NULL
+ *      
+ ******************************/
+int UArray2b_blockheight(T array2b)
+{
+        if (array2b == NULL)
+                RAISE(Invalid_Pb);
+        
+        return array2b->blockheight;
 }
 
 /********** UArray2b_at ********
@@ -260,24 +416,134 @@ int UArray2b_blocksize(T array2b)
  *      Notes:
  *              exits with checked runtime error if the array is NULL or the
  *              indices are out of bounds
+ *              two table loads and an add (see make_offsets), with no
+ *              division by the block shape
  *      
  ******************************/
 void *UArray2b_at(T array2b, int column, int row)
 {
         if (array2b == NULL)
                 RAISE(Invalid_Pb);
-        if (column >= array2b->width || row >= array2b->height)
+        if (column < 0 || column >= array2b->width || 
+            row < 0 || row >= array2b->height)
                 RAISE(Out_Of_Range);
 
-        int b = array2b->size;
-        int height = array2b->height;
+        void *elem = array2b->cells + array2b->col_offset[column]
+                     + array2b->row_offset[row];
+        CACHESIM_TRACE(elem, array2b->size);
+        return elem;
+}
+
+typedef void applyfun(int col, int row, T array2b, void *elem, void *cl);
+
+/********** map_block_full, map_block_edge ********
+ *
+ *      apply a function to every cell of one block, in row-major order
+ *
+ *      Parameters:
+ *              T array2b: the array that is being mapped over
+ *              applyfun apply: apply function, as for UArray2b_map
+ *              void *cl: a persisting variable throughout the map
+ *              char *p: the first cell of the block
+ *              int col0, row0: the indices of that cell
+ *              int cols, rows: (edge blocks only) how many columns and
+ *                              rows of the block lie inside the array
+ *              int bw, bh: the block width and height
+ *              int size: the element size of array2b
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              a full block is one contiguous run of bw * bh cells, so the
+ *              pointer simply advances one element at a time; an edge
+ *              block skips the padding at the end of each row
+ *      
+ ******************************/
+ELEMSIZE_INLINE void map_block_full(T array2b, applyfun apply, void *cl,
+                                    char *p, int col0, int row0, int bw,
+                                    int bh, int size)
+{
+        for (int row = row0; row < row0 + bh; row++) {
+                for (int col = col0; col < col0 + bw; col++) {
+                        apply(col, row, array2b, p, cl);
+                        p += size;
+                }
+        }
+}
+
+ELEMSIZE_INLINE void map_block_edge(T array2b, applyfun apply, void *cl,
+                                    char *p, int col0, int row0, int cols,
+                                    int rows, int bw, int size)
+{
+        for (int i = 0; i < rows; i++) {
+                char *cell = p + (size_t)i * bw * size;
+                for (int j = 0; j < cols; j++) {
+                        apply(col0 + j, row0 + i, array2b, cell, cl);
+                        cell += size;
+                }
+        }
+}
 
-        int index = (b * height * (column / b)) + (b * b * (row / b))
-                + (column % b) + ((row % b) * b);
+/********** map_sized ********
+ *
+ *      the loop behind UArray2b_map, written against the raw element
+ *      storage with the element size as a parameter
+ *
+ *      Parameters:
+ *              T array2b: the array that is being mapped over
+ *              applyfun apply: apply function, as for UArray2b_map
+ *              void *cl: a persisting variable throughout the map
+ *              int size: the element size of array2b
+ *
+ *      Return: 
+ *              nothing
+ *
+ *      Notes:
+ *              blocks are stored in the order they are visited, so the
+ *              block pointer steps by one block each time and no index
+ *              is ever recomputed; only the last block column and the
+ *              last block row can be partial
+ *              always inlined, so a call with a constant size gets a
+ *              copy of the loop with a constant stride
+ *              not UArray2b_at, so that a cache simulation sees only the
+ *              accesses made by apply
+ *      
+ ******************************/
+ELEMSIZE_INLINE void map_sized(T array2b, applyfun apply, void *cl, int size)
+{
+        int bw = array2b->blockwidth;
+        int bh = array2b->blockheight;
+        int rows = array2b->height;
+        int cols = array2b->width;
+
+        if (rows == 0 || cols == 0)
+                return;
+
+        char *block = UArray_at(array2b->theArray, 0);
+        size_t block_bytes = (size_t)bw * bh * size;
+
+        /* loop through blocks column major */
+        for (int col0 = 0; col0 < cols; col0 += bw) {
+                int bcols = cols - col0 < bw ? cols - col0 : bw;
+
+                for (int row0 = 0; row0 < rows; row0 += bh) {
+                        int brows = rows - row0 < bh ? rows - row0 : bh;
 
-        return UArray_at(array2b->theArray, index);
+                        if (bcols == bw && brows == bh)
+                                map_block_full(array2b, apply, cl, block,
+                                               col0, row0, bw, bh, size);
+                        else
+                                map_block_edge(array2b, apply, cl, block,
+                                               col0, row0, bcols, brows,
+                                               bw, size);
+                        block += block_bytes;
+                }
+        }
 }
 
+#define MAP_CASE(N, MAP) case N: MAP(array2b, apply, cl, N); break;
+
 /********** UArray2b_map ********
  *
  *      will map over the entire 2D array, applying the 'apply' function
@@ -303,6 +569,7 @@ void *UArray2b_at(T array2b, int column, int row)
  *
  *      Notes:
  *              CRE if array2b passed is null
+ *              runs a copy of the loop specialized to the element size
  *              
  *      
  ******************************/
@@ -313,30 +580,9 @@ void UArray2b_map(T array2b,
         if (array2b == NULL)
                 RAISE(Invalid_Pb);
 
-        int bs = array2b->blocksize;
-        int rows = array2b->height;
-        int cols = array2b->width;
-
-        /* loop through blocks column major */
-        for (int bc = 0; bc < (cols + bs - 1) / bs; bc++) {
-                for (int br = 0; br < (rows + bs - 1) / bs; br++) {
-
-                        /* loop through elements within the blocks row-major */
-                        for (int i = 0; i < bs; i++) {
-                                for (int j = 0; j < bs; j++) {
-
-                                int row = br * bs + i;
-                                int col = bc * bs + j;
-
-                                if (row < rows && col < cols) {
-                                        apply(col, 
-                                              row, 
-                                              array2b, 
-                                              UArray2b_at(array2b, col, row), 
-                                              cl);
-                                }
-                                }
-                        }
-                }
+        switch (array2b->size) {
+        ELEMSIZE_FOREACH(MAP_CASE, map_sized)
+        default:
+                map_sized(array2b, apply, cl, array2b->size);
         }
 }
@@ -0,0 +1,34 @@
+#ifndef UARRAY2BRECT_INCLUDED
+#define UARRAY2BRECT_INCLUDED
+/*
+ *      uarray2brect.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              rectangular blocks for UArray2b_T. A block may be any
+ *              number of columns wide and rows high; blocks are still
+ *              stored column major and the cells of each block row
+ *              major, so a square block is laid out exactly as by
+ *              UArray2b_new. Tall, narrow blocks (16x256, say) keep a
+ *              rotation's reads and writes within fewer pages; wide,
+ *              short ones suit row-order consumers.
+ *
+ */
+
+#include "uarray2b.h"
+
+#define T UArray2b_T
+
+/* an array of blocks blockwidth columns by blockheight rows, each at
+   least 1 */
+extern T UArray2b_new_rect(int width, int height, int size, int blockwidth,
+                           int blockheight);
+
+extern int UArray2b_blockwidth (T array2b);
+extern int UArray2b_blockheight(T array2b);
+
+#undef T
+#endif
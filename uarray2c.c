@@ -0,0 +1,498 @@
+/*
+ *      uarray2c.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the compressed blocked array in
+ *              uarray2c.h. Every block has a header saying how it is
+ *              encoded and where; a block in the cache also has a slot,
+ *              found through slot_of without a search. Slots are reused
+ *              least recently used first.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "assert.h"
+#include "uarray2c.h"
+#include "cachesim.h"
+#include "elemsize.h"
+
+#define BLOCK_BYTES (4 * 1024)          /* a block: a page, well in L1 */
+#define MAX_CELLS 65536                 /* per block */
+#define MAX_RUN 256                     /* cells in one run of a RLE block */
+
+#define T UArray2c_T
+
+/* how a block is stored */
+enum kind {
+        ZERO,           /* no data: every byte is zero */
+        FILL,           /* data is one cell, repeated */
+        RLE,            /* data is runs: a byte holding the count less
+                           one, then the cell */
+        RAW             /* data is the cells */
+};
+
+struct block {
+        unsigned char kind;
+        int len;                /* bytes of data */
+        unsigned char *data;
+};
+
+struct slot {
+        int block;              /* number of the block held */
+        unsigned long used;     /* clock when last used */
+        unsigned char *cells;
+};
+
+struct T {
+        int width, height;
+        int size;
+        int blockwidth;         /* columns per block */
+        int blockheight;        /* rows per block */
+        int blocks_down;        /* of the whole array */
+        int nblocks;
+        struct block *blocks;   /* column-major */
+        int *slot_of;           /* for each block, its slot or -1 */
+        struct slot slots[UARRAY2C_SLOTS];
+        int nslots;             /* slots in use */
+        int last;               /* slot used most recently, -1 if none */
+        unsigned long clock;
+        unsigned char *scratch; /* a block's worth, for encoding */
+};
+
+
+/********** UArray2c_new ********
+ *
+ *      creates a new compressed blocked array, every cell zero
+ *
+ *      Parameters:
+ *              int width, height: the size of the array in cells
+ *              int size: the size of each cell
+ *              int blockwidth, blockheight: the cells of a block
+ *
+ *      Return:
+ *              the new array
+ *
+ *      Notes:
+ *              CRE if a block edge is less than 1, a block has more
+ *              than MAX_CELLS cells, or memory runs out
+ *              no block has any data until it is written
+ *
+ ******************************/
+T UArray2c_new(int width, int height, int size, int blockwidth,
+               int blockheight)
+{
+        assert(width >= 0 && height >= 0 && size > 0);
+        assert(blockwidth > 0 && blockheight > 0);
+        assert((long)blockwidth * blockheight <= MAX_CELLS);
+
+        T array2c = malloc(sizeof(*array2c));
+        assert(array2c != NULL);
+        array2c->width = width;
+        array2c->height = height;
+        array2c->size = size;
+        array2c->blockwidth = blockwidth;
+        array2c->blockheight = blockheight;
+        array2c->blocks_down = (height + blockheight - 1) / blockheight;
+        array2c->nblocks = (width + blockwidth - 1) / blockwidth
+                           * array2c->blocks_down;
+        array2c->nslots = 0;
+        array2c->last = -1;
+        array2c->clock = 0;
+
+        int n = array2c->nblocks;
+        array2c->blocks = calloc(n > 0 ? n : 1, sizeof(struct block));
+        array2c->slot_of = malloc((n > 0 ? n : 1) * sizeof(int));
+        array2c->scratch = malloc((size_t)blockwidth * blockheight * size);
+        assert(array2c->blocks != NULL && array2c->slot_of != NULL);
+        assert(array2c->scratch != NULL);
+        for (int b = 0; b < n; b++) {
+                array2c->blocks[b].kind = ZERO;
+                array2c->slot_of[b] = -1;
+        }
+        return array2c;
+}
+
+/********** UArray2c_new_cache_sized ********
+ *
+ *      creates a compressed blocked array with square blocks of about
+ *      BLOCK_BYTES
+ *
+ ******************************/
+T UArray2c_new_cache_sized(int width, int height, int size)
+{
+        int edge = size >= BLOCK_BYTES ? 1 : (int)sqrt(BLOCK_BYTES / size);
+
+        return UArray2c_new(width, height, size, edge, edge);
+}
+
+void UArray2c_free(T *array2c)
+{
+        assert(array2c != NULL && *array2c != NULL);
+        T a = *array2c;
+
+        for (int b = 0; b < a->nblocks; b++)
+                free(a->blocks[b].data);
+        for (int s = 0; s < a->nslots; s++)
+                free(a->slots[s].cells);
+        free(a->blocks);
+        free(a->slot_of);
+        free(a->scratch);
+        free(a);
+        *array2c = NULL;
+}
+
+int UArray2c_width(T array2c)
+{
+        assert(array2c != NULL);
+        return array2c->width;
+}
+
+int UArray2c_height(T array2c)
+{
+        assert(array2c != NULL);
+        return array2c->height;
+}
+
+int UArray2c_size(T array2c)
+{
+        assert(array2c != NULL);
+        return array2c->size;
+}
+
+int UArray2c_blockwidth(T array2c)
+{
+        assert(array2c != NULL);
+        return array2c->blockwidth;
+}
+
+int UArray2c_blockheight(T array2c)
+{
+        assert(array2c != NULL);
+        return array2c->blockheight;
+}
+
+
+/********** coding ********
+ *
+ *      the loops that encode and decode a block, written with the cell
+ *      size as a parameter and always inlined, so that a call with a
+ *      constant size compares and copies cells with a few moves
+ *
+ *      Notes:
+ *              rle_encode gives up, returning -1, as soon as the runs
+ *              take more than limit bytes
+ *
+ ******************************/
+ELEMSIZE_INLINE bool all_same(const unsigned char *cells, int n, int size)
+{
+        for (int k = 1; k < n; k++)
+                if (memcmp(cells + (size_t)k * size, cells, size) != 0)
+                        return false;
+        return true;
+}
+
+ELEMSIZE_INLINE int rle_encode(const unsigned char *cells, int n, int size,
+                               unsigned char *out, int limit)
+{
+        int len = 0;
+
+        for (int k = 0; k < n; ) {
+                const unsigned char *cell = cells + (size_t)k * size;
+                int run = 1;
+                while (k + run < n && run < MAX_RUN
+                       && memcmp(cell + (size_t)run * size, cell, size) == 0)
+                        run++;
+                if (len + 1 + size > limit)
+                        return -1;
+                out[len] = run - 1;
+                ELEMSIZE_COPY(out + len + 1, cell, size);
+                len += 1 + size;
+                k += run;
+        }
+        return len;
+}
+
+ELEMSIZE_INLINE void fill_decode(unsigned char *cells, int n, int size,
+                                 const unsigned char *cell)
+{
+        for (int k = 0; k < n; k++, cells += size)
+                ELEMSIZE_COPY(cells, cell, size);
+}
+
+ELEMSIZE_INLINE void rle_decode(unsigned char *cells, int size,
+                                const unsigned char *in, int len)
+{
+        for (int i = 0; i < len; i += 1 + size) {
+                int run = in[i] + 1;
+                for (int k = 0; k < run; k++, cells += size)
+                        ELEMSIZE_COPY(cells, in + i + 1, size);
+        }
+}
+
+#define SAME_CASE(N, UNUSED) case N: return all_same(cells, n, N);
+#define RLE_CASE(N, UNUSED) case N: return rle_encode(cells, n, N, out, limit);
+
+static bool same_cells(const unsigned char *cells, int n, int size)
+{
+        switch (size) {
+        ELEMSIZE_FOREACH(SAME_CASE, _)
+        default:
+                return all_same(cells, n, size);
+        }
+}
+
+static int runs(const unsigned char *cells, int n, int size,
+                unsigned char *out, int limit)
+{
+        switch (size) {
+        ELEMSIZE_FOREACH(RLE_CASE, _)
+        default:
+                return rle_encode(cells, n, size, out, limit);
+        }
+}
+
+#define FILL_CASE(N, UNUSED) case N: fill_decode(cells, n, N, data); break;
+#define UNRLE_CASE(N, UNUSED) case N: rle_decode(cells, N, data, len); break;
+
+
+/********** encode ********
+ *
+ *      stores the cells of block b, which it holds decoded, in the
+ *      smallest of the four encodings
+ *
+ *      Notes:
+ *              the old data is kept if the new is the same, which is
+ *              the usual case for a block that was only read
+ *
+ ******************************/
+static void encode(T a, int b, const unsigned char *cells)
+{
+        struct block *blk = &a->blocks[b];
+        int n = a->blockwidth * a->blockheight;
+        int size = a->size;
+        int bytes = n * size;
+        const unsigned char *data = a->scratch;
+        unsigned char kind;
+        int len;
+
+        if (same_cells(cells, n, size)) {
+                bool zero = true;
+                for (int i = 0; i < size; i++)
+                        zero = zero && cells[i] == 0;
+                kind = zero ? ZERO : FILL;
+                len = zero ? 0 : size;
+                data = cells;
+        } else {
+                len = runs(cells, n, size, a->scratch, bytes);
+                kind = RLE;
+                if (len < 0) {
+                        kind = RAW;
+                        len = bytes;
+                        data = cells;
+                }
+        }
+
+        if (blk->kind == kind && blk->len == len
+            && (len == 0 || memcmp(blk->data, data, len) == 0))
+                return;
+        if (blk->len != len) {
+                free(blk->data);
+                blk->data = len > 0 ? malloc(len) : NULL;
+                assert(len == 0 || blk->data != NULL);
+        }
+        if (len > 0)
+                memcpy(blk->data, data, len);
+        blk->kind = kind;
+        blk->len = len;
+}
+
+/********** decode ********
+ *
+ *      writes the cells of block b into cells
+ *
+ ******************************/
+static void decode(T a, int b, unsigned char *cells)
+{
+        const struct block *blk = &a->blocks[b];
+        const unsigned char *data = blk->data;
+        int n = a->blockwidth * a->blockheight;
+        int len = blk->len;
+
+        switch (blk->kind) {
+        case ZERO:
+                memset(cells, 0, (size_t)n * a->size);
+                break;
+        case FILL:
+                switch (a->size) {
+                ELEMSIZE_FOREACH(FILL_CASE, _)
+                default:
+                        fill_decode(cells, n, a->size, data);
+                }
+                break;
+        case RLE:
+                switch (a->size) {
+                ELEMSIZE_FOREACH(UNRLE_CASE, _)
+                default:
+                        rle_decode(cells, a->size, data, len);
+                }
+                break;
+        default:
+                memcpy(cells, data, len);
+        }
+}
+
+
+/********** load ********
+ *
+ *      decodes block b into a slot, a free one if there is one and
+ *      otherwise the least recently used, whose block is encoded first
+ *
+ *      Return:
+ *              the slot
+ *
+ ******************************/
+static int load(T a, int b)
+{
+        int s;
+
+        if (a->nslots < UARRAY2C_SLOTS) {
+                s = a->nslots++;
+                a->slots[s].cells = malloc((size_t)a->blockwidth
+                                           * a->blockheight * a->size);
+                assert(a->slots[s].cells != NULL);
+        } else {
+                s = 0;
+                for (int k = 1; k < UARRAY2C_SLOTS; k++)
+                        if (a->slots[k].used < a->slots[s].used)
+                                s = k;
+                encode(a, a->slots[s].block, a->slots[s].cells);
+                a->slot_of[a->slots[s].block] = -1;
+        }
+
+        decode(a, b, a->slots[s].cells);
+        a->slots[s].block = b;
+        a->slot_of[b] = s;
+        return s;
+}
+
+/********** block_cells ********
+ *
+ *      the decoded cells of block b
+ *
+ *      Notes:
+ *              the slot used last is checked first, since runs of
+ *              accesses to one block are the common case; it needs no
+ *              new clock, being the most recent already
+ *
+ ******************************/
+static inline unsigned char *block_cells(T a, int b)
+{
+        if (a->last >= 0 && a->slots[a->last].block == b)
+                return a->slots[a->last].cells;
+
+        int s = a->slot_of[b];
+        if (s < 0)
+                s = load(a, b);
+        a->slots[s].used = ++a->clock;
+        a->last = s;
+        return a->slots[s].cells;
+}
+
+/********** UArray2c_at ********
+ *
+ *      returns a pointer to the cell at (column, row), decoding its
+ *      block if it is not in the cache
+ *
+ *      Notes:
+ *              CRE if array2c is NULL or the cell is out of bounds
+ *
+ ******************************/
+void *UArray2c_at(T array2c, int column, int row)
+{
+        assert(array2c != NULL);
+        assert(column >= 0 && column < array2c->width);
+        assert(row >= 0 && row < array2c->height);
+
+        int bw = array2c->blockwidth;
+        int bh = array2c->blockheight;
+        int b = column / bw * array2c->blocks_down + row / bh;
+        unsigned char *elem = block_cells(array2c, b)
+                              + ((size_t)(row % bh) * bw + column % bw)
+                                * array2c->size;
+
+        CACHESIM_TRACE(elem, array2c->size);
+        return elem;
+}
+
+/********** UArray2c_map ********
+ *
+ *      applies apply to every cell, in storage order
+ *
+ *      Notes:
+ *              CRE if array2c is NULL
+ *              each block is looked up once, not once per cell
+ *
+ ******************************/
+void UArray2c_map(T array2c,
+                  void apply(int col, int row, T array2c, void *elem,
+                             void *cl),
+                  void *cl)
+{
+        assert(array2c != NULL);
+
+        int bw = array2c->blockwidth;
+        int bh = array2c->blockheight;
+        int size = array2c->size;
+        int b = 0;
+
+        for (int col0 = 0; col0 < array2c->width; col0 += bw) {
+                int cols = array2c->width - col0 < bw
+                           ? array2c->width - col0 : bw;
+                for (int row0 = 0; row0 < array2c->height; row0 += bh) {
+                        int rows = array2c->height - row0 < bh
+                                   ? array2c->height - row0 : bh;
+                        unsigned char *cells = block_cells(array2c, b++);
+
+                        for (int i = 0; i < rows; i++) {
+                                unsigned char *cell = cells
+                                                      + (size_t)i * bw * size;
+                                for (int j = 0; j < cols; j++, cell += size)
+                                        apply(col0 + j, row0 + i, array2c,
+                                              cell, cl);
+                        }
+                }
+        }
+}
+
+/********** UArray2c_resident ********
+ *
+ *      counts the bytes held by array2c
+ *
+ *      Notes:
+ *              a block in the cache is counted both decoded and as it
+ *              was last encoded, as both are held
+ *
+ ******************************/
+size_t UArray2c_resident(T array2c, size_t *raw)
+{
+        assert(array2c != NULL && raw != NULL);
+
+        size_t block_bytes = (size_t)array2c->blockwidth
+                             * array2c->blockheight * array2c->size;
+        size_t bytes = sizeof(*array2c) + block_bytes
+                       + array2c->nslots * block_bytes
+                       + array2c->nblocks * (sizeof(struct block)
+                                             + sizeof(int));
+
+        for (int b = 0; b < array2c->nblocks; b++)
+                bytes += array2c->blocks[b].len;
+        *raw = array2c->nblocks * block_bytes;
+        return bytes;
+}
@@ -0,0 +1,73 @@
+#ifndef UARRAY2C_INCLUDED
+#define UARRAY2C_INCLUDED
+/*
+ *      uarray2c.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              interface to UArray2c_T, a blocked 2D array whose blocks
+ *              are kept compressed. Blocks are laid out as in a
+ *              UArray2b: column-major, with the cells of a block in
+ *              row-major order. Each block is stored as whichever is
+ *              smallest of
+ *
+ *                - nothing, if every byte is zero
+ *                - one cell, if every cell is the same
+ *                - runs of equal cells, each a count and a cell
+ *                - the cells themselves
+ *
+ *              A block is decoded when one of its cells is used, into
+ *              one of a small number of cache slots, and encoded again
+ *              when its slot is needed for another block. Pointers to
+ *              cells (from UArray2c_at or UArray2c_map) stay good until
+ *              UARRAY2C_SLOTS - 1 other blocks of the same array have
+ *              been used; every cursor and map in ppmtrans holds far
+ *              fewer.
+ *
+ *              Since reading a cell may decode a block, an array must
+ *              not be used by two threads at once, even to read it.
+ *
+ */
+
+#include <stddef.h>
+
+/* cache slots per array; a slot holds one decoded block */
+#define UARRAY2C_SLOTS 64
+
+#define T UArray2c_T
+typedef struct T *T;
+
+/* blocks of blockwidth x blockheight cells, at most 65536 cells each;
+   every cell starts out zero */
+extern T UArray2c_new(int width, int height, int size, int blockwidth,
+                      int blockheight);
+
+/* square blocks of about 4KB, so the cache is about 256KB */
+extern T UArray2c_new_cache_sized(int width, int height, int size);
+
+extern void UArray2c_free(T *array2c);
+
+extern int UArray2c_width      (T array2c);
+extern int UArray2c_height     (T array2c);
+extern int UArray2c_size       (T array2c);
+extern int UArray2c_blockwidth (T array2c);
+extern int UArray2c_blockheight(T array2c);
+
+extern void *UArray2c_at(T array2c, int column, int row);
+
+/* visits every cell in storage order: block by block down each column
+   of blocks, and row by row within a block */
+extern void UArray2c_map(T array2c,
+                         void apply(int col, int row, T array2c, void *elem,
+                                    void *cl),
+                         void *cl);
+
+/* the bytes the array holds now, compressed blocks and cache included;
+   *raw is set to the bytes it would hold uncompressed */
+extern size_t UArray2c_resident(T array2c, size_t *raw);
+
+#undef T
+#endif
@@ -0,0 +1,312 @@
+/*
+ *      uarray2h.c
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              implementation of the two-level blocked array in
+ *              uarray2h.h. Cells live in one UArray, a block after
+ *              another in storage order; the block and tile counts are
+ *              worked out once at creation so that finding a cell is a
+ *              few divisions and no loops.
+ *
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "assert.h"
+#include "uarray.h"
+#include "uarray2h.h"
+#include "cachesim.h"
+#include "elemsize.h"
+
+#define BLOCK_BYTES (4 * 1024)          /* a block: a page, well in L1 */
+#define TILE_BYTES (256 * 1024)         /* a tile: L2, and 64 4K pages */
+
+#define T UArray2h_T
+
+struct T {
+        UArray_T theArray;
+        int width, height;
+        int size;
+        int blockwidth;         /* columns per block */
+        int blockheight;        /* rows per block */
+        int tileblocks;         /* blocks across and down a tile */
+        int blocks_across;      /* of the whole array */
+        int blocks_down;
+};
+
+
+/********** UArray2h_new ********
+ *
+ *      creates a new two-level blocked array
+ *
+ *      Parameters:
+ *              int width, height: the size of the array in cells
+ *              int size: the size of each cell
+ *              int blockwidth, blockheight: the cells of a block
+ *              int tileblocks: blocks across and down a tile, or 0 to
+ *                              fit a tile in TILE_BYTES
+ *
+ *      Return:
+ *              the new array
+ *
+ *      Notes:
+ *              CRE if a block edge is less than 1, tileblocks is
+ *              negative, or memory runs out
+ *
+ ******************************/
+T UArray2h_new(int width, int height, int size, int blockwidth,
+               int blockheight, int tileblocks)
+{
+        assert(width >= 0 && height >= 0 && size > 0);
+        assert(blockwidth > 0 && blockheight > 0 && tileblocks >= 0);
+
+        if (tileblocks == 0) {
+                double block = (double)blockwidth * blockheight * size;
+                tileblocks = (int)sqrt(TILE_BYTES / block);
+                if (tileblocks < 1)
+                        tileblocks = 1;
+        }
+
+        T array2h = malloc(sizeof(*array2h));
+        assert(array2h != NULL);
+        array2h->width = width;
+        array2h->height = height;
+        array2h->size = size;
+        array2h->blockwidth = blockwidth;
+        array2h->blockheight = blockheight;
+        array2h->tileblocks = tileblocks;
+        array2h->blocks_across = (width + blockwidth - 1) / blockwidth;
+        array2h->blocks_down = (height + blockheight - 1) / blockheight;
+        array2h->theArray = UArray_new(array2h->blocks_across
+                                       * array2h->blocks_down
+                                       * blockwidth * blockheight, size);
+        return array2h;
+}
+
+/********** UArray2h_new_cache_sized ********
+ *
+ *      creates a two-level blocked array with square blocks of about
+ *      BLOCK_BYTES and tiles of about TILE_BYTES
+ *
+ ******************************/
+T UArray2h_new_cache_sized(int width, int height, int size)
+{
+        int edge = size >= BLOCK_BYTES ? 1 : (int)sqrt(BLOCK_BYTES / size);
+
+        return UArray2h_new(width, height, size, edge, edge, 0);
+}
+
+void UArray2h_free(T *array2h)
+{
+        assert(array2h != NULL && *array2h != NULL);
+        UArray_free(&(*array2h)->theArray);
+        free(*array2h);
+        *array2h = NULL;
+}
+
+int UArray2h_width(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->width;
+}
+
+int UArray2h_height(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->height;
+}
+
+int UArray2h_size(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->size;
+}
+
+int UArray2h_blockwidth(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->blockwidth;
+}
+
+int UArray2h_blockheight(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->blockheight;
+}
+
+int UArray2h_tileblocks(T array2h)
+{
+        assert(array2h != NULL);
+        return array2h->tileblocks;
+}
+
+/********** block_number ********
+ *
+ *      the place in storage order of the block holding block column bx
+ *      and block row by
+ *
+ *      Notes:
+ *              every tile column before bx's is full width, and every
+ *              tile above by's in the same tile column is full height,
+ *              so only the tile holding the block can be partial
+ *
+ ******************************/
+static inline long block_number(T array2h, int bx, int by)
+{
+        int k = array2h->tileblocks;
+        int tx = bx / k, ty = by / k;
+        int across = array2h->blocks_across - tx * k;
+        int down = array2h->blocks_down - ty * k;
+
+        across = across < k ? across : k;
+        down = down < k ? down : k;
+        return (long)tx * k * array2h->blocks_down + (long)ty * k * across
+               + (long)(bx % k) * down + by % k;
+}
+
+/********** cell_index ********
+ *
+ *      where the cell at (column, row) lives in the underlying UArray
+ *
+ ******************************/
+static inline long cell_index(T array2h, int column, int row)
+{
+        int bw = array2h->blockwidth;
+        int bh = array2h->blockheight;
+
+        return block_number(array2h, column / bw, row / bh) * bw * bh
+               + (row % bh) * bw + column % bw;
+}
+
+/********** UArray2h_at ********
+ *
+ *      returns a pointer to the cell at (column, row)
+ *
+ *      Notes:
+ *              CRE if array2h is NULL or the cell is out of bounds
+ *
+ ******************************/
+void *UArray2h_at(T array2h, int column, int row)
+{
+        assert(array2h != NULL);
+        assert(column >= 0 && column < array2h->width);
+        assert(row >= 0 && row < array2h->height);
+
+        void *elem = UArray_at(array2h->theArray,
+                               cell_index(array2h, column, row));
+        CACHESIM_TRACE(elem, array2h->size);
+        return elem;
+}
+
+/********** UArray2h_next_block ********
+ *
+ *      steps from the corner of one block to the corner of the next in
+ *      storage order: down the tile's block column, then to the top of
+ *      the tile's next block column, then to the tile below, then to
+ *      the top of the next tile column
+ *
+ *      Parameters:
+ *              T array2h: the array
+ *              int *column, *row: a block corner, updated in place
+ *
+ *      Return:
+ *              0 once there are no more blocks
+ *
+ ******************************/
+int UArray2h_next_block(T array2h, int *column, int *row)
+{
+        assert(array2h != NULL && column != NULL && row != NULL);
+
+        int bw = array2h->blockwidth;
+        int bh = array2h->blockheight;
+        int k = array2h->tileblocks;
+        int bx = *column / bw, by = *row / bh;
+        int tx0 = bx - bx % k, ty0 = by - by % k;
+
+        if (by + 1 < ty0 + k && by + 1 < array2h->blocks_down) {
+                *row += bh;
+        } else if (bx + 1 < tx0 + k && bx + 1 < array2h->blocks_across) {
+                *column += bw;
+                *row = ty0 * bh;
+        } else if (ty0 + k < array2h->blocks_down) {
+                *column = tx0 * bw;
+                *row = (ty0 + k) * bh;
+        } else {
+                *column = (tx0 + k) * bw;
+                *row = 0;
+        }
+        return *column < array2h->width && array2h->height > 0;
+}
+
+typedef void applyfun(int col, int row, T array2h, void *elem, void *cl);
+
+/********** map_sized ********
+ *
+ *      the loop behind UArray2h_map, written against the raw element
+ *      storage with the element size as a parameter
+ *
+ *      Notes:
+ *              blocks are stored in the order they are visited, so the
+ *              block pointer steps by one block each time; an edge block
+ *              skips the padding at the end of each row
+ *              always inlined, so a call with a constant size gets a
+ *              copy of the loop with a constant stride
+ *              not UArray2h_at, so that a cache simulation sees only the
+ *              accesses made by apply
+ *
+ ******************************/
+ELEMSIZE_INLINE void map_sized(T array2h, applyfun apply, void *cl, int size)
+{
+        int bw = array2h->blockwidth;
+        int bh = array2h->blockheight;
+        int col0 = 0, row0 = 0;
+
+        if (array2h->width == 0 || array2h->height == 0)
+                return;
+
+        char *block = UArray_at(array2h->theArray, 0);
+        size_t block_bytes = (size_t)bw * bh * size;
+
+        do {
+                int cols = array2h->width - col0;
+                int rows = array2h->height - row0;
+                cols = cols < bw ? cols : bw;
+                rows = rows < bh ? rows : bh;
+
+                for (int i = 0; i < rows; i++) {
+                        char *cell = block + (size_t)i * bw * size;
+                        for (int j = 0; j < cols; j++, cell += size)
+                                apply(col0 + j, row0 + i, array2h, cell, cl);
+                }
+                block += block_bytes;
+        } while (UArray2h_next_block(array2h, &col0, &row0));
+}
+
+#define MAP_CASE(N, MAP) case N: MAP(array2h, apply, cl, N); break;
+
+/********** UArray2h_map ********
+ *
+ *      applies apply to every cell, in storage order
+ *
+ *      Notes:
+ *              CRE if array2h is NULL
+ *              runs a copy of the loop specialized to the element size
+ *
+ ******************************/
+void UArray2h_map(T array2h,
+                  void apply(int col, int row, T array2h, void *elem,
+                             void *cl),
+                  void *cl)
+{
+        assert(array2h != NULL);
+
+        switch (array2h->size) {
+        ELEMSIZE_FOREACH(MAP_CASE, map_sized)
+        default:
+                map_sized(array2h, apply, cl, array2h->size);
+        }
+}
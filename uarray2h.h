@@ -0,0 +1,60 @@
+#ifndef UARRAY2H_INCLUDED
+#define UARRAY2H_INCLUDED
+/*
+ *      uarray2h.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              interface to UArray2h_T, a 2D array blocked at two levels.
+ *              Cells are grouped into small blocks, sized by default for
+ *              the L1 cache (about a page), and blocks are grouped into
+ *              square tiles of tileblocks x tileblocks blocks, sized by
+ *              default for the L2 cache and the reach of the TLB.
+ *
+ *              Tiles are stored in column-major order, the blocks of a
+ *              tile in column-major order, and the cells of a block in
+ *              row-major order, so a UArray2h whose tiles are one block
+ *              is laid out exactly like a UArray2b. Only blocks are
+ *              padded: a tile in the last tile column or row holds just
+ *              the blocks that reach into the array.
+ *
+ */
+
+#define T UArray2h_T
+typedef struct T *T;
+
+/* blocks of blockwidth x blockheight cells, tiles of tileblocks x
+   tileblocks blocks; a tileblocks of 0 sizes the tiles for the L2 */
+extern T UArray2h_new(int width, int height, int size, int blockwidth,
+                      int blockheight, int tileblocks);
+
+/* blocks sized for the L1 and tiles for the L2 */
+extern T UArray2h_new_cache_sized(int width, int height, int size);
+
+extern void UArray2h_free(T *array2h);
+
+extern int UArray2h_width      (T array2h);
+extern int UArray2h_height     (T array2h);
+extern int UArray2h_size       (T array2h);
+extern int UArray2h_blockwidth (T array2h);
+extern int UArray2h_blockheight(T array2h);
+extern int UArray2h_tileblocks (T array2h);
+
+extern void *UArray2h_at(T array2h, int column, int row);
+
+/* moves (*column, *row) from the corner of one block to the corner of
+   the next block in storage order; returns 0 after the last block */
+extern int UArray2h_next_block(T array2h, int *column, int *row);
+
+/* visits every cell in storage order: tile by tile, block by block
+   within a tile, and row by row within a block */
+extern void UArray2h_map(T array2h,
+                         void apply(int col, int row, T array2h, void *elem,
+                                    void *cl),
+                         void *cl);
+
+#undef T
+#endif
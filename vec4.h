@@ -0,0 +1,180 @@
+#ifndef VEC4_INCLUDED
+#define VEC4_INCLUDED
+/*
+ *      vec4.h
+ *      by: Armaan Sikka & Nate Pfeffer
+ *      utln: asikka01 & npfeff01
+ *      date: 10/19/24
+ *      assignment: locality
+ *
+ *      summary:
+ *              helpers shared by the filtering transformations (resample.c
+ *              and convolve.c), which work on pixels as 4-lane float
+ *              vectors (red, green, blue, unused) so that every filter
+ *              tap is one vector multiply-add. They move rectangles of
+ *              Pnm_rgb pixels between an A2Methods array and a buffer of
+ *              such vectors, and keep per-thread scratch buffers.
+ *
+ *              Everything here is static inline, so each file gets its
+ *              own copy, compiled with or without CACHESIM as that file
+ *              is.
+ *
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "a2cursor.h"
+#include "cachesim.h"
+#include "pnm.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+
+struct scratch {
+        v4f *window;
+        size_t capacity;                /* in pixels */
+        int failed;                     /* a window could not be had */
+};
+
+
+/********** window_for ********
+ *
+ *      makes sure a thread's scratch can hold a window of n pixels
+ *
+ *      Return:
+ *              the scratch window, or NULL if there is no memory for it
+ *
+ *      Notes:
+ *              called on the pool's threads, which must not raise, so
+ *              a failure is only noted in s; the caller of Parallel_for
+ *              checks with scratch_failed once the threads are done
+ *
+ ******************************/
+static inline v4f *window_for(struct scratch *s, size_t n)
+{
+        if (n > s->capacity) {
+                free(s->window);
+                s->window = malloc(n * sizeof(*s->window));
+                s->capacity = s->window != NULL ? n : 0;
+                if (s->window == NULL)
+                        s->failed = 1;
+        }
+        return s->window;
+}
+
+/********** scratch_free ********
+ *
+ *      frees the scratch of n threads
+ *
+ *      Return:
+ *              nonzero if any thread could not get a window, in which
+ *              case some of the job was not done
+ *
+ ******************************/
+static inline int scratch_free(struct scratch *scratch, int n)
+{
+        int failed = 0;
+
+        for (int t = 0; t < n; t++) {
+                failed |= scratch[t].failed;
+                free(scratch[t].window);
+        }
+        free(scratch);
+        return failed;
+}
+
+static inline unsigned to_sample(float x, float maxval)
+{
+        if (!(x > 0))
+                return 0;
+        if (x >= maxval)
+                return maxval;
+        return x + 0.5f;
+}
+
+static inline void store(char *p, v4f v, float maxval)
+{
+        Pnm_rgb px = (Pnm_rgb)p;
+
+        px->red   = to_sample(v[0], maxval);
+        px->green = to_sample(v[1], maxval);
+        px->blue  = to_sample(v[2], maxval);
+        CACHESIM_TRACE(px, sizeof(*px));
+}
+
+/********** load_rect, store_rect ********
+ *
+ *      move the rectangle [x0, x0 + w) x [y0, y0 + h) of an array
+ *      between the array and buf, where pixel (x, y) of the rectangle
+ *      is buf[(x - x0) * ldx + (y - y0) * ldy]
+ *
+ *      Notes:
+ *              the array is read or written in runs along its own
+ *              storage direction, columns if vertical and rows if not,
+ *              and a whole stretch of lines is done before moving along
+ *              them, so a blocked array is visited a block at a time.
+ *              This relies on a run's length depending only on where it
+ *              starts along the run, true of both cursor suites
+ *
+ ******************************/
+static inline void load_rect(A2Methods_UArray2 array2,
+                             A2Methods_CursorT cursors, int vertical, int x0,
+                             int y0, int w, int h, v4f *buf, int ldx, int ldy)
+{
+        int lines = vertical ? w : h;
+        int len = vertical ? h : w;
+        long step = vertical ? ldy : ldx;
+
+        for (int k = 0; k < len; ) {
+                int n = 0;
+                for (int l = 0; l < lines; l++) {
+                        int x = vertical ? l : k;
+                        int y = vertical ? k : l;
+                        A2Methods_Run run;
+                        n = cursors->run_at(array2, x0 + x, y0 + y,
+                                            !vertical, vertical, len - k,
+                                            &run);
+                        const char *p = run.elem;
+                        v4f *o = buf + (long)x * ldx + (long)y * ldy;
+
+                        for (int i = 0; i < n; i++, p += run.stride,
+                                                  o += step) {
+                                const struct Pnm_rgb *px = (const void *)p;
+                                CACHESIM_TRACE(px, sizeof(*px));
+                                *o = (v4f){ px->red, px->green, px->blue,
+                                            0 };
+                        }
+                }
+                k += n;
+        }
+}
+
+static inline void store_rect(A2Methods_UArray2 array2,
+                              A2Methods_CursorT cursors, int vertical, int x0,
+                              int y0, int w, int h, const v4f *buf, int ldx,
+                              int ldy, float maxval)
+{
+        int lines = vertical ? w : h;
+        int len = vertical ? h : w;
+        long step = vertical ? ldy : ldx;
+
+        for (int k = 0; k < len; ) {
+                int n = 0;
+                for (int l = 0; l < lines; l++) {
+                        int x = vertical ? l : k;
+                        int y = vertical ? k : l;
+                        A2Methods_Run run;
+                        n = cursors->run_at(array2, x0 + x, y0 + y,
+                                            !vertical, vertical, len - k,
+                                            &run);
+                        char *p = run.elem;
+                        const v4f *in = buf + (long)x * ldx + (long)y * ldy;
+
+                        for (int i = 0; i < n; i++, p += run.stride,
+                                                  in += step)
+                                store(p, *in, maxval);
+                }
+                k += n;
+        }
+}
+
+#endif